@@ -0,0 +1,280 @@
+/*
+ * bench.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <time.h>
+#include <dirent.h>
+#include <iconv.h>
+#include "xmltv2vdr.h"
+#include "bench.h"
+#include "debug.h"
+
+// realistic input, german titles with umlauts and punctuation
+static const char *titles[]=
+{
+    "Tatort","Die Rosenheim-Cops","Großstadtrevier","Küstenwache","Heute-Show",
+    "Alarm für Cobra 11 - Die Autobahnpolizei","Navy CIS: L.A.","Über Wasser: Die Nordsee",
+    "Mörderische Straßen","Wer weiß denn sowas?","The Big Bang Theory","Lindenstraße"
+};
+#define NUMTITLES (int) (sizeof(titles)/sizeof(titles[0]))
+
+static const char *shorttexts[]=
+{
+    "Ärger im Revier","Die Rückkehr des Königs","Flucht über die Grenze","Schöne Grüße aus Köln",
+    "Spaß beiseite!","Größenwahn (1/2)","S03E12","Das Geheimnis der Äbtissin"
+};
+#define NUMSHORTTEXTS (int) (sizeof(shorttexts)/sizeof(shorttexts[0]))
+
+static const char *times[]=
+{
+    "20261018203000 +0200","20261018041500 +0100","20261018120000 -0500","20261018","201610182015"
+};
+#define NUMTIMES (int) (sizeof(times)/sizeof(times[0]))
+
+uint64_t (*cXMLTVBench::allocations)(void)=NULL;
+
+cXMLTVBench::cXMLTVBench(cGlobals *Global, int Loops)
+{
+    g=Global;
+    loops=(Loops>0) ? Loops : XMLTVBENCH_LOOPS;
+    start=allocstart=0;
+}
+
+uint64_t cXMLTVBench::Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t) ts.tv_sec*1000000000ULL+ts.tv_nsec;
+}
+
+void cXMLTVBench::Begin()
+{
+    allocstart=allocations ? allocations() : 0;
+    start=Now();
+}
+
+void cXMLTVBench::End(const char *Name, int Ops)
+{
+    uint64_t ns=Now()-start;
+    uint64_t allocs=allocations ? allocations()-allocstart : 0;
+    if (Ops<1) Ops=1;
+    if (allocations)
+    {
+        result=cString::sprintf("%s%s ops=%i ns/op=%llu allocs/op=%.2f\n",*result ? *result : "",Name,Ops,
+                                (unsigned long long) (ns/Ops),(double) allocs/Ops);
+    }
+    else
+    {
+        result=cString::sprintf("%s%s ops=%i ns/op=%llu\n",*result ? *result : "",Name,Ops,
+                                (unsigned long long) (ns/Ops));
+    }
+}
+
+void cXMLTVBench::ConvertTime()
+{
+    char buf[64];
+    Begin();
+    for (int i=0; i<loops; i++)
+    {
+        strn0cpy(buf,times[i % NUMTIMES],sizeof(buf)); // converted in place
+        cParse::ConvertXMLTVTime2UnixTime(buf);
+    }
+    End("ConvertXMLTVTime2UnixTime",loops);
+}
+
+void cXMLTVBench::RemoveNonAlphaNumeric()
+{
+    char buf[256];
+    Begin();
+    for (int i=0; i<loops; i++)
+    {
+        strn0cpy(buf,shorttexts[i % NUMSHORTTEXTS],sizeof(buf));
+        cParse::RemoveNonAlphaNumeric(buf);
+    }
+    End("RemoveNonAlphaNumeric",loops);
+}
+
+void cXMLTVBench::RemoveNonASCII()
+{
+    Begin();
+    for (int i=0; i<loops; i++)
+    {
+        free(cImport::RemoveNonASCII(titles[i % NUMTITLES]));
+    }
+    End("RemoveNonASCII",loops);
+}
+
+void cXMLTVBench::SoundEx()
+{
+    char sndx[11];
+    Begin();
+    for (int i=0; i<loops; i++)
+    {
+        cImport::SoundEx(sndx,(char *) titles[i % NUMTITLES],0,1);
+    }
+    End("SoundEx",loops);
+}
+
+void cXMLTVBench::GetSQL()
+{
+    cXMLTVEvent xevent;
+    xevent.SetTitle(titles[0]);
+    xevent.SetShortText(shorttexts[0]);
+    xevent.SetDescription("Kommissar Borowski ermittelt in einem Fall, der ihn bis an die Grenze führt. "
+                          "Dabei stößt er auf Widerstände, die er nicht erwartet hätte.");
+    xevent.SetCountry("D");
+    xevent.SetYear(2016);
+    xevent.SetStartTime(time(NULL));
+    xevent.SetDuration(5400);
+    xevent.SetEventID(4711);
+    xevent.AddCredits("director","Regisseur Eins");
+    xevent.AddCredits("actor","Schauspieler Eins","Kommissar");
+    xevent.AddCredits("actor","Schauspielerin Zwei");
+    xevent.AddCategory("Krimi");
+    xevent.AddCategory("Reihe");
+    xevent.AddRating("FSK","12");
+    xevent.AddStarRating(NULL,"3/5");
+
+    char *isql,*usql;
+    Begin();
+    for (int i=0; i<loops; i++)
+    {
+        xevent.GetSQL("bench",0,"S19.2E-1-1079-28006",&isql,&usql); // owned by xevent
+    }
+    End("GetSQL",loops);
+}
+
+void cXMLTVBench::Credits()
+{
+    cXMLTVEvent from,to;
+    from.AddCredits("director","Regisseur Eins");
+    from.AddCredits("actor","Schauspieler Eins","Kommissar");
+    from.AddCredits("actor","Schauspielerin Zwei");
+    from.AddCredits("writer","Autor Drei");
+    Begin();
+    for (int i=0; i<loops; i++)
+    {
+        to.Credits()->Clear(); // SetCredits appends
+        to.SetCredits(from.Credits()->toString());
+    }
+    End("Credits",loops);
+}
+
+void cXMLTVBench::GetMap()
+{
+    cEPGMappings *maps=g->EPGMappings();
+    if (!maps->Count()) return;
+
+    // resolve ids and names first, only the lookups are measured
+    std::vector<tChannelID> ids;
+    std::vector<const char *> names;
+    for (cEPGMapping *map=maps->First(); map; map=maps->Next(map))
+    {
+        names.push_back(map->ChannelName());
+        if (map->NumChannelIDs()) ids.push_back(map->ChannelIDs()[0]);
+    }
+
+    if (ids.size())
+    {
+        Begin();
+        for (int i=0; i<loops; i++)
+        {
+            maps->GetMap(ids[i % ids.size()]);
+        }
+        End("GetMap(tChannelID)",loops);
+    }
+    Begin();
+    for (int i=0; i<loops; i++)
+    {
+        maps->GetMap(names[i % names.size()]);
+    }
+    End("GetMap(ChannelName)",loops);
+}
+
+void cXMLTVBench::FetchSeasonEpisode()
+{
+    if (!g->EPDir()) return;
+    iconv_t cep2ascii=iconv_open("ASCII//TRANSLIT",g->EPCodeset());
+    iconv_t cutf2ascii=iconv_open("ASCII//TRANSLIT","UTF-8");
+    if ((cep2ascii==(iconv_t) -1) || (cutf2ascii==(iconv_t) -1))
+    {
+        if (cep2ascii!=(iconv_t) -1) iconv_close(cep2ascii);
+        if (cutf2ascii!=(iconv_t) -1) iconv_close(cutf2ascii);
+        return;
+    }
+
+    // sample titles and shorttexts from the installed eplists
+    cStringList eptitles,epshorttexts;
+    DIR *dir=opendir(g->EPDir());
+    if (dir)
+    {
+        struct dirent *dirent;
+        while ((dirent=readdir(dir)) && (eptitles.Size()<XMLTVBENCH_MAXEPLISTS))
+        {
+            char *pt=strrchr(dirent->d_name,'.');
+            if (!pt || strcmp(pt,".episodes")) continue;
+            char *epfile=NULL;
+            if (asprintf(&epfile,"%s/%s",g->EPDir(),dirent->d_name)==-1) continue;
+            FILE *f=fopen(epfile,"r");
+            free(epfile);
+            if (!f) continue;
+            char *line=NULL;
+            size_t length;
+            while (getline(&line,&length,f)!=-1)
+            {
+                if (line[0]=='#') continue;
+                int s,e,o;
+                char stext[256]="";
+                if (sscanf(line,"%3d\t%3d\t%5d\t%255[^\t\n]",&s,&e,&o,stext)==4)
+                {
+                    // shorttexts are converted like xmltv input
+                    cCharSetConv conv(g->EPCodeset(),"UTF-8");
+                    *pt=0;
+                    eptitles.Append(strdup(dirent->d_name));
+                    epshorttexts.Append(strdup(conv.Convert(stext)));
+                    break;
+                }
+            }
+            if (line) free(line);
+            fclose(f);
+        }
+        closedir(dir);
+    }
+
+    if (eptitles.Size())
+    {
+        int ops=loops/100;
+        if (ops<10) ops=10;
+        Begin();
+        for (int i=0; i<ops; i++)
+        {
+            int season=0,episode=0,episodeoverall=0;
+            char *epshorttext=NULL,*eptitle=NULL;
+            int n=i % eptitles.Size();
+            cParse::FetchSeasonEpisode(cep2ascii,cutf2ascii,g->EPDir(),eptitles[n],epshorttexts[n],NULL,
+                                       season,episode,episodeoverall,&epshorttext,&eptitle);
+            free(epshorttext);
+            free(eptitle);
+        }
+        End("FetchSeasonEpisode",ops);
+    }
+    iconv_close(cep2ascii);
+    iconv_close(cutf2ascii);
+}
+
+cString cXMLTVBench::Run()
+{
+    result=NULL;
+    ConvertTime();
+    RemoveNonAlphaNumeric();
+    RemoveNonASCII();
+    SoundEx();
+    GetSQL();
+    Credits();
+    GetMap();
+    FetchSeasonEpisode();
+    return result;
+}
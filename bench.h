@@ -0,0 +1,51 @@
+/*
+ * bench.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef _BENCH_H
+#define _BENCH_H
+
+#include <stdint.h>
+#include <vdr/tools.h>
+
+#define XMLTVBENCH_LOOPS 10000
+#define XMLTVBENCH_MAXEPLISTS 20
+
+class cGlobals;
+
+// only linked into dist/xmltvbench/xmltvbench-kernels, not into the plugin: the time
+// conversion changes TZ, which is not safe while vdr runs other threads
+class cXMLTVBench
+{
+private:
+    cGlobals *g;
+    cString result;
+    int loops;
+    uint64_t start;
+    uint64_t allocstart;
+    static uint64_t (*allocations)(void);
+    static uint64_t Now();
+    void Begin();
+    void End(const char *Name, int Ops);
+    void ConvertTime();
+    void RemoveNonAlphaNumeric();
+    void RemoveNonASCII();
+    void SoundEx();
+    void GetSQL();
+    void Credits();
+    void GetMap();
+    void FetchSeasonEpisode();
+public:
+    cXMLTVBench(cGlobals *Global, int Loops=XMLTVBENCH_LOOPS);
+    // Counter returns the number of allocations so far, results get allocs/op
+    static void SetAllocationCounter(uint64_t (*Counter)(void))
+    {
+        allocations=Counter;
+    }
+    cString Run();
+};
+
+#endif
@@ -0,0 +1,514 @@
+/*
+ * cache.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <time.h>
+#include <limits.h>
+#include "xmltv2vdr.h"
+#include "cache.h"
+#include "debug.h"
+
+cXMLTVCacheData::cXMLTVCacheData(time_t From, time_t Till)
+{
+    from=From;
+    till=Till;
+}
+
+cXMLTVCacheData::~cXMLTVCacheData()
+{
+    for (std::map<tRowKey,cXMLTVCacheEntry *>::iterator it=rows.begin(); it!=rows.end(); it++)
+    {
+        delete it->second;
+    }
+}
+
+void cXMLTVCacheData::Add(const char *ChannelID, cXMLTVCacheEntry *Entry)
+{
+    cXMLTVEvent *xevent=&Entry->event;
+    tRowKey key(xevent->Source(),std::make_pair(std::string(ChannelID),xevent->EventID()));
+    Remove(key);
+    rows[key]=Entry;
+    // rows without eiteventid are only found by title
+    if (xevent->EITEventID())
+        eitids.insert(std::make_pair(tEITKey(ChannelID,xevent->EITEventID()),Entry));
+    titles.insert(std::make_pair(tTitleKey(ChannelID,std::make_pair(xevent->StartTime()/3600,Entry->titlehash)),Entry));
+}
+
+void cXMLTVCacheData::Remove(const tRowKey &Key)
+{
+    std::map<tRowKey,cXMLTVCacheEntry *>::iterator row=rows.find(Key);
+    if (row==rows.end()) return;
+    cXMLTVCacheEntry *entry=row->second;
+    const std::string &channelid=Key.second.first;
+
+    std::pair<std::multimap<tEITKey,cXMLTVCacheEntry *>::iterator,
+        std::multimap<tEITKey,cXMLTVCacheEntry *>::iterator> er;
+    er=eitids.equal_range(tEITKey(channelid,entry->event.EITEventID()));
+    for (std::multimap<tEITKey,cXMLTVCacheEntry *>::iterator it=er.first; it!=er.second; it++)
+    {
+        if (it->second==entry)
+        {
+            eitids.erase(it);
+            break;
+        }
+    }
+
+    std::pair<std::multimap<tTitleKey,cXMLTVCacheEntry *>::iterator,
+        std::multimap<tTitleKey,cXMLTVCacheEntry *>::iterator> tr;
+    tr=titles.equal_range(tTitleKey(channelid,std::make_pair(entry->event.StartTime()/3600,entry->titlehash)));
+    for (std::multimap<tTitleKey,cXMLTVCacheEntry *>::iterator it=tr.first; it!=tr.second; it++)
+    {
+        if (it->second==entry)
+        {
+            titles.erase(it);
+            break;
+        }
+    }
+
+    rows.erase(row);
+    delete entry;
+}
+
+// -------------------------------------------------------------
+
+cXMLTVCache::cXMLTVCache(cGlobals *Global)
+{
+    g=Global;
+    data=NULL;
+    generation=0;
+    negcount=0;
+    hits=misses=neghits=dblookups=dbmisses=0;
+    infohits=infodb=0;
+}
+
+cXMLTVCache::~cXMLTVCache()
+{
+    delete data;
+}
+
+unsigned int cXMLTVCache::Hash(const char *Value)
+{
+    // FNV-1a
+    unsigned int hash=2166136261U;
+    if (!Value) return hash;
+    while (*Value)
+    {
+        hash^=(unsigned char) *Value++;
+        hash*=16777619U;
+    }
+    return hash;
+}
+
+unsigned long long cXMLTVCache::NegKey(const cEvent *Event)
+{
+    return ((unsigned long long) Event->EventID()<<32) | (unsigned int) Event->StartTime();
+}
+
+void cXMLTVCache::ClearNegative()
+{
+    negative.clear();
+    negcount=0;
+}
+
+void cXMLTVCache::MatchKey(const char *Title, std::string &Key)
+{
+    // same key as used by cImport::SearchXMLTVEvent
+    char key[256];
+    if (!g->SoundEx() || !cImport::SoundEx(key,(char *) Title,0,1))
+        cImport::TitleKey(Title,key,sizeof(key));
+    Key=key;
+}
+
+bool cXMLTVCache::Better(cXMLTVCacheEntry *Entry, cXMLTVCacheEntry *Best, time_t StartTime)
+{
+    // same order as "order by abs(starttime-x),srcidx"
+    if (!Best) return true;
+    long diff=labs((long) (Entry->event.StartTime()-StartTime));
+    long bdiff=labs((long) (Best->event.StartTime()-StartTime));
+    if (diff!=bdiff) return (diff<bdiff);
+    return (Entry->srcidx<Best->srcidx);
+}
+
+void cXMLTVCache::Refresh()
+{
+    if (!g->EPGFile()) return;
+
+    time_t now=time(NULL);
+    cXMLTVCacheData *newdata=new cXMLTVCacheData(now-7200,now+(XMLTVCACHE_HOURS*3600));
+    if (!newdata) return;
+
+    sqlite3 *db=g->EPGDatabase()->GetReader();
+    if (!db)
+    {
+        delete newdata;
+        Clear();
+        return;
+    }
+
+    char *sql;
+    if (asprintf(&sql,"select " XMLTV_COLUMNS ",srcidx from epg where starttime>=%li and starttime<=%li;",
+                 newdata->from,newdata->till)==-1)
+    {
+        esyslog("out of memory");
+        g->EPGDatabase()->PutReader(db);
+        delete newdata;
+        return;
+    }
+
+    cTimeMs timer;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db,sql,-1,&stmt,NULL)!=SQLITE_OK)
+    {
+        // no table yet
+        free(sql);
+        g->EPGDatabase()->PutReader(db);
+        delete newdata;
+        Clear();
+        return;
+    }
+    free(sql);
+
+    int cnt=0;
+    while (sqlite3_step(stmt)==SQLITE_ROW)
+    {
+        cXMLTVCacheEntry *entry=new cXMLTVCacheEntry;
+        if (!entry) break;
+        cImport::FetchXMLTVEvent(stmt,&entry->event,g->EPGCompression());
+        entry->srcidx=sqlite3_column_int(stmt,25);
+        MatchKey(entry->event.Title(),entry->titlekey);
+        entry->titlehash=Hash(entry->titlekey.c_str());
+        newdata->Add(entry->event.ChannelID(),entry);
+        cnt++;
+    }
+    sqlite3_finalize(stmt);
+    g->EPGDatabase()->PutReader(db);
+
+    cXMLTVCacheData *olddata;
+    mutex.Lock();
+    olddata=data;
+    data=newdata;
+    generation++;
+    ClearNegative();
+    mutex.Unlock();
+    delete olddata;
+    dsyslog("cached %i xmltv events in %llims",cnt,(long long int) timer.Elapsed());
+}
+
+void cXMLTVCache::Clear()
+{
+    cXMLTVCacheData *olddata;
+    mutex.Lock();
+    olddata=data;
+    data=NULL;
+    generation++;
+    ClearNegative();
+    mutex.Unlock();
+    delete olddata;
+}
+
+int cXMLTVCache::Lookup(const char *ChannelID, const cEvent *Event, int TimeDiff, cXMLTVEvent **xEvent)
+{
+    if (!xEvent) return XMLTVCACHE_UNKNOWN;
+    *xEvent=NULL;
+    if (!ChannelID) return XMLTVCACHE_UNKNOWN;
+    if (!Event) return XMLTVCACHE_UNKNOWN;
+    // the database also matches rows without eiteventid then
+    if (!Event->EventID()) return XMLTVCACHE_UNKNOWN;
+
+    time_t start=Event->StartTime();
+    cMutexLock lock(&mutex);
+    if (!data) return XMLTVCACHE_UNKNOWN;
+    if ((start-TimeDiff<data->from) || (start+TimeDiff>data->till)) return XMLTVCACHE_UNKNOWN;
+
+    cXMLTVCacheEntry *best=NULL;
+    std::string channelid=ChannelID;
+    std::pair<std::multimap<cXMLTVCacheData::tEITKey,cXMLTVCacheEntry *>::iterator,
+        std::multimap<cXMLTVCacheData::tEITKey,cXMLTVCacheEntry *>::iterator> er;
+    er=data->eitids.equal_range(cXMLTVCacheData::tEITKey(channelid,Event->EventID()));
+    for (std::multimap<cXMLTVCacheData::tEITKey,cXMLTVCacheEntry *>::iterator it=er.first; it!=er.second; it++)
+    {
+        time_t st=it->second->event.StartTime();
+        if ((st<start-TimeDiff) || (st>start+TimeDiff)) continue;
+        if (Better(it->second,best,start)) best=it->second;
+    }
+
+    if (!best)
+    {
+        std::string key;
+        MatchKey(Event->Title(),key);
+        unsigned int hash=Hash(key.c_str());
+        for (time_t hour=(start-TimeDiff)/3600; hour<=(start+TimeDiff)/3600; hour++)
+        {
+            std::pair<std::multimap<cXMLTVCacheData::tTitleKey,cXMLTVCacheEntry *>::iterator,
+                std::multimap<cXMLTVCacheData::tTitleKey,cXMLTVCacheEntry *>::iterator> tr;
+            tr=data->titles.equal_range(cXMLTVCacheData::tTitleKey(channelid,std::make_pair(hour,hash)));
+            for (std::multimap<cXMLTVCacheData::tTitleKey,cXMLTVCacheEntry *>::iterator it=tr.first; it!=tr.second; it++)
+            {
+                cXMLTVEvent *xevent=&it->second->event;
+                time_t st=xevent->StartTime();
+                if ((st<start-TimeDiff) || (st>start+TimeDiff)) continue;
+                if (it->second->titlekey!=key) continue;
+                if (Better(it->second,best,start)) best=it->second;
+            }
+        }
+    }
+    if (!best)
+    {
+        misses++;
+        return XMLTVCACHE_MISS;
+    }
+
+    *xEvent=new cXMLTVEvent();
+    if (!*xEvent) return XMLTVCACHE_UNKNOWN;
+    (*xEvent)->CopyFrom(&best->event);
+    hits++;
+    return XMLTVCACHE_HIT;
+}
+
+bool cXMLTVCache::IsNegative(const char *ChannelID, const cEvent *Event)
+{
+    if (!ChannelID) return false;
+    if (!Event) return false;
+    cMutexLock lock(&mutex);
+    std::map<std::string,std::set<unsigned long long> >::iterator it=negative.find(ChannelID);
+    if ((it!=negative.end()) && (it->second.count(NegKey(Event))))
+    {
+        neghits++;
+        return true;
+    }
+    dblookups++;
+    return false;
+}
+
+void cXMLTVCache::AddNegative(const char *ChannelID, const cEvent *Event)
+{
+    if (!ChannelID) return;
+    if (!Event) return;
+    cMutexLock lock(&mutex);
+    dbmisses++;
+    if (negcount>=XMLTVCACHE_NEGMAX) ClearNegative();
+    if (negative[ChannelID].insert(NegKey(Event)).second) negcount++;
+}
+
+cString cXMLTVCache::Stats()
+{
+    cMutexLock lock(&mutex);
+    int lookups=hits+misses+neghits+dblookups;
+    int rows=data ? (int) data->rows.size() : 0;
+    cString stats=cString::sprintf("cache rows=%i lookups=%i hits=%i misses=%i neghits=%i negentries=%i "
+                                   "dblookups=%i dbmisses=%i hitratio=%i infohits=%i infodb=%i",rows,lookups,
+                                   hits,misses,neghits,negcount,dblookups,dbmisses,
+                                   lookups ? ((hits+misses+neghits)*100)/lookups : 0,infohits,infodb);
+    return stats;
+}
+
+void cXMLTVCache::Put(const char *Source, const char *ChannelID, cXMLTVEvent *xEvent, int SrcIdx, int EIT)
+{
+    if (!Source) return;
+    if (!ChannelID) return;
+    if (!xEvent) return;
+
+    cMutexLock lock(&mutex);
+    if (SrcIdx>=0)
+    {
+        // a new row may satisfy an earlier miss on this channel
+        std::map<std::string,std::set<unsigned long long> >::iterator it=negative.find(ChannelID);
+        if (it!=negative.end())
+        {
+            negcount-=it->second.size();
+            negative.erase(it);
+        }
+    }
+    if (!data) return;
+    if ((xEvent->StartTime()<data->from) || (xEvent->StartTime()>data->till)) return;
+
+    cXMLTVCacheData::tRowKey key(Source,std::make_pair(std::string(ChannelID),xEvent->EventID()));
+    std::map<cXMLTVCacheData::tRowKey,cXMLTVCacheEntry *>::iterator row=data->rows.find(key);
+    cXMLTVCacheEntry *old=NULL;
+    if (row!=data->rows.end())
+    {
+        old=row->second;
+        if (SrcIdx<0) SrcIdx=old->srcidx;
+    }
+    if (SrcIdx<0) return; // not from the database we have loaded
+
+    cXMLTVCacheEntry *entry=new cXMLTVCacheEntry;
+    if (!entry) return;
+    entry->event.CopyFrom(xEvent);
+    entry->event.SetSource(Source);
+    entry->event.SetChannelID(ChannelID);
+    if ((EIT==XMLTVCACHE_EIT_CLEAR) || ((EIT==XMLTVCACHE_EIT_KEEP) && !old))
+    {
+        entry->event.SetEITEventID(0);
+        entry->event.SetEITDescription(NULL);
+    }
+    if ((EIT==XMLTVCACHE_EIT_KEEP) && old)
+    {
+        entry->event.SetEITEventID(old->event.EITEventID());
+        entry->event.CopyEITDescription(&old->event);
+    }
+    entry->srcidx=SrcIdx;
+    MatchKey(entry->event.Title(),entry->titlekey);
+    entry->titlehash=Hash(entry->titlekey.c_str());
+    data->Add(ChannelID,entry);
+}
+
+void cXMLTVCache::CopyList(cStringList &To, cXMLTVStringList *From)
+{
+    To.Clear();
+    for (int i=0; i<From->Size(); i++)
+    {
+        char *value=strdup((*From)[i]);
+        if (value) To.Append(value);
+    }
+}
+
+void cXMLTVCache::FillInfo(cXMLTVEvent *xEvent, cXMLTV2VDREventInfo *Info)
+{
+    Info->eventID=xEvent->EITEventID();
+    Info->startTime=xEvent->StartTime();
+    Info->duration=xEvent->Duration();
+    Info->source=cString(xEvent->Source());
+    Info->title=cString(xEvent->Title());
+    Info->altTitle=cString(xEvent->AltTitle());
+    Info->origTitle=cString(xEvent->OrigTitle());
+    Info->shortText=cString(xEvent->ShortText());
+    Info->description=cString(xEvent->Description());
+    Info->country=cString(xEvent->Country());
+    Info->audio=cString(xEvent->Audio());
+    Info->year=xEvent->Year();
+    Info->season=xEvent->Season();
+    Info->episode=xEvent->Episode();
+    Info->episodeOverall=xEvent->EpisodeOverall();
+    CopyList(Info->credits,xEvent->Credits());
+    CopyList(Info->category,xEvent->Category());
+    CopyList(Info->review,xEvent->Review());
+    CopyList(Info->rating,xEvent->Rating());
+    CopyList(Info->starRating,xEvent->StarRating());
+    CopyList(Info->video,xEvent->Video());
+    CopyList(Info->pics,xEvent->Pics());
+}
+
+int cXMLTVCache::DBInfo(const char *ChannelID, tEventID EventID, time_t From, time_t Till,
+                        cList<cXMLTV2VDREventInfo> *Events, cXMLTV2VDREventInfo *Info)
+{
+    sqlite3 *db=g->EPGDatabase()->GetReader();
+    if (!db) return 0;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db,"select " XMLTV_COLUMNS ",srcidx from epg where channelid=?1 and " \
+                           "eiteventid=coalesce(?2,eiteventid) and eiteventid<>0 and starttime>=?3 and " \
+                           "starttime<=?4 order by eiteventid,srcidx;",-1,&stmt,NULL)!=SQLITE_OK)
+    {
+        g->EPGDatabase()->PutReader(db);
+        return 0;
+    }
+    sqlite3_bind_text(stmt,1,ChannelID,-1,SQLITE_TRANSIENT);
+    if (EventID) sqlite3_bind_int64(stmt,2,EventID);
+    sqlite3_bind_int64(stmt,3,From);
+    sqlite3_bind_int64(stmt,4,Till);
+
+    // the first row of an eiteventid is the one of the best source
+    int cnt=0;
+    tEventID last=0;
+    while (sqlite3_step(stmt)==SQLITE_ROW)
+    {
+        if ((tEventID) sqlite3_column_int64(stmt,22)==last) continue;
+        cXMLTVEvent xevent;
+        cImport::FetchXMLTVEvent(stmt,&xevent,g->EPGCompression());
+        last=xevent.EITEventID();
+        cnt++;
+        if (Info)
+        {
+            FillInfo(&xevent,Info);
+            break;
+        }
+        cXMLTV2VDREventInfo *info=new cXMLTV2VDREventInfo;
+        if (!info) break;
+        FillInfo(&xevent,info);
+        Events->Add(info);
+    }
+    sqlite3_finalize(stmt);
+    g->EPGDatabase()->PutReader(db);
+    infodb++;
+    return cnt;
+}
+
+bool cXMLTVCache::GetInfo(tChannelID ChannelID, tEventID EventID, cXMLTV2VDREventInfo *Info)
+{
+    if (!Info) return false;
+    if (!EventID) return false;
+    std::string channelid=*ChannelID.ToString();
+    {
+        cMutexLock lock(&mutex);
+        if (data)
+        {
+            cXMLTVCacheEntry *best=NULL;
+            std::pair<std::multimap<cXMLTVCacheData::tEITKey,cXMLTVCacheEntry *>::iterator,
+                std::multimap<cXMLTVCacheData::tEITKey,cXMLTVCacheEntry *>::iterator> er;
+            er=data->eitids.equal_range(cXMLTVCacheData::tEITKey(channelid,EventID));
+            for (std::multimap<cXMLTVCacheData::tEITKey,cXMLTVCacheEntry *>::iterator it=er.first; it!=er.second; it++)
+            {
+                if (!best || (it->second->srcidx<best->srcidx)) best=it->second;
+            }
+            if (best)
+            {
+                // decode a copy, the cached rows stay compressed
+                cXMLTVEvent xevent;
+                xevent.CopyFrom(&best->event);
+                FillInfo(&xevent,Info);
+                infohits++;
+                return true;
+            }
+        }
+    }
+
+    // not within the cached hours
+    return (DBInfo(channelid.c_str(),EventID,0,LONG_MAX,NULL,Info)>0);
+}
+
+int cXMLTVCache::GetInfo(tChannelID ChannelID, time_t From, time_t Till, cList<cXMLTV2VDREventInfo> *Events)
+{
+    if (!Events) return 0;
+    std::string channelid=*ChannelID.ToString();
+    int cnt=0;
+    {
+        cMutexLock lock(&mutex);
+        if (data && (From>=data->from) && (Till<=data->till))
+        {
+            // entries of a channel are ordered by eiteventid, take the best source of each
+            std::multimap<cXMLTVCacheData::tEITKey,cXMLTVCacheEntry *>::iterator it;
+            it=data->eitids.lower_bound(cXMLTVCacheData::tEITKey(channelid,0));
+            while ((it!=data->eitids.end()) && (it->first.first==channelid))
+            {
+                cXMLTVCacheEntry *best=NULL;
+                tEventID eiteventid=it->first.second;
+                for (; (it!=data->eitids.end()) && (it->first.first==channelid) &&
+                        (it->first.second==eiteventid); it++)
+                {
+                    time_t st=it->second->event.StartTime();
+                    if ((st<From) || (st>Till)) continue;
+                    if (!best || (it->second->srcidx<best->srcidx)) best=it->second;
+                }
+                if (!best) continue;
+                cXMLTV2VDREventInfo *info=new cXMLTV2VDREventInfo;
+                if (!info) break;
+                cXMLTVEvent xevent;
+                xevent.CopyFrom(&best->event);
+                FillInfo(&xevent,info);
+                Events->Add(info);
+                cnt++;
+            }
+            infohits++;
+        }
+        else
+        {
+            cnt=-1;
+        }
+    }
+    if (cnt<0) cnt=DBInfo(channelid.c_str(),0,From,Till,Events);
+    Events->Sort();
+    return cnt;
+}
@@ -0,0 +1,96 @@
+/*
+ * cache.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef _CACHE_H
+#define _CACHE_H
+
+#include <sqlite3.h>
+#include <map>
+#include <set>
+#include <string>
+#include <vdr/thread.h>
+#include "event.h"
+#include "services.h"
+
+#define XMLTVCACHE_HOURS 24
+#define XMLTVCACHE_NEGMAX 65536
+
+#define XMLTVCACHE_MISS     0
+#define XMLTVCACHE_HIT      1
+#define XMLTVCACHE_UNKNOWN -1
+
+#define XMLTVCACHE_EIT_SET   0 // eiteventid/eitdescription as in the event
+#define XMLTVCACHE_EIT_KEEP  1 // keep eiteventid/eitdescription of the cached row
+#define XMLTVCACHE_EIT_CLEAR 2 // row has no eiteventid/eitdescription
+
+class cGlobals;
+
+class cXMLTVCacheEntry
+{
+public:
+    cXMLTVEvent event;
+    int srcidx;
+    std::string titlekey; // normalized title or soundex, see MatchKey
+    unsigned int titlehash;
+};
+
+class cXMLTVCacheData
+{
+public:
+    typedef std::pair<std::string,std::pair<std::string,tEventID> > tRowKey; // src,channelid,eventid
+    typedef std::pair<std::string,tEventID> tEITKey; // channelid,eiteventid
+    typedef std::pair<std::string,std::pair<time_t,unsigned int> > tTitleKey; // channelid,hour,titlehash
+    time_t from,till;
+    std::map<tRowKey,cXMLTVCacheEntry *> rows;
+    std::multimap<tEITKey,cXMLTVCacheEntry *> eitids;
+    std::multimap<tTitleKey,cXMLTVCacheEntry *> titles;
+    cXMLTVCacheData(time_t From, time_t Till);
+    ~cXMLTVCacheData();
+    void Add(const char *ChannelID, cXMLTVCacheEntry *Entry);
+    void Remove(const tRowKey &Key);
+};
+
+class cXMLTVCache
+{
+private:
+    cMutex mutex;
+    cGlobals *g;
+    cXMLTVCacheData *data;
+    int generation;
+    std::map<std::string,std::set<unsigned long long> > negative; // channelid -> eventid/starttime
+    int negcount;
+    int hits,misses,neghits,dblookups,dbmisses;
+    int infohits,infodb;
+    static unsigned long long NegKey(const cEvent *Event);
+    void ClearNegative();
+    static unsigned int Hash(const char *Value);
+    void MatchKey(const char *Title, std::string &Key);
+    static bool Better(cXMLTVCacheEntry *Entry, cXMLTVCacheEntry *Best, time_t StartTime);
+    static void CopyList(cStringList &To, cXMLTVStringList *From);
+    static void FillInfo(cXMLTVEvent *xEvent, cXMLTV2VDREventInfo *Info);
+    int DBInfo(const char *ChannelID, tEventID EventID, time_t From, time_t Till,
+               cList<cXMLTV2VDREventInfo> *Events, cXMLTV2VDREventInfo *Info=NULL);
+public:
+    cXMLTVCache(cGlobals *Global);
+    ~cXMLTVCache();
+    void Refresh();
+    void Clear();
+    int Generation()
+    {
+        return generation;
+    }
+    int Lookup(const char *ChannelID, const cEvent *Event, int TimeDiff, cXMLTVEvent **xEvent);
+    bool IsNegative(const char *ChannelID, const cEvent *Event);
+    void AddNegative(const char *ChannelID, const cEvent *Event);
+    bool GetInfo(tChannelID ChannelID, tEventID EventID, cXMLTV2VDREventInfo *Info);
+    int GetInfo(tChannelID ChannelID, time_t From, time_t Till, cList<cXMLTV2VDREventInfo> *Events);
+    cString Stats();
+    void Put(const char *Source, const char *ChannelID, cXMLTVEvent *xEvent, int SrcIdx=-1,
+             int EIT=XMLTVCACHE_EIT_SET);
+};
+
+#endif
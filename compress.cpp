@@ -0,0 +1,390 @@
+/*
+ * compress.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <string>
+#include <vector>
+#include "xmltv2vdr.h"
+#include "compress.h"
+#include "debug.h"
+#ifdef USE_ZSTD
+#include <zdict.h>
+#endif
+
+cEPGCompression::cEPGCompression(cGlobals *Global)
+{
+    g=Global;
+#ifdef USE_ZSTD
+    generation=-1;
+    cctx=NULL;
+    cdict=NULL;
+    cdictid=0;
+#endif
+    encoded=encodedin=encodedout=encodetime=0;
+    decoded=decodetime=0;
+    failed=0;
+}
+
+cEPGCompression::~cEPGCompression()
+{
+#ifdef USE_ZSTD
+    ZSTD_freeCDict(cdict);
+    for (std::map<unsigned int,ZSTD_DDict *>::iterator it=ddicts.begin(); it!=ddicts.end(); ++it)
+        ZSTD_freeDDict(it->second);
+    ZSTD_freeCCtx(cctx);
+#endif
+}
+
+#ifdef USE_ZSTD
+// every thread decodes with its own context, the dictionaries are shared
+class cEPGDecompressionContext
+{
+public:
+    ZSTD_DCtx *dctx;
+    cEPGDecompressionContext()
+    {
+        dctx=ZSTD_createDCtx();
+    }
+    ~cEPGDecompressionContext()
+    {
+        ZSTD_freeDCtx(dctx);
+    }
+};
+
+static thread_local cEPGDecompressionContext decompression;
+
+void cEPGCompression::SetDictionary(const void *Dict, int Size, unsigned int ID)
+{
+    // mutex must be held
+    ZSTD_freeCDict(cdict);
+    cdict=NULL;
+    cdictid=0;
+    generation=g->DBGeneration();
+    if (!Dict || !Size) return;
+    cdict=ZSTD_createCDict(Dict,Size,EPGZ_LEVEL);
+    if (cdict) cdictid=ID;
+}
+
+bool cEPGCompression::LoadDictionary(sqlite3 *Db)
+{
+    // mutex must be held, the newest dictionary of our version is used for compression
+    sqlite3_stmt *stmt;
+    SetDictionary(NULL,0,0);
+    if (sqlite3_prepare_v2(Db,"select id,dict from dicts where version=?1 order by rowid desc limit 1;",
+                           -1,&stmt,NULL)!=SQLITE_OK) return false;
+    sqlite3_bind_int(stmt,1,EPGZ_VERSION);
+    if (sqlite3_step(stmt)==SQLITE_ROW)
+    {
+        SetDictionary(sqlite3_column_blob(stmt,1),sqlite3_column_bytes(stmt,1),
+                      (unsigned int) sqlite3_column_int64(stmt,0));
+    }
+    sqlite3_finalize(stmt);
+    return (cdict!=NULL);
+}
+
+ZSTD_DDict *cEPGCompression::DecompressionDictionary(sqlite3 *Db, unsigned int ID)
+{
+    // mutex must be held, dictionaries are kept until the plugin stops
+    std::map<unsigned int,ZSTD_DDict *>::iterator it=ddicts.find(ID);
+    if (it!=ddicts.end()) return it->second;
+
+    sqlite3 *db=Db ? Db : g->EPGDatabase()->GetReader();
+    if (!db) return NULL;
+    ZSTD_DDict *ddict=NULL;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db,"select dict from dicts where id=?1;",-1,&stmt,NULL)==SQLITE_OK)
+    {
+        sqlite3_bind_int64(stmt,1,ID);
+        if (sqlite3_step(stmt)==SQLITE_ROW)
+            ddict=ZSTD_createDDict(sqlite3_column_blob(stmt,0),sqlite3_column_bytes(stmt,0));
+        sqlite3_finalize(stmt);
+    }
+    if (!Db) g->EPGDatabase()->PutReader(db);
+    if (!ddict) return NULL;
+    ddicts[ID]=ddict;
+    return ddict;
+}
+
+void cEPGCompression::SQLCompress(sqlite3_context *Context, int UNUSED(Argc), sqlite3_value **Argv)
+{
+    cEPGCompression *codec=(cEPGCompression *) sqlite3_user_data(Context);
+    int len=sqlite3_value_bytes(Argv[0]);
+    if (!codec->g->Compress() || (sqlite3_value_type(Argv[0])!=SQLITE_TEXT) || (len<EPGZ_MINSIZE))
+    {
+        sqlite3_result_value(Context,Argv[0]);
+        return;
+    }
+    const char *text=(const char *) sqlite3_value_text(Argv[0]);
+
+    cMutexLock lock(&codec->mutex);
+    if (codec->generation!=codec->g->DBGeneration())
+        codec->LoadDictionary(sqlite3_context_db_handle(Context));
+    if (!codec->cctx) codec->cctx=ZSTD_createCCtx();
+    if (!codec->cdict || !codec->cctx)
+    {
+        sqlite3_result_value(Context,Argv[0]);
+        return;
+    }
+    uint64_t start=cEPGSourceStats::Now();
+    size_t bound=ZSTD_compressBound(len);
+    void *buf=malloc(bound);
+    if (!buf)
+    {
+        sqlite3_result_value(Context,Argv[0]);
+        return;
+    }
+    size_t ret=ZSTD_compress_usingCDict(codec->cctx,buf,bound,text,len,codec->cdict);
+    if (ZSTD_isError(ret) || (ret>=(size_t) len))
+    {
+        // not worth it, keep the text
+        free(buf);
+        sqlite3_result_value(Context,Argv[0]);
+        return;
+    }
+    codec->encoded++;
+    codec->encodedin+=len;
+    codec->encodedout+=ret;
+    codec->encodetime+=cEPGSourceStats::Now()-start;
+    sqlite3_result_blob(Context,buf,ret,free);
+}
+#endif
+
+void cEPGCompression::Failed(const char *Reason)
+{
+    cMutexLock lock(&mutex);
+    if (!(failed++ % EPGZ_LOGFAILED)) esyslog("compression: cannot decode text, %s (%i failed)",Reason,failed);
+}
+
+char *cEPGCompression::Decompress(sqlite3 *Db, const void *Data, int Size)
+{
+    if (!Data || (Size<=0)) return NULL;
+#ifdef USE_ZSTD
+    unsigned long long len=ZSTD_getFrameContentSize(Data,Size);
+    if ((len==ZSTD_CONTENTSIZE_UNKNOWN) || (len==ZSTD_CONTENTSIZE_ERROR))
+    {
+        Failed("no zstd frame");
+        return NULL;
+    }
+    uint64_t start=cEPGSourceStats::Now();
+    ZSTD_DDict *ddict;
+    {
+        cMutexLock lock(&mutex);
+        ddict=DecompressionDictionary(Db,ZSTD_getDictID_fromFrame(Data,Size));
+    }
+    if (!ddict)
+    {
+        Failed("unknown dictionary");
+        return NULL;
+    }
+    char *text=(char *) malloc(len+1);
+    if (!text || !decompression.dctx)
+    {
+        free(text);
+        Failed("out of memory");
+        return NULL;
+    }
+    size_t ret=ZSTD_decompress_usingDDict(decompression.dctx,text,len,Data,Size,ddict);
+    if (ZSTD_isError(ret) || (ret!=len))
+    {
+        free(text);
+        Failed(ZSTD_isError(ret) ? ZSTD_getErrorName(ret) : "short frame");
+        return NULL;
+    }
+    text[len]=0;
+    cMutexLock lock(&mutex);
+    decoded++;
+    decodetime+=cEPGSourceStats::Now()-start;
+    return text;
+#else
+    (void) Db;
+    Failed("plugin built without libzstd");
+    return NULL;
+#endif
+}
+
+void cEPGCompression::SQLDecompress(sqlite3_context *Context, int UNUSED(Argc), sqlite3_value **Argv)
+{
+    cEPGCompression *codec=(cEPGCompression *) sqlite3_user_data(Context);
+    if (sqlite3_value_type(Argv[0])!=SQLITE_BLOB)
+    {
+        sqlite3_result_value(Context,Argv[0]);
+        return;
+    }
+    char *text=codec->Decompress(sqlite3_context_db_handle(Context),sqlite3_value_blob(Argv[0]),
+                                 sqlite3_value_bytes(Argv[0]));
+    if (text)
+    {
+        sqlite3_result_text(Context,text,-1,free);
+    }
+    else
+    {
+        sqlite3_result_null(Context);
+    }
+}
+
+void cEPGCompression::Register(sqlite3 *Db)
+{
+    if (!Db) return;
+#ifdef USE_ZSTD
+    if (sqlite3_create_function(Db,"xtvz",1,SQLITE_UTF8,this,SQLCompress,NULL,NULL)!=SQLITE_OK)
+        esyslog("sqlite3: %s (compression)",sqlite3_errmsg(Db));
+#endif
+    if (sqlite3_create_function(Db,"xtvunz",1,SQLITE_UTF8,this,SQLDecompress,NULL,NULL)!=SQLITE_OK)
+        esyslog("sqlite3: %s (compression)",sqlite3_errmsg(Db));
+}
+
+char *cEPGCompression::Decompress(const void *Data, int Size)
+{
+    return Decompress(NULL,Data,Size);
+}
+
+bool cEPGCompression::Train(sqlite3 *Db)
+{
+#ifdef USE_ZSTD
+    if (!Db || !g->Compress()) return false;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(Db,"select count(*) from dicts where version=?1;",-1,&stmt,NULL)!=SQLITE_OK)
+    {
+        esyslog("sqlite3: %s (compression)",sqlite3_errmsg(Db));
+        return false;
+    }
+    sqlite3_bind_int(stmt,1,EPGZ_VERSION);
+    int dicts=(sqlite3_step(stmt)==SQLITE_ROW) ? sqlite3_column_int(stmt,0) : 0;
+    sqlite3_finalize(stmt);
+    if (dicts) return true;
+
+    // samples are the texts stored uncompressed up to now
+    std::vector<int> days;
+    if (!cEPGDatabase::Days(Db,days)) return false;
+    std::string samples;
+    std::vector<size_t> sizes;
+    for (size_t i=0; (i<days.size()) && (sizes.size()<EPGZ_MAXSAMPLES); i++)
+    {
+        cString sql=cString::sprintf("select description,credits,review from epgevents_%i limit ?1;",days[i]);
+        if (sqlite3_prepare_v2(Db,sql,-1,&stmt,NULL)!=SQLITE_OK)
+        {
+            esyslog("sqlite3: %s (compression)",sqlite3_errmsg(Db));
+            return false;
+        }
+        sqlite3_bind_int(stmt,1,EPGZ_MAXSAMPLES-sizes.size());
+        while ((sqlite3_step(stmt)==SQLITE_ROW) && (samples.size()<EPGZ_SAMPLEBYTES))
+        {
+            for (int col=0; col<3; col++)
+            {
+                if (sqlite3_column_type(stmt,col)!=SQLITE_TEXT) continue;
+                int len=sqlite3_column_bytes(stmt,col);
+                if (len<EPGZ_MINSIZE) continue;
+                samples.append((const char *) sqlite3_column_text(stmt,col),len);
+                sizes.push_back(len);
+            }
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (sizes.size()<EPGZ_MINSAMPLES)
+    {
+        dsyslog("compression: only %i texts, no dictionary yet",(int) sizes.size());
+        return false;
+    }
+
+    void *dict=malloc(EPGZ_DICTSIZE);
+    if (!dict) return false;
+    uint64_t start=cEPGSourceStats::Now();
+    size_t size=ZDICT_trainFromBuffer(dict,EPGZ_DICTSIZE,samples.data(),&sizes[0],sizes.size());
+    if (ZDICT_isError(size))
+    {
+        esyslog("zstd: training failed, %s",ZDICT_getErrorName(size));
+        free(dict);
+        return false;
+    }
+    unsigned int id=ZDICT_getDictID(dict,size);
+
+    bool ret=false;
+    if (sqlite3_prepare_v2(Db,"insert or replace into dicts (id,version,dict) values (?1,?2,?3);",
+                           -1,&stmt,NULL)==SQLITE_OK)
+    {
+        sqlite3_bind_int64(stmt,1,id);
+        sqlite3_bind_int(stmt,2,EPGZ_VERSION);
+        sqlite3_bind_blob(stmt,3,dict,size,SQLITE_STATIC);
+        ret=(sqlite3_step(stmt)==SQLITE_DONE);
+        sqlite3_finalize(stmt);
+    }
+    if (!ret)
+    {
+        esyslog("sqlite3: %s (compression)",sqlite3_errmsg(Db));
+        free(dict);
+        return false;
+    }
+    {
+        cMutexLock lock(&mutex);
+        SetDictionary(dict,size,id);
+    }
+    free(dict);
+    isyslog("compression: trained dictionary %u from %i texts in %llu ms",id,(int) sizes.size(),
+            (unsigned long long) (cEPGSourceStats::Now()-start)/1000);
+
+    // compress the rows which are already stored in small steps, through the
+    // writer when it runs, so the write lock is never held for long
+    cEPGWriter *writer=g->EPGWriter()->Active() ? g->EPGWriter() : NULL;
+    const char *tables[2]={"epgevents","epglinks"};
+    const char *columns[2]={"description=xtvz(description),credits=xtvz(credits),review=xtvz(review)",
+                            "eitdescription=xtvz(eitdescription)"};
+    int steps=0,failed=0;
+    for (size_t i=0; i<days.size(); i++)
+    {
+        for (int t=0; t<2; t++)
+        {
+            sqlite3_int64 first=0,last=-1;
+            if (sqlite3_prepare_v2(Db,*cString::sprintf("select min(rowid),max(rowid) from %s_%i;",tables[t],days[i]),
+                                   -1,&stmt,NULL)!=SQLITE_OK) continue;
+            if (sqlite3_step(stmt)==SQLITE_ROW)
+            {
+                first=sqlite3_column_int64(stmt,0);
+                last=sqlite3_column_int64(stmt,1);
+            }
+            sqlite3_finalize(stmt);
+            for (sqlite3_int64 rowid=first; rowid<=last; rowid+=EPGZ_TRAINROWS)
+            {
+                cString sql=cString::sprintf("UPDATE %s_%i SET %s WHERE rowid>=%lld AND rowid<%lld;",tables[t],
+                                             days[i],columns[t],(long long) rowid,(long long) rowid+EPGZ_TRAINROWS);
+                steps++;
+                if (writer)
+                {
+                    if (!writer->Queue(sql,EPGDB_BUSYTIMEOUT)) failed++;
+                    continue;
+                }
+                char *errmsg;
+                if (sqlite3_exec(Db,sql,NULL,NULL,&errmsg)!=SQLITE_OK)
+                {
+                    if (!failed++) esyslog("sqlite3: %s (compression)",errmsg);
+                    sqlite3_free(errmsg);
+                }
+            }
+        }
+    }
+    if (failed) esyslog("compression: %i of %i steps failed",failed,steps);
+    return true;
+#else
+    (void) Db;
+    return false;
+#endif
+}
+
+cString cEPGCompression::Stats()
+{
+    cMutexLock lock(&mutex);
+#ifdef USE_ZSTD
+    unsigned int dictid=cdictid;
+#else
+    unsigned int dictid=0;
+#endif
+    return cString::sprintf("compression dict=%u encoded=%llu in=%llu out=%llu ratio=%i encms=%llu "
+                            "decoded=%llu decms=%llu failed=%i",dictid,
+                            (unsigned long long) encoded,(unsigned long long) encodedin,
+                            (unsigned long long) encodedout,
+                            encodedin ? (int) ((encodedout*100)/encodedin) : 0,
+                            (unsigned long long) encodetime/1000,(unsigned long long) decoded,
+                            (unsigned long long) decodetime/1000,failed);
+}
@@ -0,0 +1,74 @@
+/*
+ * compress.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef _COMPRESS_H
+#define _COMPRESS_H
+
+#include <sqlite3.h>
+#include <stdint.h>
+#include <map>
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+#ifdef USE_ZSTD
+#include <zstd.h>
+#endif
+
+#define EPGZ_VERSION     1       // format of the compressed values, dictionaries are stored per version
+#define EPGZ_LEVEL       3
+#define EPGZ_DICTSIZE    65536   // bytes
+#define EPGZ_MINSIZE     64      // shorter texts are stored uncompressed
+#define EPGZ_MINSAMPLES  500     // texts needed to train a dictionary
+#define EPGZ_MAXSAMPLES  20000
+#define EPGZ_SAMPLEBYTES 8388608
+#define EPGZ_LOGFAILED   1000    // log every n-th failed decompression
+#define EPGZ_TRAINROWS   200     // rows compressed per transaction after training
+
+// description, eitdescription, credits and review are written through
+// xtvz(), which returns a zstd frame (blob) once a dictionary exists and
+// compression is enabled in the setup. xtvunz() fails on blobs it cannot
+// decode (e.g. without libzstd), they are never returned as text.
+#ifdef USE_ZSTD
+#define EPGZ(value) "xtvz(" value ")"
+#else
+#define EPGZ(value) value
+#endif
+#define EPGUNZ(column) "xtvunz(" column ")"
+
+class cGlobals;
+
+class cEPGCompression
+{
+private:
+    cMutex mutex;
+    cGlobals *g;
+#ifdef USE_ZSTD
+    int generation;
+    ZSTD_CCtx *cctx;
+    ZSTD_CDict *cdict;
+    unsigned int cdictid;
+    std::map<unsigned int,ZSTD_DDict *> ddicts;
+    void SetDictionary(const void *Dict, int Size, unsigned int ID);
+    bool LoadDictionary(sqlite3 *Db);
+    ZSTD_DDict *DecompressionDictionary(sqlite3 *Db, unsigned int ID);
+    static void SQLCompress(sqlite3_context *Context, int Argc, sqlite3_value **Argv);
+#endif
+    char *Decompress(sqlite3 *Db, const void *Data, int Size);
+    void Failed(const char *Reason);
+    static void SQLDecompress(sqlite3_context *Context, int Argc, sqlite3_value **Argv);
+    uint64_t encoded,encodedin,encodedout,encodetime;
+    uint64_t decoded,decodetime;
+    int failed;
+public:
+    cEPGCompression(cGlobals *Global);
+    ~cEPGCompression();
+    void Register(sqlite3 *Db);
+    bool Train(sqlite3 *Db);
+    char *Decompress(const void *Data, int Size);
+    cString Stats();
+};
+
+#endif
@@ -0,0 +1,754 @@
+/*
+ * db.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <unistd.h>
+#include <errno.h>
+#include <limits.h>
+#include <string>
+#include "xmltv2vdr.h"
+#include "db.h"
+#include "debug.h"
+
+cEPGDatabase::cEPGDatabase(cGlobals *Global)
+{
+    g=Global;
+    dropped=0;
+    CheckFullText();
+}
+
+cEPGDatabase::~cEPGDatabase()
+{
+    CloseReaders();
+}
+
+bool cEPGDatabase::Open(sqlite3 **Db, int Flags, int BusyTimeout)
+{
+    if (!Db) return false;
+    *Db=NULL;
+    if (!g->EPGFile()) return false;
+    if (sqlite3_open_v2(g->EPGFile(),Db,Flags,NULL)!=SQLITE_OK)
+    {
+        sqlite3_close(*Db);
+        *Db=NULL;
+        return false;
+    }
+    sqlite3_busy_timeout(*Db,BusyTimeout);
+    g->EPGCompression()->Register(*Db);
+    if ((Flags & SQLITE_OPEN_READWRITE)==SQLITE_OPEN_READWRITE)
+    {
+        // auto_vacuum must be set before the journal mode on new databases
+        char *errmsg;
+        if (sqlite3_exec(*Db,"PRAGMA auto_vacuum=INCREMENTAL; PRAGMA journal_mode=WAL; " \
+                         "PRAGMA synchronous=NORMAL;",NULL,NULL,&errmsg)!=SQLITE_OK)
+        {
+            tsyslog("sqlite3: %s (open)",errmsg);
+            sqlite3_free(errmsg);
+        }
+    }
+    return true;
+}
+
+sqlite3 *cEPGDatabase::GetReader()
+{
+    {
+        cMutexLock lock(&mutex);
+        for (cEPGDatabaseReader *reader=readers.First(); reader; reader=readers.First())
+        {
+            sqlite3 *db=reader->db;
+            bool stale=(reader->generation!=g->DBReplaced());
+            readers.Del(reader);
+            if (!stale) return db;
+            sqlite3_close(db);
+        }
+    }
+    if (!g->DBExists()) return NULL;
+    sqlite3 *db;
+    if (!Open(&db,SQLITE_OPEN_READONLY)) return NULL;
+    return db;
+}
+
+void cEPGDatabase::PutReader(sqlite3 *Db)
+{
+    if (!Db) return;
+    cMutexLock lock(&mutex);
+    if (readers.Count()>=EPGDB_MAXREADERS)
+    {
+        sqlite3_close(Db);
+        return;
+    }
+    cEPGDatabaseReader *reader=new cEPGDatabaseReader;
+    if (!reader)
+    {
+        sqlite3_close(Db);
+        return;
+    }
+    reader->db=Db;
+    reader->generation=g->DBReplaced();
+    readers.Add(reader);
+}
+
+void cEPGDatabase::CloseReaders()
+{
+    cMutexLock lock(&mutex);
+    for (cEPGDatabaseReader *reader=readers.First(); reader; reader=readers.Next(reader))
+    {
+        sqlite3_close(reader->db);
+    }
+    readers.Clear();
+}
+
+bool cEPGDatabase::Unlink()
+{
+    if (!g->EPGFile()) return false;
+    CloseReaders();
+    bool ret=true;
+    if (unlink(g->EPGFile())==-1) ret=false;
+    cString wal=cString::sprintf("%s-wal",g->EPGFile());
+    if ((unlink(wal)==-1) && (errno!=ENOENT)) esyslog("failed to remove %s",*wal);
+    cString shm=cString::sprintf("%s-shm",g->EPGFile());
+    if ((unlink(shm)==-1) && (errno!=ENOENT)) esyslog("failed to remove %s",*shm);
+    g->DBChanged(true);
+    return ret;
+}
+
+// the xmltv data is partitioned by (utc) day of the starttime, each day has
+// its own epgevents_<day>/epglinks_<day> tables and an epg_<day> view, the
+// view epg is the union of all days
+static const char *partitionsql=
+    "CREATE TABLE IF NOT EXISTS epgevents_%1$i (" \
+    "src nvarchar(100), xmltvid nvarchar(255), eventid int, "\
+    "starttime datetime, duration int, title nvarchar(255), alttitle nvarchar(255), "\
+    "origtitle nvarchar(255), shorttext nvarchar(255), description text, "\
+    "country nvarchar(255), year int, " \
+    "credits text, category text, review text, rating text, " \
+    "starrating text, video text, audio text, season int, episode int, " \
+    "episodeoverall int, pics text, srcidx int, titlekey nvarchar(255), soundex nvarchar(10), " \
+    "epcheck int default 0, changeseq int default 0, signature int, " \
+    "PRIMARY KEY(eventid, src, xmltvid)" \
+    ");" \
+    "CREATE INDEX IF NOT EXISTS idx3_%1$i on epgevents_%1$i (starttime, duration, src); " \
+    "CREATE INDEX IF NOT EXISTS idx5_%1$i on epgevents_%1$i (titlekey, starttime); " \
+    "CREATE INDEX IF NOT EXISTS idx6_%1$i on epgevents_%1$i (soundex, starttime); " \
+    "CREATE TABLE IF NOT EXISTS epglinks_%1$i (" \
+    "src nvarchar(100), xmltvid nvarchar(255), eventid int, channelid nvarchar(255), " \
+    "eiteventid int, eitdescription text, " \
+    "PRIMARY KEY(eventid, src, channelid)" \
+    ");" \
+    "CREATE INDEX IF NOT EXISTS idx1_%1$i on epglinks_%1$i (channelid, eiteventid); " \
+    "CREATE INDEX IF NOT EXISTS idx7_%1$i on epglinks_%1$i (src, xmltvid, eventid); " \
+    "CREATE TRIGGER IF NOT EXISTS epgevents_delete_%1$i AFTER DELETE ON epgevents_%1$i BEGIN " \
+    "DELETE FROM epglinks_%1$i WHERE src=old.src AND xmltvid=old.xmltvid AND eventid=old.eventid; " \
+    "END;" \
+    "CREATE VIEW IF NOT EXISTS epg_%1$i AS SELECT " \
+    "e.src AS src, l.channelid AS channelid, e.eventid AS eventid, l.eiteventid AS eiteventid, " \
+    "e.starttime AS starttime, e.duration AS duration, e.title AS title, e.alttitle AS alttitle, " \
+    "e.origtitle AS origtitle, e.shorttext AS shorttext, e.description AS description, " \
+    "l.eitdescription AS eitdescription, e.country AS country, e.year AS year, " \
+    "e.credits AS credits, e.category AS category, e.review AS review, e.rating AS rating, " \
+    "e.starrating AS starrating, e.video AS video, e.audio AS audio, e.season AS season, " \
+    "e.episode AS episode, e.episodeoverall AS episodeoverall, e.pics AS pics, " \
+    "e.srcidx AS srcidx, e.titlekey AS titlekey, e.soundex AS soundex, e.epcheck AS epcheck, " \
+    "e.xmltvid AS xmltvid, e.changeseq AS changeseq " \
+    "FROM epglinks_%1$i l JOIN epgevents_%1$i e ON e.eventid=l.eventid AND e.src=l.src " \
+    "AND e.xmltvid=l.xmltvid;";
+
+// full text index of a day. With sqlite 3.43 or later it is contentless,
+// so the texts are only stored in epgevents_<day>, older versions keep a
+// copy of the texts in the index. Inserts and updates are written with the
+// uncompressed texts by the writers (see EPGDB_FTSINDEX), deleted rows are
+// removed by the trigger. The first fill of an existing day is done here.
+static const char *fulltextsql=
+    "CREATE VIRTUAL TABLE epgfts_%1$i USING fts5(" \
+    "title, shorttext, description, credits, category%2$s" \
+    ");" \
+    "CREATE TRIGGER epgfts_delete_%1$i AFTER DELETE ON epgevents_%1$i BEGIN " \
+    "DELETE FROM epgfts_%1$i WHERE rowid=old.rowid; " \
+    "END;" \
+    "INSERT INTO epgfts_%1$i (rowid,title,shorttext,description,credits,category) " \
+    "SELECT rowid,title,shorttext," EPGUNZ("description") "," EPGUNZ("credits") ",category FROM epgevents_%1$i;";
+
+// index of older versions, the triggers called xtvunz
+static const char *dropfulltextsql=
+    "DROP TRIGGER IF EXISTS epgfts_insert_%1$i; DROP TRIGGER IF EXISTS epgfts_delete_%1$i; " \
+    "DROP TRIGGER IF EXISTS epgfts_update_%1$i; DROP TABLE IF EXISTS epgfts_%1$i;";
+
+int cEPGDatabase::fulltext=-1;
+
+void cEPGDatabase::CheckFullText()
+{
+    // sqlite may be built without fts5, the partitions still work then
+    if (fulltext>=0) return;
+    fulltext=EPGDB_FTSNONE;
+    sqlite3 *db;
+    if (sqlite3_open(":memory:",&db)!=SQLITE_OK)
+    {
+        sqlite3_close(db);
+        return;
+    }
+    if (sqlite3_exec(db,"CREATE VIRTUAL TABLE f USING fts5(t, content='', contentless_delete=1);",
+                     NULL,NULL,NULL)==SQLITE_OK)
+    {
+        fulltext=EPGDB_FTSCONTENTLESS;
+    }
+    else if (sqlite3_exec(db,"CREATE VIRTUAL TABLE f USING fts5(t);",NULL,NULL,NULL)==SQLITE_OK)
+    {
+        fulltext=EPGDB_FTSCONTENT;
+    }
+    else
+    {
+        isyslog("sqlite3 %s without fts5, full text search unavailable",sqlite3_libversion());
+    }
+    sqlite3_close(db);
+}
+
+bool cEPGDatabase::FullText(sqlite3 *Db, int Day)
+{
+    if (!Db || !FullTextAvailable()) return false;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(Db,"select name from sqlite_master where name in (?1,?2);",-1,&stmt,NULL)!=SQLITE_OK)
+        return false;
+    cString name=cString::sprintf("epgfts_%i",Day);
+    cString oldtrigger=cString::sprintf("epgfts_insert_%i",Day);
+    sqlite3_bind_text(stmt,1,name,-1,SQLITE_TRANSIENT);
+    sqlite3_bind_text(stmt,2,oldtrigger,-1,SQLITE_TRANSIENT);
+    bool exists=false,old=false;
+    int ret;
+    while ((ret=sqlite3_step(stmt))==SQLITE_ROW)
+    {
+        if (!strcmp((const char *) sqlite3_column_text(stmt,0),oldtrigger))
+            old=true;
+        else
+            exists=true;
+    }
+    sqlite3_finalize(stmt);
+    if (ret!=SQLITE_DONE) return false;
+    if (exists && !old) return true;
+
+    char *errmsg;
+    const char *options=(fulltext==EPGDB_FTSCONTENTLESS) ? ", content='', contentless_delete=1" : "";
+    if (sqlite3_exec(Db,"SAVEPOINT fts;",NULL,NULL,NULL)!=SQLITE_OK) return false;
+    if ((old && (sqlite3_exec(Db,*cString::sprintf(dropfulltextsql,Day),NULL,NULL,&errmsg)!=SQLITE_OK)) ||
+            (sqlite3_exec(Db,*cString::sprintf(fulltextsql,Day,options),NULL,NULL,&errmsg)!=SQLITE_OK))
+    {
+        esyslog("sqlite3: %s (fulltext %i)",errmsg,Day);
+        sqlite3_free(errmsg);
+        sqlite3_exec(Db,"ROLLBACK TO fts; RELEASE fts;",NULL,NULL,NULL);
+        if (old) sqlite3_exec(Db,*cString::sprintf(dropfulltextsql,Day),NULL,NULL,NULL);
+        return false;
+    }
+    sqlite3_exec(Db,"RELEASE fts;",NULL,NULL,NULL);
+    return true;
+}
+
+bool cEPGDatabase::Upgrade(sqlite3 *Db, int Day)
+{
+    // partitions created before the change sequence existed
+    if (!Db) return false;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(Db,*cString::sprintf("select changeseq from epgevents_%i limit 0;",Day),
+                           -1,&stmt,NULL)==SQLITE_OK)
+    {
+        sqlite3_finalize(stmt);
+    }
+    else
+    {
+        char *errmsg;
+        cString sql=cString::sprintf("ALTER TABLE epgevents_%1$i ADD COLUMN changeseq int default 0; " \
+                                     "ALTER TABLE epgevents_%1$i ADD COLUMN signature int; " \
+                                     "DROP VIEW IF EXISTS epg_%1$i;",Day);
+        if ((sqlite3_exec(Db,sql,NULL,NULL,&errmsg)!=SQLITE_OK) ||
+                (sqlite3_exec(Db,*cString::sprintf(partitionsql,Day),NULL,NULL,&errmsg)!=SQLITE_OK))
+        {
+            esyslog("sqlite3: %s (upgrade %i)",errmsg,Day);
+            sqlite3_free(errmsg);
+            return false;
+        }
+    }
+    FullText(Db,Day);
+    return true;
+}
+
+bool cEPGDatabase::Days(sqlite3 *Db, std::vector<int> &Days)
+{
+    Days.clear();
+    if (!Db) return false;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(Db,"select day from epgdays order by day;",-1,&stmt,NULL)!=SQLITE_OK)
+        return false;
+    while (sqlite3_step(stmt)==SQLITE_ROW)
+        Days.push_back(sqlite3_column_int(stmt,0));
+    sqlite3_finalize(stmt);
+    return true;
+}
+
+bool cEPGDatabase::CreateView(sqlite3 *Db, int From)
+{
+    std::vector<int> days;
+    if (!Days(Db,days)) return false;
+    std::string sql="DROP VIEW IF EXISTS epg; CREATE VIEW epg AS ";
+    bool first=true;
+    for (size_t i=0; i<days.size(); i++)
+    {
+        if (days[i]<From) continue;
+        if (!first) sql+=" UNION ALL ";
+        sql+=*cString::sprintf("SELECT * FROM epg_%i",days[i]);
+        first=false;
+    }
+    if (first)
+    {
+        // no partitions, the view is empty
+        sql+="SELECT ";
+        char *cols=strdup(EPGDB_VIEWCOLUMNS);
+        if (!cols) return false;
+        char *sp;
+        for (char *col=strtok_r(cols,",",&sp); col; col=strtok_r(NULL,",",&sp))
+        {
+            if (col!=cols) sql+=",";
+            sql+="NULL AS ";
+            sql+=col;
+        }
+        free(cols);
+        sql+=" WHERE 0";
+    }
+    sql+=";";
+    char *errmsg;
+    if (sqlite3_exec(Db,sql.c_str(),NULL,NULL,&errmsg)!=SQLITE_OK)
+    {
+        esyslog("sqlite3: %s (view)",errmsg);
+        sqlite3_free(errmsg);
+        return false;
+    }
+    return true;
+}
+
+bool cEPGDatabase::Partition(sqlite3 *Db, int Day)
+{
+    if (!Db) return false;
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(Db,"insert or ignore into epgdays (day) values (?1);",-1,&stmt,NULL)!=SQLITE_OK)
+    {
+        esyslog("sqlite3: %s (partition)",sqlite3_errmsg(Db));
+        return false;
+    }
+    sqlite3_bind_int(stmt,1,Day);
+    int ret=sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+    if (ret!=SQLITE_DONE)
+    {
+        esyslog("sqlite3: %s (partition)",sqlite3_errmsg(Db));
+        return false;
+    }
+    if (!sqlite3_changes(Db)) return true; // already there
+
+    char *errmsg;
+    if (sqlite3_exec(Db,*cString::sprintf(partitionsql,Day),NULL,NULL,&errmsg)!=SQLITE_OK)
+    {
+        esyslog("sqlite3: %s (partition %i)",errmsg,Day);
+        sqlite3_free(errmsg);
+        return false;
+    }
+    FullText(Db,Day);
+    return CreateView(Db);
+}
+
+int cEPGDatabase::DropPartitions(sqlite3 *Db, int Before)
+{
+    std::vector<int> days;
+    if (!Days(Db,days)) return -1;
+    if (days.empty() || (days[0]>=Before)) return 0;
+
+    char *errmsg;
+    if (sqlite3_exec(Db,"BEGIN",NULL,NULL,&errmsg)!=SQLITE_OK)
+    {
+        esyslog("sqlite3: %s (drop partitions)",errmsg);
+        sqlite3_free(errmsg);
+        return -1;
+    }
+    // the view must not reference the dropped days
+    bool ok=CreateView(Db,Before);
+    int cnt=0;
+    for (size_t i=0; ok && (i<days.size()) && (days[i]<Before); i++)
+    {
+        cString sql=cString::sprintf("DROP VIEW IF EXISTS epg_%1$i; DROP TABLE IF EXISTS epglinks_%1$i; " \
+                                     "DROP TABLE IF EXISTS epgfts_%1$i; DROP TABLE IF EXISTS epgevents_%1$i; " \
+                                     "DELETE FROM epgdays WHERE day=%1$i;",
+                                     days[i]);
+        if (sqlite3_exec(Db,sql,NULL,NULL,&errmsg)!=SQLITE_OK)
+        {
+            esyslog("sqlite3: %s (drop partition %i)",errmsg,days[i]);
+            sqlite3_free(errmsg);
+            ok=false;
+            break;
+        }
+        cnt++;
+    }
+    if (sqlite3_exec(Db,ok ? "COMMIT" : "ROLLBACK",NULL,NULL,&errmsg)!=SQLITE_OK)
+    {
+        esyslog("sqlite3: %s (drop partitions)",errmsg);
+        sqlite3_free(errmsg);
+        return -1;
+    }
+    if (!ok) return -1;
+    // cached statements of the dropped days are finalized by their owners
+    cMutexLock lock(&mutex);
+    if (Before>dropped) dropped=Before;
+    return cnt;
+}
+
+int cEPGDatabase::Dropped()
+{
+    // days before this one were dropped since the start
+    cMutexLock lock(&mutex);
+    return dropped;
+}
+
+cString cEPGDatabase::Search(const char *Query, const char *ChannelID, time_t From, time_t To, int &ReplyCode)
+{
+    ReplyCode=550;
+    if (!FullTextAvailable()) return "full text search unavailable\n";
+    if (!Query || !*Query) return "missing query\n";
+    sqlite3 *db=GetReader();
+    if (!db) return "no database\n";
+
+    std::vector<int> days;
+    if (!Days(db,days))
+    {
+        PutReader(db);
+        return "no database\n";
+    }
+
+    // the same event may be linked by more than one source, the one
+    // with the lowest srcidx is used
+    const char *sql="select l.channelid,l.eiteventid,e.starttime,e.duration,e.title,e.shorttext,min(e.srcidx) " \
+                    "from epgfts_%1$i f join epgevents_%1$i e on e.rowid=f.rowid " \
+                    "join epglinks_%1$i l on l.src=e.src and l.xmltvid=e.xmltvid and l.eventid=e.eventid " \
+                    "where epgfts_%1$i match ?1 and e.starttime>=?2 and e.starttime<=?3 " \
+                    "and (?4 is null or l.channelid=?4) " \
+                    "group by l.channelid,e.starttime order by e.starttime limit ?5;";
+
+    std::string result;
+    int cnt=0;
+    cString err=NULL;
+    for (size_t i=0; (i<days.size()) && (cnt<EPGDB_SEARCHMAX); i++)
+    {
+        if (From && (days[i]<Day(From))) continue;
+        if (To && (days[i]>Day(To))) break;
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db,*cString::sprintf(sql,days[i]),-1,&stmt,NULL)!=SQLITE_OK)
+        {
+            // no index for this day, see FullText
+            if (strstr(sqlite3_errmsg(db),"no such table")) continue;
+            err=cString::sprintf("%s\n",sqlite3_errmsg(db));
+            break;
+        }
+        sqlite3_bind_text(stmt,1,Query,-1,SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt,2,From);
+        sqlite3_bind_int64(stmt,3,To ? To : LLONG_MAX);
+        if (ChannelID) sqlite3_bind_text(stmt,4,ChannelID,-1,SQLITE_TRANSIENT);
+        sqlite3_bind_int(stmt,5,EPGDB_SEARCHMAX-cnt);
+        int ret;
+        while ((ret=sqlite3_step(stmt))==SQLITE_ROW)
+        {
+            const char *channelid=(const char *) sqlite3_column_text(stmt,0);
+            const char *title=(const char *) sqlite3_column_text(stmt,4);
+            const char *shorttext=(const char *) sqlite3_column_text(stmt,5);
+            result+=*cString::sprintf("%s %u %lli %i %s%s%s\n",channelid ? channelid : "",
+                                      (tEventID) sqlite3_column_int64(stmt,1),sqlite3_column_int64(stmt,2),
+                                      sqlite3_column_int(stmt,3),title ? title : "",shorttext ? "~" : "",
+                                      shorttext ? shorttext : "");
+            cnt++;
+        }
+        if (ret!=SQLITE_DONE) err=cString::sprintf("%s\n",sqlite3_errmsg(db));
+        sqlite3_finalize(stmt);
+        if (*err) break;
+    }
+    PutReader(db);
+
+    if (*err) return err;
+    if (!cnt) return "no events found\n";
+    ReplyCode=250;
+    return result.c_str();
+}
+
+// -------------------------------------------------------------
+
+cEPGWriter::cEPGWriter(cGlobals *Global): cThread("xmltv2vdr writer")
+{
+    g=Global;
+    dropped=0;
+}
+
+bool cEPGWriter::Queue(const char *SQL, int WaitMs)
+{
+    // the eit thread does not wait, a full queue is reported to the caller
+    if (!SQL) return false;
+    cMutexLock lock(&mutex);
+    cTimeMs timeout(WaitMs);
+    while (queue.size()>=EPGDB_QUEUEMAX)
+    {
+        if (!WaitMs || timeout.TimedOut() || !Running())
+        {
+            if (!dropped++) esyslog("too many eit changes queued, dropping");
+            return false;
+        }
+        drained.TimedWait(mutex,EPGDB_QUEUEWAIT);
+    }
+    if (dropped)
+    {
+        esyslog("dropped %i eit changes",dropped);
+        dropped=0;
+    }
+    queue.push_back(SQL);
+    if (queue.size()>=EPGDB_GROUPROWS) changed.Broadcast();
+    return true;
+}
+
+void cEPGWriter::Stop()
+{
+    Cancel(-1);
+    mutex.Lock();
+    changed.Broadcast();
+    drained.Broadcast();
+    mutex.Unlock();
+    Cancel(3);
+}
+
+bool cEPGWriter::Write(sqlite3 *Db, std::deque<std::string> &Batch)
+{
+    if (sqlite3_exec(Db,"BEGIN IMMEDIATE",NULL,NULL,NULL)!=SQLITE_OK)
+    {
+        tsyslog("sqlite3: %s (writer)",sqlite3_errmsg(Db));
+        return false;
+    }
+    cTimeMs timer;
+    int failed=0;
+    for (size_t i=0; i<Batch.size(); i++)
+    {
+        if (sqlite3_exec(Db,Batch[i].c_str(),NULL,NULL,NULL)==SQLITE_OK) continue;
+        int ret=sqlite3_errcode(Db);
+        if ((ret==SQLITE_BUSY) || (ret==SQLITE_LOCKED))
+        {
+            tsyslog("sqlite3: %s (writer)",sqlite3_errmsg(Db));
+            sqlite3_exec(Db,"ROLLBACK",NULL,NULL,NULL);
+            return false;
+        }
+        if (!failed++) esyslog("sqlite3: %s (writer)",sqlite3_errmsg(Db));
+    }
+    if (sqlite3_exec(Db,"COMMIT",NULL,NULL,NULL)!=SQLITE_OK)
+    {
+        tsyslog("sqlite3: %s (writer)",sqlite3_errmsg(Db));
+        sqlite3_exec(Db,"ROLLBACK",NULL,NULL,NULL);
+        return false;
+    }
+    if (failed>1) esyslog("%i of %i eit changes failed",failed,(int) Batch.size());
+    tsyslog("wrote %i eit changes in %llims",(int) Batch.size(),(long long int) timer.Elapsed());
+    return true;
+}
+
+void cEPGWriter::Action()
+{
+    // group commit of the changes queued by the eit thread
+    sqlite3 *db=NULL;
+    int generation=-1;
+    std::deque<std::string> batch;
+    for (;;)
+    {
+        mutex.Lock();
+        if (Running() && (queue.size()<EPGDB_GROUPROWS)) changed.TimedWait(mutex,EPGDB_GROUPMS);
+        // one group per transaction, so other writers never wait long
+        while (!queue.empty() && (batch.size()<EPGDB_GROUPROWS))
+        {
+            batch.push_back(queue.front());
+            queue.pop_front();
+        }
+        bool done=(!Running() && queue.empty());
+        drained.Broadcast();
+        mutex.Unlock();
+
+        if (!batch.empty())
+        {
+            if (db && (generation!=g->DBReplaced()))
+            {
+                sqlite3_close(db);
+                db=NULL;
+            }
+            if (!db)
+            {
+                if (g->DBExists() && g->EPGDatabase()->Open(&db))
+                {
+                    generation=g->DBReplaced();
+                }
+                else
+                {
+                    batch.clear();
+                }
+            }
+            if (db)
+            {
+                if (Write(db,batch))
+                {
+                    batch.clear();
+                }
+                else if (!Running())
+                {
+                    esyslog("failed to write %i eit changes",(int) batch.size());
+                    batch.clear();
+                }
+            }
+        }
+        if (done && batch.empty()) break;
+    }
+    if (db) sqlite3_close(db);
+}
+
+// -------------------------------------------------------------
+
+cEPGBackup::cEPGBackup(cGlobals *Global): cThread("xmltv2vdr backup")
+{
+    g=Global;
+    pending=false;
+}
+
+bool cEPGBackup::Enabled()
+{
+    if ((!g->EPGFile()) || (!g->EPGFileStore())) return false;
+    return (strcmp(g->EPGFile(),g->EPGFileStore())!=0);
+}
+
+bool cEPGBackup::Copy(const char *From, const char *To, bool Throttle)
+{
+    // copy into a temporary file first, so To is always complete
+    cString tmp=cString::sprintf("%s_",To);
+    unlink(tmp);
+
+    sqlite3 *src=NULL;
+    if (sqlite3_open_v2(From,&src,SQLITE_OPEN_READONLY,NULL)!=SQLITE_OK)
+    {
+        esyslog("failed to open %s",From);
+        sqlite3_close(src);
+        return false;
+    }
+    sqlite3_busy_timeout(src,EPGDB_BUSYTIMEOUT);
+
+    sqlite3 *dst=NULL;
+    if (sqlite3_open_v2(tmp,&dst,SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE,NULL)!=SQLITE_OK)
+    {
+        esyslog("failed to create %s",*tmp);
+        sqlite3_close(dst);
+        sqlite3_close(src);
+        return false;
+    }
+
+    sqlite3_backup *backup=sqlite3_backup_init(dst,"main",src,"main");
+    if (!backup)
+    {
+        esyslog("sqlite3: %s (backup)",sqlite3_errmsg(dst));
+        sqlite3_close(dst);
+        sqlite3_close(src);
+        unlink(tmp);
+        return false;
+    }
+
+    cTimeMs timer;
+    int ret,steps=0,maxsteps=0;
+    for (;;)
+    {
+        // writers restart the backup, don't let them do this forever
+        int pages=EPGDB_BACKUPPAGES;
+        if (!Throttle || (maxsteps && (steps>maxsteps))) pages=-1;
+        ret=sqlite3_backup_step(backup,pages);
+        if ((ret!=SQLITE_OK) && (ret!=SQLITE_BUSY) && (ret!=SQLITE_LOCKED)) break;
+        if (!maxsteps) maxsteps=4*(sqlite3_backup_pagecount(backup)/EPGDB_BACKUPPAGES+1);
+        steps++;
+        if (Throttle && !Running()) break;
+        if ((ret==SQLITE_BUSY) || (ret==SQLITE_LOCKED))
+        {
+            // don't spin while a writer holds the lock
+            if (!Throttle && (timer.Elapsed()>EPGDB_BUSYTIMEOUT)) break;
+            sqlite3_sleep(10);
+        }
+        else if (Throttle)
+        {
+            cCondWait::SleepMs(10);
+        }
+    }
+    if (sqlite3_backup_finish(backup)!=SQLITE_OK) ret=sqlite3_errcode(dst);
+    sqlite3_close(dst);
+    sqlite3_close(src);
+
+    if (ret!=SQLITE_DONE)
+    {
+        if (ret!=SQLITE_OK) esyslog("sqlite3: %i backup of %s failed",ret,From);
+        unlink(tmp);
+        return false;
+    }
+    if (rename(tmp,To)==-1)
+    {
+        esyslog("failed to rename %s to %s",*tmp,To);
+        unlink(tmp);
+        return false;
+    }
+    dsyslog("copied %s to %s in %llims",From,To,(long long int) timer.Elapsed());
+    return true;
+}
+
+bool cEPGBackup::Restore()
+{
+    if (!Enabled()) return false;
+    if (access(g->EPGFileStore(),R_OK)==-1) return false; // no file?
+    // a wal left over from a crash belongs to the old file
+    cString wal=cString::sprintf("%s-wal",g->EPGFile());
+    unlink(wal);
+    cString shm=cString::sprintf("%s-shm",g->EPGFile());
+    unlink(shm);
+    return Copy(g->EPGFileStore(),g->EPGFile(),false);
+}
+
+bool cEPGBackup::Save()
+{
+    if (!Enabled()) return false;
+    if (!g->DBExists()) return false;
+    return Copy(g->EPGFile(),g->EPGFileStore(),false);
+}
+
+void cEPGBackup::Trigger()
+{
+    if (!Enabled()) return;
+    mutex.Lock();
+    pending=true;
+    changed.Broadcast();
+    mutex.Unlock();
+    Start();
+}
+
+void cEPGBackup::Stop()
+{
+    Cancel(-1);
+    mutex.Lock();
+    changed.Broadcast();
+    mutex.Unlock();
+    Cancel(3);
+}
+
+void cEPGBackup::Action()
+{
+    SetPriority(19);
+    if (ioprio_set(1,cThread::ThreadId(),7 | 3 << 13)==-1)
+    {
+        dsyslog("failed to set ioprio to 3,7");
+    }
+    // the thread stays, a trigger during a copy is never lost
+    while (Running())
+    {
+        mutex.Lock();
+        while (!pending && Running()) changed.Wait(mutex);
+        bool run=pending;
+        pending=false;
+        mutex.Unlock();
+        if (run && g->DBExists()) Copy(g->EPGFile(),g->EPGFileStore(),true);
+    }
+}
@@ -0,0 +1,122 @@
+/*
+ * db.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef _DB_H
+#define _DB_H
+
+#include <sqlite3.h>
+#include <time.h>
+#include <vector>
+#include <deque>
+#include <string>
+#include <vdr/thread.h>
+#include <vdr/tools.h>
+
+#define EPGDB_BUSYTIMEOUT     5000 // ms
+#define EPGDB_GROUPROWS       500  // commit after this many changed rows
+#define EPGDB_GROUPMS         2000 // or after this many ms
+#define EPGDB_MAXREADERS      4    // idle read connections kept open
+#define EPGDB_BACKUPPAGES     256  // pages copied per backup step
+#define EPGDB_DAYSECS         86400 // size of a partition (utc day)
+#define EPGDB_SEARCHMAX       100  // events returned by a search
+#define EPGDB_QUEUEMAX        10000 // changes of the eit thread waiting for the writer
+#define EPGDB_QUEUEWAIT       100  // ms between checks of a full queue
+#define EPGDB_DAYSAHEAD       14   // partitions created in advance by the housekeeping
+
+// full text support of the sqlite library, see cEPGDatabase::CheckFullText
+#define EPGDB_FTSNONE         0
+#define EPGDB_FTSCONTENT      1    // fts5, the index keeps a copy of the texts
+#define EPGDB_FTSCONTENTLESS  2    // fts5 with contentless_delete (sqlite 3.43)
+
+// writes the index of a row with the uncompressed texts, the rows are selected by the writer
+#define EPGDB_FTSINDEX "INSERT OR REPLACE INTO epgfts_%1$i (rowid,title,shorttext,description,credits,category) "
+
+// columns of the epg view and of the per day views epg_<day>
+#define EPGDB_VIEWCOLUMNS "src,channelid,eventid,eiteventid,starttime,duration,title,alttitle,origtitle," \
+                          "shorttext,description,eitdescription,country,year,credits,category,review," \
+                          "rating,starrating,video,audio,season,episode,episodeoverall,pics,srcidx," \
+                          "titlekey,soundex,epcheck,xmltvid,changeseq"
+
+class cGlobals;
+
+class cEPGDatabaseReader : public cListObject
+{
+public:
+    sqlite3 *db;
+    int generation;
+};
+
+class cEPGDatabase
+{
+private:
+    cMutex mutex;
+    cGlobals *g;
+    cList<cEPGDatabaseReader> readers;
+    int dropped;
+    static int fulltext;
+    static void CheckFullText();
+public:
+    cEPGDatabase(cGlobals *Global);
+    ~cEPGDatabase();
+    bool Open(sqlite3 **Db, int Flags=SQLITE_OPEN_READWRITE, int BusyTimeout=EPGDB_BUSYTIMEOUT);
+    sqlite3 *GetReader();
+    void PutReader(sqlite3 *Db);
+    void CloseReaders();
+    bool Unlink();
+    static int Day(time_t Time)
+    {
+        return (int) (Time/EPGDB_DAYSECS);
+    }
+    static bool Days(sqlite3 *Db, std::vector<int> &Days);
+    static bool Partition(sqlite3 *Db, int Day);
+    int DropPartitions(sqlite3 *Db, int Before);
+    int Dropped();
+    static bool CreateView(sqlite3 *Db, int From=0);
+    static bool FullText(sqlite3 *Db, int Day);
+    static bool FullTextAvailable()
+    {
+        return fulltext>EPGDB_FTSNONE;
+    }
+    static bool Upgrade(sqlite3 *Db, int Day);
+    cString Search(const char *Query, const char *ChannelID, time_t From, time_t To, int &ReplyCode);
+};
+
+class cEPGWriter : public cThread
+{
+private:
+    cMutex mutex;
+    cCondVar changed,drained;
+    cGlobals *g;
+    std::deque<std::string> queue;
+    int dropped;
+    bool Write(sqlite3 *Db, std::deque<std::string> &Batch);
+public:
+    cEPGWriter(cGlobals *Global);
+    bool Queue(const char *SQL, int WaitMs=0);
+    void Stop();
+    virtual void Action();
+};
+
+class cEPGBackup : public cThread
+{
+private:
+    cMutex mutex;
+    cCondVar changed;
+    cGlobals *g;
+    bool pending;
+    bool Copy(const char *From, const char *To, bool Throttle);
+    bool Enabled();
+public:
+    cEPGBackup(cGlobals *Global);
+    void Trigger();
+    void Stop();
+    bool Restore();
+    bool Save();
+    virtual void Action();
+};
+
+#endif
@@ -0,0 +1,868 @@
+/*
+ * convert.cpp: a grabber for the xmltv2vdr plugin
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <libxml/xpath.h>
+#include "convert.h"
+#include "xtvb.h"
+
+// same tables as in epgdata2xmltv.xsl (GENREDVB and GENRE)
+static const struct genredvb
+{
+    const char *d25;
+    const char *content;
+} genredvb[]=
+{
+    { "101","G 10" },
+    { "102","G 12" },
+    { "103","G 10" },
+    { "104","G 23" },
+    { "105","G 10" },
+    { "106","G 18" },
+    { "108","G 13" },
+    { "109","G 15" },
+    { "110","G 14" },
+    { "112","G 11" },
+    { "113","G 76" },
+    { "114","G 10" },
+    { "115","G 10,60" },
+    { "116","G 13" },
+    { "117","G 16" },
+    { "119","G 13" },
+    { "121","G 11" },
+    { "122","G 12" },
+    { "123","G 10,55" },
+    { "201","G 15" },
+    { "202","G 15,12" },
+    { "203","G 15" },
+    { "205","G 15" },
+    { "206","G 15,18" },
+    { "207","G 15" },
+    { "208","G 15,13" },
+    { "210","G 15,14" },
+    { "211","G 15" },
+    { "212","G 15,11" },
+    { "214","G 15,50" },
+    { "216","G 15,13" },
+    { "218","G 15,90" },
+    { "219","G 15,13" },
+    { "220","G 15,15" },
+    { "221","G 15,11" },
+    { "222","G 15,12" },
+    { "223","G 15,55" },
+    { "301","G 40" },
+    { "331","G 4B" },
+    { "332","G 45" },
+    { "334","G 43" },
+    { "335","G 41" },
+    { "336","G 40" },
+    { "337","G 46" },
+    { "338","G 45" },
+    { "339","G 47" },
+    { "340","G 40" },
+    { "341","G 44" },
+    { "342","G 48" },
+    { "343","G 49" },
+    { "344","G 45" },
+    { "345","G 46" },
+    { "346","G 45" },
+    { "347","G 40" },
+    { "348","G 40,23" },
+    { "401","G 30" },
+    { "406","G 30" },
+    { "418","G 30" },
+    { "450","G 30" },
+    { "451","G 30" },
+    { "452","G 31" },
+    { "453","G 33" },
+    { "454","G 30" },
+    { "455","G A6" },
+    { "456","G A5" },
+    { "457","G A2" },
+    { "501","G 90" },
+    { "560","G 96" },
+    { "561","G 81" },
+    { "564","G A4" },
+    { "565","G A3" },
+    { "566","G 21" },
+    { "567","G 91" },
+    { "568","G 80" },
+    { "569","G 82" },
+    { "570","G A1" },
+    { "571","G 80" },
+    { "572","G 90" },
+    { "573","G 81" },
+    { "601","G 60" },
+    { "680","G 64" },
+    { "681","G 62" },
+    { "682","G 65" },
+    { "683","G 61" },
+    { "684","G 63" },
+    { "685","G 61" },
+    { "686","G 61" },
+    { "687","G 61" },
+    { "688","G 60,30" },
+    { "689","G 60,83" },
+    { "690","G 60,71" },
+    { "691","G 60,76" },
+    { "692","G 60,70" },
+    { "701","G 50" },
+    { "790","G 50,10" },
+    { "791","G 50,21" },
+    { "792","G 50" },
+    { "793","G 50,30" },
+    { "795","G 55" },
+    { "796","G 55" },
+    { NULL,NULL }
+};
+
+static const struct genre
+{
+    const char *d10;
+    const char *d25;
+    const char *category;
+} genres[]=
+{
+    { "100","101","Spielfilm / Verschiedenes" },
+    { "100","102","Spielfilm / Abenteuer" },
+    { "100","103","Spielfilm / Action" },
+    { "100","104","Spielfilm / Dokumentarfilm" },
+    { "100","105","Spielfilm / Drama" },
+    { "100","106","Spielfilm / Erotik" },
+    { "100","108","Spielfilm / Fantasy" },
+    { "100","109","Spielfilm / Heimat" },
+    { "100","110","Spielfilm / Humor" },
+    { "100","112","Spielfilm / Krimi" },
+    { "100","113","Spielfilm / Kultur" },
+    { "100","114","Spielfilm / Kurzfilm" },
+    { "100","115","Spielfilm / Musik" },
+    { "100","116","Spielfilm / Mystery+Horror" },
+    { "100","117","Spielfilm / Romantik/Liebe" },
+    { "100","119","Spielfilm / Science Fiction" },
+    { "100","121","Spielfilm / Thriller" },
+    { "100","122","Spielfilm / Western" },
+    { "100","123","Spielfilm / Zeichentrick" },
+    { "200","201","Serie / Verschiedenes" },
+    { "200","202","Serie / Abenteuer" },
+    { "200","203","Serie / Action" },
+    { "200","205","Serie / Drama" },
+    { "200","206","Serie / Erotik" },
+    { "200","207","Serie / Familie" },
+    { "200","208","Serie / Fantasy" },
+    { "200","210","Serie / Humor" },
+    { "200","211","Serie / Krankenhaus" },
+    { "200","212","Serie / Krimi" },
+    { "200","214","Serie / Jugend" },
+    { "200","216","Serie / Mystery+Horror" },
+    { "200","218","Serie / Reality" },
+    { "200","219","Serie / Science Fiction" },
+    { "200","220","Serie / Soap" },
+    { "200","221","Serie / Thriller" },
+    { "200","222","Serie / Western" },
+    { "200","223","Serie / Zeichentrick" },
+    { "300","301","Sport / Verschiedenes" },
+    { "300","331","Sport / Boxen" },
+    { "300","332","Sport / Eishockey" },
+    { "300","334","Sport / Fussball" },
+    { "300","335","Sport / Olympia" },
+    { "300","336","Sport / Golf" },
+    { "300","337","Sport / Gymnastik" },
+    { "300","338","Sport / Handball" },
+    { "300","339","Sport / Motorsport" },
+    { "300","340","Sport / Radsport" },
+    { "300","341","Sport / Tennis" },
+    { "300","342","Sport / Wassersport" },
+    { "300","343","Sport / Wintersport" },
+    { "300","344","Sport / US-Sport" },
+    { "300","345","Sport / Leichtathletik" },
+    { "300","346","Sport / Volleyball" },
+    { "300","347","Sport / Extremsport" },
+    { "300","348","Sport / Reportagen" },
+    { "400","401","Show / Verschiedenes" },
+    { "400","406","Show / Erotik" },
+    { "400","418","Show / Reality" },
+    { "400","450","Show / Comedy" },
+    { "400","451","Show / Familien-Show" },
+    { "400","452","Show / Spielshows" },
+    { "400","453","Show / Talkshows" },
+    { "400","454","Show / Gerichtsshow" },
+    { "400","455","Show / Homeshopping" },
+    { "400","456","Show / Kochshow" },
+    { "400","457","Show / Heimwerken" },
+    { "500","501","Information / Verschiedenes" },
+    { "500","560","Information / Geschichte" },
+    { "500","561","Information / Magazin" },
+    { "500","564","Information / Gesundheit" },
+    { "500","565","Information / Motor+Verkehr" },
+    { "500","566","Information / Nachrichten" },
+    { "500","567","Information / Natur" },
+    { "500","568","Information / Politik" },
+    { "500","569","Information / Ratgeber" },
+    { "500","570","Information / Reise" },
+    { "500","571","Information / Wirtschaft" },
+    { "500","572","Information / Wissen" },
+    { "500","573","Information / Dokumentation" },
+    { "600","601","Kultur + Musik / Verschiedenes" },
+    { "600","680","Kultur + Musik / Jazz" },
+    { "600","681","Kultur + Musik / Klassik" },
+    { "600","682","Kultur + Musik / Musical" },
+    { "600","683","Kultur + Musik / Rock" },
+    { "600","684","Kultur + Musik / Volksmusik" },
+    { "600","685","Kultur + Musik / Alternative" },
+    { "600","686","Kultur + Musik / Pop" },
+    { "600","687","Kultur + Musik / Clips" },
+    { "600","688","Kultur + Musik / Show" },
+    { "600","689","Kultur + Musik / Interview" },
+    { "600","690","Kultur + Musik / Theater" },
+    { "600","691","Kultur + Musik / Kino" },
+    { "600","692","Kultur + Musik / Kultur" },
+    { "700","701","Kinder / Verschiedenes" },
+    { "700","790","Kinder / Filme" },
+    { "700","791","Kinder / Nachrichten" },
+    { "700","792","Kinder / Serien" },
+    { "700","793","Kinder / Shows" },
+    { "700","795","Kinder / Zeichentrick" },
+    { "700","796","Kinder / Anime" },
+    { NULL,NULL,NULL }
+};
+
+#define IMGDIR "/var/lib/epgsources/epgdata2xmltv-img/"
+#define IMGPATH "file://" IMGDIR
+
+// d25 -> index into genredvb/genres, built once
+static short dvbindex[1000];
+static short genreindex[1000];
+static bool indexready=false;
+
+static void BuildIndex()
+{
+    if (indexready) return;
+    for (int i=0; i<1000; i++) dvbindex[i]=genreindex[i]=-1;
+    for (int i=0; genredvb[i].d25; i++) dvbindex[atoi(genredvb[i].d25)]=i;
+    for (int i=0; genres[i].d25; i++) genreindex[atoi(genres[i].d25)]=i;
+    indexready=true;
+}
+
+static int Code(const std::string &s)
+{
+    // codes are compared as strings in the stylesheet, so only accept exactly three digits
+    if ((s.size()!=3) || !isdigit(s[0]) || !isdigit(s[1]) || !isdigit(s[2])) return -1;
+    return atoi(s.c_str());
+}
+
+const char *cepgdataconvert::GenreDVB(const std::string &d25)
+{
+    BuildIndex();
+    int code=Code(d25);
+    if ((code==-1) || (dvbindex[code]==-1)) return NULL;
+    return genredvb[dvbindex[code]].content;
+}
+
+const char *cepgdataconvert::Genre(const std::string &d10, const std::string &d25)
+{
+    BuildIndex();
+    int code=Code(d25);
+    if ((code==-1) || (genreindex[code]==-1)) return NULL;
+    if (d10!=genres[genreindex[code]].d10) return NULL;
+    return genres[genreindex[code]].category;
+}
+
+void cepgdataconvert::Collect(xmlNodePtr node)
+{
+    for (xmlNodePtr n=node; n; n=n->next)
+    {
+        if (n->type!=XML_ELEMENT_NODE) continue;
+        if (!xmlStrcmp(n->name,(const xmlChar *) "data"))
+        {
+            // channelnum is passed as a number, so d2 is compared numerically
+            double num=xmlXPathCastStringToNumber((const xmlChar *) Value(n,"d2").c_str());
+            if (!xmlXPathIsNaN(num)) records[num].push_back(n);
+        }
+        if (n->children) Collect(n->children);
+    }
+}
+
+void cepgdataconvert::Group(xmlDocPtr doc)
+{
+    // one pass over the document, keeps document order per channel
+    records.clear();
+    if (doc) Collect(doc->children);
+}
+
+std::string cepgdataconvert::Value(xmlNodePtr data, const char *name)
+{
+    // string value of the first child element with this name
+    for (xmlNodePtr n=data->children; n; n=n->next)
+    {
+        if ((n->type==XML_ELEMENT_NODE) && (!xmlStrcmp(n->name,(const xmlChar *) name)))
+        {
+            xmlChar *content=xmlNodeGetContent(n);
+            if (!content) return "";
+            std::string ret=(const char *) content;
+            xmlFree(content);
+            return ret;
+        }
+    }
+    return "";
+}
+
+std::string cepgdataconvert::Translate(const std::string &s, char from, char to)
+{
+    std::string ret=s;
+    for (size_t i=0; i<ret.size(); i++)
+    {
+        if (ret[i]==from) ret[i]=to;
+    }
+    return ret;
+}
+
+std::string cepgdataconvert::NormalizeSpace(const std::string &s)
+{
+    std::string ret;
+    bool space=false;
+    for (size_t i=0; i<s.size(); i++)
+    {
+        char c=s[i];
+        if ((c==' ') || (c=='\t') || (c=='\n') || (c=='\r'))
+        {
+            space=true;
+            continue;
+        }
+        if (space && !ret.empty()) ret+=' ';
+        space=false;
+        ret+=c;
+    }
+    return ret;
+}
+
+void cepgdataconvert::Escape(FILE *out, const std::string &s, bool attr)
+{
+    // like the libxml2 serializer with utf-8 output
+    for (size_t i=0; i<s.size(); i++)
+    {
+        switch (s[i])
+        {
+        case '&':
+            fputs("&amp;",out);
+            break;
+        case '<':
+            fputs("&lt;",out);
+            break;
+        case '>':
+            fputs("&gt;",out);
+            break;
+        case '\r':
+            fputs("&#13;",out);
+            break;
+        case '"':
+            if (attr)
+            {
+                fputs("&quot;",out);
+            }
+            else
+            {
+                fputc('"',out);
+            }
+            break;
+        case '\n':
+            if (attr)
+            {
+                fputs("&#10;",out);
+            }
+            else
+            {
+                fputc('\n',out);
+            }
+            break;
+        case '\t':
+            if (attr)
+            {
+                fputs("&#9;",out);
+            }
+            else
+            {
+                fputc('\t',out);
+            }
+            break;
+        default:
+            fputc(s[i],out);
+            break;
+        }
+    }
+}
+
+void cepgdataconvert::Element(FILE *out, const char *name, const std::string &value, const char *attrs)
+{
+    fprintf(out,"<%s%s",name,attrs ? attrs : "");
+    if (value.empty())
+    {
+        fputs("/>",out);
+        return;
+    }
+    fputc('>',out);
+    Escape(out,value,false);
+    fprintf(out,"</%s>",name);
+}
+
+void cepgdataconvert::Tokens(std::vector<std::pair<const char *,std::string> > &credits,
+                             std::string list, const char *delimiter, const char *tag)
+{
+    // output-tokens template, consecutive duplicates are skipped
+    std::string last;
+    size_t dlen=strlen(delimiter);
+    for (;;)
+    {
+        std::string newlist=NormalizeSpace(list);
+        if (list.find(delimiter)==std::string::npos) newlist+=delimiter;
+        size_t pos=newlist.find(delimiter);
+        std::string first,remaining;
+        if (pos!=std::string::npos)
+        {
+            first=newlist.substr(0,pos);
+            remaining=newlist.substr(pos+dlen);
+        }
+        if (first!=last) credits.push_back(std::make_pair(tag,first));
+        if (remaining.empty()) break;
+        list=remaining;
+        last=first;
+    }
+}
+
+void cepgdataconvert::Credits(xmlNodePtr data, std::vector<std::pair<const char *,std::string> > &credits)
+{
+    std::string d36=Value(data,"d36"),d37=Value(data,"d37"),d34=Value(data,"d34"),d35=Value(data,"d35");
+    if (!d36.empty()) Tokens(credits,d36,"|","director");
+    if (!d37.empty()) Tokens(credits,d37," - ","actor");
+    if (!d34.empty()) Tokens(credits,d34,"|","presenter");
+    if (!d35.empty()) Tokens(credits,d35," - ","guest");
+}
+
+static bool ParseDate(const std::string &date, struct tm *tm)
+{
+    // YYYY-MM-DDTHH:MM:SS
+    memset(tm,0,sizeof(struct tm));
+    if (date.size()!=19) return false;
+    const char *d=date.c_str();
+    for (int i=0; i<19; i++)
+    {
+        if ((i==4) || (i==7))
+        {
+            if (d[i]!='-') return false;
+        }
+        else if (i==10)
+        {
+            if (d[i]!='T') return false;
+        }
+        else if ((i==13) || (i==16))
+        {
+            if (d[i]!=':') return false;
+        }
+        else if (!isdigit(d[i]))
+        {
+            return false;
+        }
+    }
+    tm->tm_year=atoi(d)-1900;
+    tm->tm_mon=atoi(d+5)-1;
+    tm->tm_mday=atoi(d+8);
+    tm->tm_hour=atoi(d+11);
+    tm->tm_min=atoi(d+14);
+    tm->tm_sec=atoi(d+17);
+    if ((tm->tm_mon<0) || (tm->tm_mon>11) || (tm->tm_mday<1)) return false;
+    static const int mdays[]={31,28,31,30,31,30,31,31,30,31,30,31};
+    int year=tm->tm_year+1900;
+    bool leap=((year%4==0) && (year%100!=0)) || (year%400==0);
+    if (tm->tm_mday>mdays[tm->tm_mon]+((leap && (tm->tm_mon==1)) ? 1 : 0)) return false;
+    if ((tm->tm_hour>23) || (tm->tm_min>59) || (tm->tm_sec>59)) return false;
+    return true;
+}
+
+static time_t LastSunday(int Year, int Month, int Hour)
+{
+    // last sunday of the month (which has 31 days), at Hour
+    struct tm tm;
+    memset(&tm,0,sizeof(tm));
+    tm.tm_year=Year;
+    tm.tm_mon=Month;
+    tm.tm_mday=31;
+    time_t t=timegm(&tm);
+    struct tm res;
+    gmtime_r(&t,&res);
+    return t-(res.tm_wday*86400)+Hour*3600;
+}
+
+std::string cepgdataconvert::Date2UTC(const std::string &date)
+{
+    // date2UTC template: central european time -> UTC, without zone suffix
+    struct tm tm;
+    if (!ParseDate(date,&tm)) return "";
+    time_t t=timegm(&tm);
+    time_t dststart=LastSunday(tm.tm_year,2,2);
+    time_t dstend=LastSunday(tm.tm_year,9,3);
+    if ((t>=dststart) && (t<=dstend))
+    {
+        t-=7200;
+    }
+    else
+    {
+        t-=3600;
+    }
+    struct tm utc;
+    gmtime_r(&t,&utc);
+    char buf[32];
+    strftime(buf,sizeof(buf),"%Y%m%d%H%M%S",&utc);
+    return buf;
+}
+
+void cepgdataconvert::Programme(FILE *out, xmlNodePtr data, const char *channelid)
+{
+    std::string d4=Value(data,"d4");
+    std::string d5=Value(data,"d5");
+    std::string d8=Value(data,"d8");
+
+    std::string d4date,d4time,d5date,d5time;
+    size_t sp=d4.find(' ');
+    if (sp!=std::string::npos)
+    {
+        d4date=d4.substr(0,sp);
+        d4time=d4.substr(sp+1);
+    }
+    sp=d5.find(' ');
+    if (sp!=std::string::npos)
+    {
+        d5date=d5.substr(0,sp);
+        d5time=d5.substr(sp+1);
+    }
+
+    std::string start=Date2UTC(d4date+"T"+d4time)+" +0000";
+    std::string stop=Date2UTC(d5date+"T"+d5time)+" +0000";
+    std::string vps;
+    if (!d8.empty())
+    {
+        vps=Date2UTC(d4date+"T"+d8+":00");
+        if (!vps.empty()) vps+=" +0000";
+    }
+
+    fputs("<programme start=\"",out);
+    Escape(out,start,true);
+    fputs("\" stop=\"",out);
+    Escape(out,stop,true);
+    fputc('"',out);
+    if (!vps.empty())
+    {
+        fputs(" vps-start=\"",out);
+        Escape(out,vps,true);
+        fputc('"',out);
+    }
+    fputs(" channel=\"",out);
+    Escape(out,channelid,true);
+    fputs("\">\n",out);
+
+    std::string eventid=Value(data,"d0");
+    if (!eventid.empty()) fprintf(out,"<!-- pid = %s -->\n",eventid.c_str());
+
+    Element(out,"title",Value(data,"d19")," lang=\"de\"");
+    fputc('\n',out);
+    std::string subtitle=Value(data,"d20");
+    if (!subtitle.empty())
+    {
+        Element(out,"sub-title",subtitle," lang=\"de\"");
+        fputc('\n',out);
+    }
+    std::string themen=Translate(Value(data,"d24"),'|','\n');
+    if (!themen.empty())
+    {
+        Element(out,"desc",themen," lang=\"de\"");
+        fputc('\n',out);
+    }
+    std::string inhalt=Translate(Value(data,"d22"),'|','\n');
+    if (!inhalt.empty())
+    {
+        Element(out,"desc",inhalt," lang=\"de\"");
+        fputc('\n',out);
+    }
+
+    std::vector<std::pair<const char *,std::string> > credits;
+    Credits(data,credits);
+    if (!credits.empty())
+    {
+        fputs("<credits>\n",out);
+        for (size_t i=0; i<credits.size(); i++)
+        {
+            fprintf(out,"<%s>",credits[i].first);
+            Escape(out,credits[i].second,false);
+            fprintf(out,"</%s>\n",credits[i].first);
+        }
+        fputs("</credits>\n",out);
+    }
+
+    std::string year=Value(data,"d33");
+    if (!year.empty())
+    {
+        Element(out,"date",year);
+        fputc('\n',out);
+    }
+    std::string d25=Value(data,"d25");
+    const char *content=GenreDVB(d25);
+    if (content) fprintf(out,"<!-- content = %s -->\n",content);
+    const char *genre=Genre(Value(data,"d10"),d25);
+    if (genre)
+    {
+        Element(out,"category",genre," lang=\"de\"");
+        fputc('\n',out);
+    }
+
+    const char *pics[]={"d38","d39","d40"};
+    for (int i=0; i<3; i++)
+    {
+        std::string pic=Value(data,pics[i]);
+        if (pic.empty()) continue;
+        fputs("<icon src=\"",out);
+        Escape(out,IMGPATH+pic,true);
+        fputs("\"/>\n",out);
+    }
+
+    std::string country=Translate(Value(data,"d32"),'|','/');
+    if (!country.empty())
+    {
+        Element(out,"country",country);
+        fputc('\n',out);
+    }
+
+    double episode=xmlXPathCastStringToNumber((const xmlChar *) Value(data,"d26").c_str());
+    if (episode>0)
+    {
+        xmlChar *num=xmlXPathCastNumberToString(episode-1);
+        if (num)
+        {
+            fprintf(out,"<episode-num system=\"xmltv_ns\">.%s.</episode-num>\n",(const char *) num);
+            xmlFree(num);
+        }
+    }
+
+    bool aspect=(Value(data,"d29")=="1");
+    bool bw=(Value(data,"d11")=="1");
+    if (aspect || bw)
+    {
+        fputs("<video>\n",out);
+        if (aspect) fputs("<aspect>16:9</aspect>\n",out);
+        if (bw) fputs("<colour>no</colour>\n",out);
+        fputs("</video>\n",out);
+    }
+
+    const char *audio=NULL;
+    if (Value(data,"d28")=="1")
+    {
+        audio="dolby digital";
+    }
+    else if (Value(data,"d27")=="1")
+    {
+        audio="stereo";
+    }
+    if (audio) fprintf(out,"<audio>\n<stereo>%s</stereo>\n</audio>\n",audio);
+
+    std::string d30=Value(data,"d30");
+    if (xmlXPathCastStringToNumber((const xmlChar *) d30.c_str())>0)
+    {
+        fputs("<star-rating><value>",out);
+        Escape(out,d30+"/5",false);
+        fputs("</value></star-rating>\n",out);
+    }
+    double tipp=xmlXPathCastStringToNumber((const xmlChar *) Value(data,"d18").c_str());
+    if (tipp==1) fputs("<star-rating system=\"TagesTipp\"><value>1/1</value></star-rating>\n",out);
+    if (tipp==2) fputs("<star-rating system=\"TopTipp\"><value>1/1</value></star-rating>\n",out);
+
+    fputs("</programme>\n",out);
+}
+
+int cepgdataconvert::Convert(FILE *out, const char *channelid, const char *channelnum)
+{
+    std::map<double,std::vector<xmlNodePtr> >::iterator it=records.find(xmlXPathCastStringToNumber((const xmlChar *) channelnum));
+    if (it==records.end()) return 0;
+    for (size_t i=0; i<it->second.size(); i++)
+    {
+        Programme(out,it->second[i],channelid);
+    }
+    if (!it->second.empty()) fputc('\n',out); // like xsltSaveResultToFile
+    return (int) it->second.size();
+}
+
+// ----- binary output (see xtvb.h)
+
+void cepgdataconvert::Put32(std::string &buf, uint32_t value)
+{
+    for (int i=0; i<4; i++) buf+=(char) ((value>>(i*8)) & 0xFF);
+}
+
+void cepgdataconvert::Put64(std::string &buf, int64_t value)
+{
+    Put32(buf,(uint32_t) (((uint64_t) value) & 0xFFFFFFFF));
+    Put32(buf,(uint32_t) (((uint64_t) value)>>32));
+}
+
+void cepgdataconvert::Record(FILE *out, int type, const std::string &payload)
+{
+    std::string head;
+    head+=(char) type;
+    Put32(head,payload.size());
+    fwrite(head.data(),1,head.size(),out);
+    if (!payload.empty()) fwrite(payload.data(),1,payload.size(),out);
+}
+
+uint32_t cepgdataconvert::String(FILE *out, const std::string &s)
+{
+    std::map<std::string,uint32_t>::iterator it=strings.find(s);
+    if (it!=strings.end()) return it->second;
+    uint32_t num=strings.size();
+    strings[s]=num;
+    Record(out,XTVB_STRING,s);
+    return num;
+}
+
+void cepgdataconvert::Field(FILE *out, std::string &buf, int tag, const std::string &a, const std::string &b)
+{
+    buf+=(char) tag;
+    Put32(buf,String(out,a));
+    Put32(buf,b.empty() ? XTVB_NONE : String(out,b));
+}
+
+static time_t UTC2Time(const std::string &utc)
+{
+    // YYYYMMDDHHMMSS from Date2UTC
+    if (utc.size()!=14) return 0;
+    struct tm tm;
+    memset(&tm,0,sizeof(tm));
+    if (sscanf(utc.c_str(),"%4d%2d%2d%2d%2d%2d",&tm.tm_year,&tm.tm_mon,&tm.tm_mday,
+               &tm.tm_hour,&tm.tm_min,&tm.tm_sec)!=6) return 0;
+    tm.tm_year-=1900;
+    tm.tm_mon--;
+    return timegm(&tm);
+}
+
+void cepgdataconvert::ProgrammeBinary(FILE *out, xmlNodePtr data, const char *channelid)
+{
+    // same content as Programme(), as the plugin would read it from xmltv
+    std::string d4=Value(data,"d4");
+    std::string d5=Value(data,"d5");
+    std::string start,stop;
+    size_t sp=d4.find(' ');
+    if (sp!=std::string::npos) start=Date2UTC(d4.substr(0,sp)+"T"+d4.substr(sp+1));
+    sp=d5.find(' ');
+    if (sp!=std::string::npos) stop=Date2UTC(d5.substr(0,sp)+"T"+d5.substr(sp+1));
+
+    std::string fields;
+    std::string title=Value(data,"d19");
+    if (!title.empty()) Field(out,fields,XTVB_F_TITLE,title);
+    std::string subtitle=Value(data,"d20");
+    if (!subtitle.empty()) Field(out,fields,XTVB_F_SHORTTEXT,subtitle);
+    std::string themen=Translate(Value(data,"d24"),'|','\n');
+    if (!themen.empty()) Field(out,fields,XTVB_F_DESCRIPTION,themen);
+    std::string inhalt=Translate(Value(data,"d22"),'|','\n');
+    if (!inhalt.empty()) Field(out,fields,XTVB_F_DESCRIPTION,inhalt);
+
+    std::vector<std::pair<const char *,std::string> > credits;
+    Credits(data,credits);
+    for (size_t i=0; i<credits.size(); i++)
+    {
+        if (!credits[i].second.empty()) Field(out,fields,XTVB_F_CREDIT,credits[i].first,credits[i].second);
+    }
+
+    std::string year=Value(data,"d33");
+    if (!year.empty())
+    {
+        fields+=(char) XTVB_F_YEAR;
+        Put32(fields,(uint32_t) atoi(year.c_str()));
+        Put32(fields,XTVB_NONE);
+    }
+    std::string d25=Value(data,"d25");
+    const char *content=GenreDVB(d25);
+    if (content) Field(out,fields,XTVB_F_CATEGORY,content);
+    const char *genre=Genre(Value(data,"d10"),d25);
+    if (genre) Field(out,fields,XTVB_F_CATEGORY,genre);
+
+    const char *pics[]={"d38","d39","d40"};
+    for (int i=0; i<3; i++)
+    {
+        std::string pic=Value(data,pics[i]);
+        if (!pic.empty()) Field(out,fields,XTVB_F_PIC,IMGDIR+pic);
+    }
+
+    std::string country=Translate(Value(data,"d32"),'|','/');
+    if (!country.empty()) Field(out,fields,XTVB_F_COUNTRY,country);
+
+    double episode=xmlXPathCastStringToNumber((const xmlChar *) Value(data,"d26").c_str());
+    if (episode>0)
+    {
+        // the xmltv path writes episode-1 and the plugin adds 1 again
+        xmlChar *num=xmlXPathCastNumberToString(episode-1);
+        if (num)
+        {
+            fields+=(char) XTVB_F_EPISODE;
+            Put32(fields,(uint32_t) (atoi((const char *) num)+1));
+            Put32(fields,XTVB_NONE);
+            xmlFree(num);
+        }
+    }
+
+    if (Value(data,"d29")=="1") Field(out,fields,XTVB_F_VIDEO,"aspect","16:9");
+    if (Value(data,"d11")=="1") Field(out,fields,XTVB_F_VIDEO,"colour","no");
+
+    if (Value(data,"d28")=="1")
+    {
+        Field(out,fields,XTVB_F_AUDIO,"dolby digital");
+    }
+    else if (Value(data,"d27")=="1")
+    {
+        Field(out,fields,XTVB_F_AUDIO,"stereo");
+    }
+
+    std::string d30=Value(data,"d30");
+    if (xmlXPathCastStringToNumber((const xmlChar *) d30.c_str())>0)
+    {
+        fields+=(char) XTVB_F_STARRATING;
+        Put32(fields,XTVB_NONE);
+        Put32(fields,String(out,d30+"/5"));
+    }
+    double tipp=xmlXPathCastStringToNumber((const xmlChar *) Value(data,"d18").c_str());
+    if (tipp==1) Field(out,fields,XTVB_F_STARRATING,"TagesTipp","1/1");
+    if (tipp==2) Field(out,fields,XTVB_F_STARRATING,"TopTipp","1/1");
+
+    std::string payload;
+    Put64(payload,(int64_t) UTC2Time(start));
+    Put64(payload,(int64_t) UTC2Time(stop));
+    Put32(payload,(uint32_t) strtoul(Value(data,"d0").c_str(),NULL,10));
+    Put32(payload,String(out,channelid));
+    payload+=fields;
+    Record(out,XTVB_PROGRAMME,payload);
+}
+
+void cepgdataconvert::BinaryHeader(FILE *out)
+{
+    std::string head=XTVB_MAGIC;
+    head+=(char) (XTVB_VERSION & 0xFF);
+    head+=(char) (XTVB_VERSION>>8);
+    head+=(char) 0;
+    head+=(char) 0;
+    fwrite(head.data(),1,head.size(),out);
+    strings.clear();
+}
+
+int cepgdataconvert::ConvertBinary(FILE *out, const char *channelid, const char *channelnum)
+{
+    std::map<double,std::vector<xmlNodePtr> >::iterator it=records.find(xmlXPathCastStringToNumber((const xmlChar *) channelnum));
+    if (it==records.end()) return 0;
+    for (size_t i=0; i<it->second.size(); i++)
+    {
+        ProgrammeBinary(out,it->second[i],channelid);
+    }
+    return (int) it->second.size();
+}
+
+void cepgdataconvert::BinaryEnd(FILE *out)
+{
+    Record(out,XTVB_END,"");
+}
@@ -0,0 +1,50 @@
+/*
+ * convert.h: a grabber for the xmltv2vdr plugin
+ *
+ */
+
+#ifndef __CONVERT_H
+#define __CONVERT_H
+
+#include <libxml/tree.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+#include <map>
+#include <string>
+#include <vector>
+
+// native replacement of epgdata2xmltv.xsl, output is identical
+class cepgdataconvert
+{
+private:
+    std::map<double,std::vector<xmlNodePtr> > records; // number(d2) -> data elements
+    void Collect(xmlNodePtr node);
+    static std::string Value(xmlNodePtr data, const char *name);
+    static std::string Translate(const std::string &s, char from, char to);
+    static std::string NormalizeSpace(const std::string &s);
+    static void Escape(FILE *out, const std::string &s, bool attr);
+    static void Element(FILE *out, const char *name, const std::string &value, const char *attrs=NULL);
+    static void Tokens(std::vector<std::pair<const char *,std::string> > &credits,
+                       std::string list, const char *delimiter, const char *tag);
+    static void Credits(xmlNodePtr data, std::vector<std::pair<const char *,std::string> > &credits);
+    static std::string Date2UTC(const std::string &date);
+    static const char *GenreDVB(const std::string &d25);
+    static const char *Genre(const std::string &d10, const std::string &d25);
+    void Programme(FILE *out, xmlNodePtr data, const char *channelid);
+    std::map<std::string,uint32_t> strings; // string table of the binary stream
+    static void Put32(std::string &buf, uint32_t value);
+    static void Put64(std::string &buf, int64_t value);
+    static void Record(FILE *out, int type, const std::string &payload);
+    uint32_t String(FILE *out, const std::string &s);
+    void Field(FILE *out, std::string &buf, int tag, const std::string &a, const std::string &b="");
+    void ProgrammeBinary(FILE *out, xmlNodePtr data, const char *channelid);
+public:
+    void Group(xmlDocPtr doc);
+    int Convert(FILE *out, const char *channelid, const char *channelnum);
+    void BinaryHeader(FILE *out);
+    int ConvertBinary(FILE *out, const char *channelid, const char *channelnum);
+    void BinaryEnd(FILE *out);
+};
+
+#endif //__CONVERT_H
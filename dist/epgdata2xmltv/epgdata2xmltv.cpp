@@ -12,6 +12,8 @@
 #include <enca.h>
 #include <libxml/parserInternals.h>
 #include "epgdata2xmltv.h"
+#include "images.h"
+#include "xtvb.h"
 #include "epgdata2xmltv_xsl.h"
 
 #include <fcntl.h>
@@ -37,26 +39,46 @@ void tvmGenericErrorFunc(void *UNUSED(ctx), const char *UNUSED(msg), ...)
 
 cepgdata2xmltv::cepgdata2xmltv ()
 {
-    data.size = 0;
-    data.fd=-1;
+    curl_global_init(CURL_GLOBAL_NOTHING);
+    const char *conn=getenv("EPGDATA2XMLTV_CONNECTIONS");
+    fetch=new cepgdatafetch(conn ? atoi(conn) : EPGDATA2XMLTV_CONNECTIONS);
     pxsltStylesheet = NULL;
     sxmlDoc=NULL;
+    // native converter is the default, EPGDATA2XMLTV_XSLT=1 selects the stylesheet,
+    // EPGDATA2XMLTV_BENCH=1 runs both and compares the output
+    usexslt=(getenv("EPGDATA2XMLTV_XSLT")!=NULL);
+    bench=(getenv("EPGDATA2XMLTV_BENCH")!=NULL);
+    // the plugin asks for the binary format (see xtvb.h), only with the native converter
+    const char *format=getenv(XTVB_ENV);
+    usebinary=(format && !strcmp(format,XTVB_FORMAT) && !usexslt && !bench);
+    benchgroup=benchnative=benchxslt=0;
+    benchchannels=benchdiffs=0;
+    SetupLibXML();
 }
 
 cepgdata2xmltv::~cepgdata2xmltv ()
 {
+    delete fetch;
+    curl_global_cleanup();
     if (pxsltStylesheet)
     {
         xsltFreeStylesheet(pxsltStylesheet);
         xsltCleanupGlobals();
-        xmlCleanupParser();
     }
+    xmlCleanupParser();
     if (dtdmem) {
         free(dtdmem);
         dtdmem=NULL;
     }
 }
 
+static double BenchNow()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return ts.tv_sec+(ts.tv_nsec/1000000000.0);
+}
+
 xmlParserInputPtr xmlMyExternalEntityLoader(const char *URL,
         const char *UNUSED(ID), xmlParserCtxtPtr ctxt)
 {
@@ -66,13 +88,18 @@ xmlParserInputPtr xmlMyExternalEntityLoader(const char *URL,
     return NULL;
 }
 
-void cepgdata2xmltv::LoadXSLT()
+void cepgdata2xmltv::SetupLibXML()
 {
-    if (pxsltStylesheet) return;
+    // the entity loader resolves qy.dtd, the native converter needs it too
     xmlSetGenericErrorFunc(NULL,tvmGenericErrorFunc);
     xmlSubstituteEntitiesDefault (1);
     xmlLoadExtDtdDefaultValue = 1;
     xmlSetExternalEntityLoader(xmlMyExternalEntityLoader);
+}
+
+void cepgdata2xmltv::LoadXSLT()
+{
+    if (pxsltStylesheet) return;
     exsltRegisterAll();
 
     if ((sxmlDoc = xmlReadMemory (xsl, sizeof(xsl), NULL,NULL,XML_PARSE_HUGE)) != NULL)
@@ -87,93 +114,37 @@ void cepgdata2xmltv::LoadXSLT()
     }
 }
 
-static size_t WriteMemoryCallback(void *ptr, size_t size, size_t nmemb, void *dataptr)
-{
-    struct data *data = (struct data *) dataptr;
-    size_t realsize = size * nmemb;
-    if (data->fd!=-1)
-    {
-        if (write(data->fd,ptr,realsize)==-1) return -1;
-        data->size+=realsize;
-    }
-    return realsize;
-}
-
-
-int cepgdata2xmltv::DownloadData(const char *url)
-{
-    CURL *curl_handle;
-    data.size=0;
-
-    int ret;
-    ret=curl_global_init(CURL_GLOBAL_NOTHING);
-    if (ret) return ret;
-
-    curl_handle = curl_easy_init();
-    if (!curl_handle) return -40; // unused curl error
-    curl_easy_setopt(curl_handle, CURLOPT_URL, url);  // Specify URL to get
-    curl_easy_setopt(curl_handle, CURLOPT_FOLLOWLOCATION, 0);  // don't follow redirects
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);  // Send all data to this function
-    curl_easy_setopt(curl_handle, CURLOPT_WRITEDATA, (void *) &data);  // Pass our 'data' struct to the callback function
-    curl_easy_setopt(curl_handle, CURLOPT_MAXFILESIZE, 85971520);  // Set maximum file size to get (bytes)
-    curl_easy_setopt(curl_handle, CURLOPT_NOPROGRESS, 1);  // No progress meter
-    curl_easy_setopt(curl_handle, CURLOPT_NOSIGNAL, 1);  // No signaling
-    curl_easy_setopt(curl_handle, CURLOPT_TIMEOUT, 300);  // Set timeout to 300 seconds
-    curl_easy_setopt(curl_handle, CURLOPT_USERAGENT, EPGDATA2XMLTV_USERAGENT);  // Some servers don't like requests that are made without a user-agent field
-
-    ret=curl_easy_perform(curl_handle);
-    if (!ret)
-    {
-        long code;
-        curl_easy_getinfo(curl_handle, CURLINFO_RESPONSE_CODE, &code);
-        if (code==407)
-        {
-            ret=10;
-        }
-        else
-        {
-            if (code!=200) ret=22;
-        }
-    }
-
-    if ((data.size<120) && (!ret)) ret=22;
-
-    curl_easy_cleanup(curl_handle);  // Cleanup curl stuff
-    curl_global_cleanup();
-    return -ret;
-}
-
-int cepgdata2xmltv::Fetch(const char *dest, const char *pin, int day)
+bool cepgdata2xmltv::Queue(const char *dest, const char *pin, int day)
 {
     char *url = NULL;
     char *filename = NULL;
 
+    // EPGDATA2XMLTV_URL may point to a local server for testing
+    const char *fmt=getenv("EPGDATA2XMLTV_URL");
+    if (!fmt || !strstr(fmt,"%s") || (strchr(fmt,'%')!=strrchr(fmt,'%'))) fmt=EPGDATA2XMLTV_URL;
+
     if (asprintf (&filename, "%i&pin=%s",day,pin)==-1)
     {
         esyslog("failed to allocate string (%i)",day);
-        return 1;
+        return false;
     }
-    if (asprintf (&url, EPGDATA2XMLTV_URL, filename) == -1)
+    if (asprintf (&url, fmt, filename) == -1)
     {
         esyslog("failed to allocate string (%i)",day);
         free(filename);
-        return 1;
+        return false;
     }
     if (filename) free(filename);
 
-    data.fd=open(dest,O_CREAT|O_TRUNC|O_WRONLY,0664);
-    if (data.fd==-1)
-    {
-        esyslog("failed to open %s (%i)",dest,day);
-        return 1;
-    }
-
-    int ret=DownloadData(url);
-    close(data.fd);
-    if (ret) unlink(dest);
-    data.fd=-1;
-
+    bool ret=fetch->Add(day,url,dest);
+    if (!ret) esyslog("failed to queue download (%i)",day);
     free (url);
+    return ret;
+}
+
+int cepgdata2xmltv::Fetch(const char *dest, int day)
+{
+    int ret=fetch->Wait(day);
     // -40 fatal curl error
     // -10 wrong proxy auth
     // -7 couldn't connect
@@ -181,7 +152,7 @@ int cepgdata2xmltv::Fetch(const char *dest, const char *pin, int day)
     // -22 not found
     if (ret==-40)
     {
-        esyslog("fatal curl error (%i)",day);
+        esyslog("fatal curl error %s (%i)",dest,day);
         return 1;
     }
     if (ret==-28)
@@ -237,6 +208,14 @@ char *cepgdata2xmltv::strreplace(char *s, const char *s1, const char *s2)
     return s;
 }
 
+static void DayString(time_t t, int day, char *vgl)
+{
+    time_t td=t+(day*86400);
+    struct tm *tm;
+    tm=localtime(&td);
+    sprintf(vgl,"%04i%02i%02i",tm->tm_year+1900,tm->tm_mon+1,tm->tm_mday);
+}
+
 int cepgdata2xmltv::Process(int argc, char *argv[])
 {
     FILE *f=fopen("/var/lib/epgsources/epgdata2xmltv","r");
@@ -284,13 +263,27 @@ int cepgdata2xmltv::Process(int argc, char *argv[])
     int carg=3;
     if (!strcmp(argv[3],"1") || !strcmp(argv[3],"0"))  carg++;
 
+    cepgdataimages *images=NULL;
+    if (!strcmp(argv[3],"1")) images=new cepgdataimages;
+    std::vector<bool> extracted(daysinadvance+1,false);
+
+    // start all missing downloads, they run while the days are converted
+    std::vector<bool> queued(daysinadvance+1,false);
     for (int day=0; day<=daysinadvance; day++)
     {
-        time_t td=t+(day*86400);
-        struct tm *tm;
-        tm=localtime(&td);
         char vgl[10];
-        sprintf(vgl,"%04i%02i%02i",tm->tm_year+1900,tm->tm_mon+1,tm->tm_mday);
+        DayString(t,day,vgl);
+        char *dest=NULL;
+        if (asprintf(&dest,"/tmp/%s_epgdata.zip",vgl)==-1) continue;
+        struct stat statbuf;
+        if (stat(dest,&statbuf)==-1) queued[day]=Queue(dest,argv[2],day);
+        free(dest);
+    }
+
+    for (int day=0; day<=daysinadvance; day++)
+    {
+        char vgl[10];
+        DayString(t,day,vgl);
 
         char *dest=NULL;
         if (asprintf(&dest,"/tmp/%s_epgdata.zip",vgl)==-1)
@@ -304,9 +297,15 @@ int cepgdata2xmltv::Process(int argc, char *argv[])
         {
             bool offline=true;
             struct stat statbuf;
-            if (stat(dest,&statbuf)==-1)
+            if (queued[day] || (stat(dest,&statbuf)==-1))
             {
-                if (Fetch(dest,argv[2],day))
+                if (!queued[day] && !Queue(dest,argv[2],day))
+                {
+                    ok=true;
+                    break;
+                }
+                queued[day]=false;
+                if (Fetch(dest,day))
                 {
                     ok=true;
                     break;
@@ -470,43 +469,10 @@ int cepgdata2xmltv::Process(int argc, char *argv[])
                 }
             }
 
-            if (!strcmp(argv[3],"1")) {
-                int entries=zip_get_num_files(zip);
-                for (int i=0; i<entries; i++)
-                {
-                    const char *name=zip_get_name(zip,i,0);
-                    if (strstr(name,"jpg")) {
-
-                        char *destjpg;
-                        if (asprintf(&destjpg,"/var/lib/epgsources/epgdata2xmltv-img/%s",name)!=-1) {
-                            struct stat statbuf;
-                            if (stat(destjpg,&statbuf)==-1) {
-                                struct zip_file *zfile=zip_fopen_index(zip,i,0);
-                                if (zfile)
-                                {
-                                    struct zip_stat sb;
-                                    memset(&sb,0,sizeof(sb));
-                                    if (zip_stat_index(zip,i,ZIP_FL_UNCHANGED,&sb)!=-1) {
-                                        if (sizeof(sb.size>4)) sb.size &= 0x00FFFFFF; // just to be sure
-                                        char *jpg=(char *) malloc(sb.size+1);
-                                        if (jpg) {
-                                            int size=zip_fread(zfile,jpg,sb.size);
-                                            if (size==sb.size) {
-                                                FILE *j=fopen(destjpg,"w+");
-                                                if (j) {
-                                                    fwrite(jpg,size,1,j);
-                                                    fclose(j);
-                                                }
-                                            }
-                                        }
-                                    }
-                                    zip_fclose(zfile);
-                                }
-                            }
-                            free(destjpg);
-                        }
-                    }
-                }
+            if (images)
+            {
+                images->Extract(zip);
+                extracted[day]=true;
             }
 
             zip_close(zip);
@@ -543,7 +509,7 @@ int cepgdata2xmltv::Process(int argc, char *argv[])
         long offset=ftell(f);
 
         xmlDocPtr pxmlDoc;
-        if (!pxsltStylesheet) LoadXSLT();
+        if ((usexslt || bench) && !pxsltStylesheet) LoadXSLT();
         int xmlsize=strlen(xmlmem);
         if ((pxmlDoc=xmlParseMemory(xmlmem,xmlsize))==NULL)
         {
@@ -578,6 +544,13 @@ int cepgdata2xmltv::Process(int argc, char *argv[])
             }
         }
 
+        if (!usexslt || bench)
+        {
+            double start=BenchNow();
+            converter.Group(pxmlDoc);
+            benchgroup+=BenchNow()-start;
+        }
+
         for (;;)
         {
             lptr=line+1;
@@ -599,6 +572,11 @@ int cepgdata2xmltv::Process(int argc, char *argv[])
 
             if (use)
             {
+                if (!head && usebinary)
+                {
+                    converter.BinaryHeader(stdout);
+                    head=true;
+                }
                 if (!head)
                 {
                     printf("<?xml version=\"1.0\" encoding=\"utf-8\"?>\n");
@@ -619,6 +597,19 @@ int cepgdata2xmltv::Process(int argc, char *argv[])
                     char *channelnum=strdup(sc+1);
                     char *lf=strchr(channelnum,10);
                     if (lf) *lf=0;
+                    if (usebinary)
+                    {
+                        converter.ConvertBinary(stdout,lptr,channelnum);
+                        free(channelnum);
+                        continue;
+                    }
+                    if (!usexslt && !bench)
+                    {
+                        converter.Convert(stdout,lptr,channelnum);
+                        free(channelnum);
+                        continue;
+                    }
+                    char *channelid=strdup(lptr);
                     channel[0]='"';
                     *sc++='"';
                     *sc=0;
@@ -626,7 +617,15 @@ int cepgdata2xmltv::Process(int argc, char *argv[])
                     {
                         "channelid", channel, "channelnum",channelnum,NULL
                     };
-                    Translate(pxmlDoc,params);
+                    if (bench)
+                    {
+                        Bench(pxmlDoc,params,channelid,channelnum);
+                    }
+                    else
+                    {
+                        Translate(stdout,pxmlDoc,params);
+                    }
+                    if (channelid) free(channelid);
                     if (channelnum) free(channelnum);
                 }
             }
@@ -645,11 +644,40 @@ int cepgdata2xmltv::Process(int argc, char *argv[])
     if (line) free(line);
     fclose(f);
 
-    if (head) printf("</tv>\n");
+    if (images)
+    {
+        // only with all days read, otherwise we would remove needed images
+        bool all=true;
+        for (int day=0; day<=daysinadvance; day++)
+        {
+            if (!extracted[day]) all=false;
+        }
+        if (all) images->Cleanup();
+        images->Report();
+        delete images;
+    }
+
+    if (head)
+    {
+        if (usebinary)
+        {
+            converter.BinaryEnd(stdout);
+        }
+        else
+        {
+            printf("</tv>\n");
+        }
+    }
+    if (bench)
+    {
+        fprintf(stderr,"bench: channels=%i xslt=%.3fs native=%.3fs (group=%.3fs) %s\n",
+                benchchannels,benchxslt,benchgroup+benchnative,benchgroup,
+                benchdiffs ? "output differs" : "output identical");
+    }
     return head ? 0 : 1;
 }
 
-bool cepgdata2xmltv::Translate(xmlDocPtr pxmlDoc, const char **params)
+bool cepgdata2xmltv::Translate(FILE *out, xmlDocPtr pxmlDoc, const char **params)
 {
     xmlDocPtr res=NULL;
     if ((res = xsltApplyStylesheet (pxsltStylesheet, pxmlDoc, (const char **)params)) == NULL)
@@ -659,12 +687,45 @@ bool cepgdata2xmltv::Translate(xmlDocPtr pxmlDoc, const char **params)
     }
     else
     {
-        xsltSaveResultToFile(stdout,res,pxsltStylesheet);
+        xsltSaveResultToFile(out,res,pxsltStylesheet);
         xmlFreeDoc (res);
     }
     return true;
 }
 
+void cepgdata2xmltv::Bench(xmlDocPtr pxmlDoc, const char **params, const char *channelid, const char *channelnum)
+{
+    char *xsltbuf=NULL,*nativebuf=NULL;
+    size_t xsltlen=0,nativelen=0;
+
+    FILE *out=open_memstream(&xsltbuf,&xsltlen);
+    if (!out) return;
+    double start=BenchNow();
+    Translate(out,pxmlDoc,params);
+    fclose(out);
+    benchxslt+=BenchNow()-start;
+
+    out=open_memstream(&nativebuf,&nativelen);
+    if (out)
+    {
+        start=BenchNow();
+        converter.Convert(out,channelid,channelnum);
+        fclose(out);
+        benchnative+=BenchNow()-start;
+    }
+
+    benchchannels++;
+    if ((xsltlen!=nativelen) || (memcmp(xsltbuf,nativebuf,xsltlen)))
+    {
+        esyslog("output differs for %s (%s)",channelid,channelnum);
+        benchdiffs++;
+    }
+    // the stylesheet output is the reference
+    fwrite(xsltbuf,1,xsltlen,stdout);
+    free(xsltbuf);
+    if (nativebuf) free(nativebuf);
+}
+
 int main(int argc, char *argv[])
 {
     if (argc<4) return 132;
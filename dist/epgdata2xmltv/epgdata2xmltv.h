@@ -17,6 +17,9 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include "convert.h"
+#include "fetch.h"
+
 #if __GNUC__ > 3
 #define UNUSED(v) UNUSED_ ## v __attribute__((unused))
 #else
@@ -28,25 +31,26 @@
 #define dsyslog(a...) void( (SysLogLevel > 2) ? syslog_redir(a) : void() )
 #define tsyslog(a...) void( (SysLogLevel > 3) ? syslog_redir(a) : void() )
 
-#define EPGDATA2XMLTV_USERAGENT "libcurl-agent/1.0"
 #define EPGDATA2XMLTV_URL "http://www.epgdata.com/index.php?action=sendPackage&iOEM=VDR&dataType=xml&dayOffset=%s"
 
-struct data
-{
-    size_t size;
-    int fd;
-};
-
 class cepgdata2xmltv
 {
 private:
-    struct data data;
+    cepgdatafetch *fetch;
     xsltStylesheetPtr pxsltStylesheet;
     xmlDocPtr sxmlDoc;
+    cepgdataconvert converter;
+    bool usexslt;
+    bool usebinary;
+    bool bench;
+    double benchgroup,benchnative,benchxslt;
+    int benchchannels,benchdiffs;
     char *strreplace(char *s, const char *s1, const char *s2);
-    int  Fetch(const char *path, const char *pin, int day);
-    int  DownloadData(const char *url);
-    bool Translate(xmlDocPtr pxmlDoc, const char **params);
+    bool Queue(const char *dest, const char *pin, int day);
+    int  Fetch(const char *dest, int day);
+    bool Translate(FILE *out, xmlDocPtr pxmlDoc, const char **params);
+    void Bench(xmlDocPtr pxmlDoc, const char **params, const char *channelid, const char *channelnum);
+    void SetupLibXML();
     void LoadXSLT();
   public:
     cepgdata2xmltv();
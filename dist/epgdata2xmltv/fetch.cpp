@@ -0,0 +1,235 @@
+/*
+ * fetch.cpp: a grabber for the xmltv2vdr plugin
+ *
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "fetch.h"
+
+static size_t WriteMemoryCallback(void *ptr, size_t size, size_t nmemb, void *dataptr)
+{
+    struct data *data = (struct data *) dataptr;
+    size_t realsize = size * nmemb;
+    if (data->fd!=-1)
+    {
+        if (write(data->fd,ptr,realsize)==-1) return -1;
+        data->size+=realsize;
+    }
+    return realsize;
+}
+
+cepgdatafetch::cepgdatafetch(int Connections)
+{
+    multi=NULL;
+    running=false;
+    stop=false;
+    connections=Connections>0 ? Connections : 1;
+    pthread_mutex_init(&mutex,NULL);
+    pthread_cond_init(&cond,NULL);
+}
+
+cepgdatafetch::~cepgdatafetch()
+{
+    if (running)
+    {
+        pthread_mutex_lock(&mutex);
+        stop=true;
+        pthread_cond_broadcast(&cond);
+        pthread_mutex_unlock(&mutex);
+        pthread_join(thread,NULL);
+    }
+    for (size_t i=0; i<transfers.size(); i++)
+    {
+        transfer *t=transfers[i];
+        if (t->handle)
+        {
+            if (multi) curl_multi_remove_handle(multi,t->handle);
+            curl_easy_cleanup(t->handle);
+        }
+        if (t->data.fd!=-1)
+        {
+            // unfinished transfer
+            close(t->data.fd);
+            unlink(t->dest);
+        }
+        free(t->url);
+        free(t->dest);
+        delete t;
+    }
+    if (multi) curl_multi_cleanup(multi);
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+}
+
+void *cepgdatafetch::Thread(void *arg)
+{
+    ((cepgdatafetch *) arg)->Action();
+    return NULL;
+}
+
+void cepgdatafetch::StartTransfer(transfer *t)
+{
+    t->started=true;
+    t->data.size=0;
+    t->data.fd=open(t->dest,O_CREAT|O_TRUNC|O_WRONLY,0664);
+    if (t->data.fd==-1)
+    {
+        t->result=-40; // unused curl error
+        t->done=true;
+        return;
+    }
+    t->handle=curl_easy_init();
+    if (!t->handle)
+    {
+        close(t->data.fd);
+        t->data.fd=-1;
+        unlink(t->dest);
+        t->result=-40;
+        t->done=true;
+        return;
+    }
+    curl_easy_setopt(t->handle, CURLOPT_URL, t->url);  // Specify URL to get
+    curl_easy_setopt(t->handle, CURLOPT_FOLLOWLOCATION, 0);  // don't follow redirects
+    curl_easy_setopt(t->handle, CURLOPT_WRITEFUNCTION, WriteMemoryCallback);  // Send all data to this function
+    curl_easy_setopt(t->handle, CURLOPT_WRITEDATA, (void *) &t->data);  // Pass our 'data' struct to the callback function
+    curl_easy_setopt(t->handle, CURLOPT_MAXFILESIZE, 85971520);  // Set maximum file size to get (bytes)
+    curl_easy_setopt(t->handle, CURLOPT_NOPROGRESS, 1);  // No progress meter
+    curl_easy_setopt(t->handle, CURLOPT_NOSIGNAL, 1);  // No signaling
+    curl_easy_setopt(t->handle, CURLOPT_TIMEOUT, 300);  // Set timeout to 300 seconds
+    curl_easy_setopt(t->handle, CURLOPT_USERAGENT, EPGDATA2XMLTV_USERAGENT);  // Some servers don't like requests that are made without a user-agent field
+    curl_easy_setopt(t->handle, CURLOPT_PRIVATE, (void *) t);
+    curl_multi_add_handle(multi,t->handle);
+}
+
+void cepgdatafetch::FinishTransfer(transfer *t, CURLcode code)
+{
+    int ret=code;
+    if (!ret)
+    {
+        long code;
+        curl_easy_getinfo(t->handle, CURLINFO_RESPONSE_CODE, &code);
+        if (code==407)
+        {
+            ret=10;
+        }
+        else
+        {
+            if (code!=200) ret=22;
+        }
+    }
+    if ((t->data.size<120) && (!ret)) ret=22;
+
+    curl_multi_remove_handle(multi,t->handle);
+    curl_easy_cleanup(t->handle);
+    t->handle=NULL;
+    close(t->data.fd);
+    t->data.fd=-1;
+    if (ret) unlink(t->dest);
+    t->result=-ret;
+    t->done=true;
+}
+
+void cepgdatafetch::Action()
+{
+    pthread_mutex_lock(&mutex);
+    while (!stop)
+    {
+        int active=0;
+        for (size_t i=0; i<transfers.size(); i++)
+        {
+            transfer *t=transfers[i];
+            if (!t->started) StartTransfer(t);
+            if (!t->done) active++;
+        }
+        pthread_cond_broadcast(&cond);
+        if (!active)
+        {
+            pthread_cond_wait(&cond,&mutex);
+            continue;
+        }
+        pthread_mutex_unlock(&mutex);
+
+        int running_handles;
+        curl_multi_perform(multi,&running_handles);
+
+        CURLMsg *msg;
+        int left;
+        while ((msg=curl_multi_info_read(multi,&left)))
+        {
+            if (msg->msg!=CURLMSG_DONE) continue;
+            transfer *t=NULL;
+            curl_easy_getinfo(msg->easy_handle, CURLINFO_PRIVATE, (char **) &t);
+            CURLcode result=msg->data.result;
+            pthread_mutex_lock(&mutex);
+            if (t) FinishTransfer(t,result);
+            pthread_cond_broadcast(&cond);
+            pthread_mutex_unlock(&mutex);
+        }
+        // short timeout, so newly queued days are picked up
+        curl_multi_wait(multi,NULL,0,100,NULL);
+        pthread_mutex_lock(&mutex);
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+bool cepgdatafetch::Add(int day, const char *url, const char *dest)
+{
+    if (!multi)
+    {
+        multi=curl_multi_init();
+        if (!multi) return false;
+        // connections are kept in the multi handle and reused for the next days
+        curl_multi_setopt(multi, CURLMOPT_MAX_TOTAL_CONNECTIONS, (long) connections);
+        curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, (long) connections);
+    }
+    transfer *t=new transfer;
+    memset(t,0,sizeof(transfer));
+    t->day=day;
+    t->url=strdup(url);
+    t->dest=strdup(dest);
+    t->data.fd=-1;
+
+    pthread_mutex_lock(&mutex);
+    transfers.push_back(t);
+    if (!running)
+    {
+        if (pthread_create(&thread,NULL,Thread,this))
+        {
+            transfers.pop_back();
+            pthread_mutex_unlock(&mutex);
+            free(t->url);
+            free(t->dest);
+            delete t;
+            return false;
+        }
+        running=true;
+    }
+    pthread_cond_broadcast(&cond);
+    pthread_mutex_unlock(&mutex);
+    return true;
+}
+
+int cepgdatafetch::Wait(int day)
+{
+    int ret=-40;
+    pthread_mutex_lock(&mutex);
+    transfer *t=NULL;
+    for (size_t i=transfers.size(); i>0; i--)
+    {
+        if (transfers[i-1]->day==day)
+        {
+            t=transfers[i-1];
+            break;
+        }
+    }
+    if (t)
+    {
+        while (!t->done) pthread_cond_wait(&cond,&mutex);
+        ret=t->result;
+    }
+    pthread_mutex_unlock(&mutex);
+    return ret;
+}
@@ -0,0 +1,58 @@
+/*
+ * fetch.h: a grabber for the xmltv2vdr plugin
+ *
+ */
+
+#ifndef __FETCH_H
+#define __FETCH_H
+
+#include <curl/curl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <vector>
+
+#define EPGDATA2XMLTV_USERAGENT "libcurl-agent/1.0"
+#define EPGDATA2XMLTV_CONNECTIONS 2
+
+struct data
+{
+    size_t size;
+    int fd;
+};
+
+// downloads all queued days through one curl multi handle in a
+// background thread, so conversion can run while the next days arrive
+class cepgdatafetch
+{
+private:
+    struct transfer
+    {
+        int day;
+        char *url;
+        char *dest;
+        struct data data;
+        CURL *handle;
+        bool started;
+        bool done;
+        int result;
+    };
+    std::vector<transfer *> transfers;
+    CURLM *multi;
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    bool running;
+    bool stop;
+    int connections;
+    static void *Thread(void *arg);
+    void Action();
+    void StartTransfer(transfer *t);
+    void FinishTransfer(transfer *t, CURLcode code);
+public:
+    cepgdatafetch(int Connections);
+    ~cepgdatafetch();
+    bool Add(int day, const char *url, const char *dest);
+    int Wait(int day);
+};
+
+#endif //__FETCH_H
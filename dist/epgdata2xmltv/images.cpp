@@ -0,0 +1,231 @@
+/*
+ * images.cpp: a grabber for the xmltv2vdr plugin
+ *
+ */
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include "images.h"
+#include "epgdata2xmltv.h"
+
+extern int SysLogLevel;
+extern void syslog_redir(const char *format, ...);
+
+cepgdataimages::cepgdataimages()
+{
+    dirty=false;
+    written=skipped=removed=failed=0;
+    Load();
+}
+
+cepgdataimages::~cepgdataimages()
+{
+    if (dirty) Save();
+}
+
+void cepgdataimages::Load()
+{
+    FILE *f=fopen(EPGDATA2XMLTV_IMGDIR "/" EPGDATA2XMLTV_IMGINDEX,"r");
+    if (!f) return;
+    char *line=NULL;
+    size_t size=0;
+    while (getline(&line,&size,f)!=-1)
+    {
+        // crc size name
+        unsigned int crc;
+        unsigned long long isize;
+        int pos=0;
+        if (sscanf(line,"%x %llu %n",&crc,&isize,&pos)<2 || !pos) continue;
+        char *name=line+pos;
+        char *lf=strchr(name,'\n');
+        if (lf) *lf=0;
+        if (!*name) continue;
+        image img;
+        img.crc=crc;
+        img.size=isize;
+        img.seen=false;
+        index[name]=img;
+    }
+    if (line) free(line);
+    fclose(f);
+}
+
+void cepgdataimages::Save()
+{
+    const char *tmp=EPGDATA2XMLTV_IMGDIR "/" EPGDATA2XMLTV_IMGINDEX ".tmp";
+    FILE *f=fopen(tmp,"w");
+    if (!f)
+    {
+        esyslog("failed to write image index");
+        return;
+    }
+    for (std::map<std::string,image>::iterator it=index.begin(); it!=index.end(); ++it)
+    {
+        fprintf(f,"%08x %llu %s\n",it->second.crc,it->second.size,it->first.c_str());
+    }
+    if (fclose(f) || rename(tmp,EPGDATA2XMLTV_IMGDIR "/" EPGDATA2XMLTV_IMGINDEX))
+    {
+        esyslog("failed to write image index");
+        unlink(tmp);
+        return;
+    }
+    dirty=false;
+}
+
+bool cepgdataimages::Write(struct zip *zip, int i, const char *name, unsigned long long size)
+{
+    // stream into a temporary file and rename it into place, so
+    // a reader never sees a half written image
+    char *dest=NULL,*tmp=NULL;
+    if (asprintf(&dest,EPGDATA2XMLTV_IMGDIR "/%s",name)==-1) return false;
+    if (asprintf(&tmp,EPGDATA2XMLTV_IMGDIR "/.%s.tmp",name)==-1)
+    {
+        free(dest);
+        return false;
+    }
+
+    bool ok=false;
+    struct zip_file *zfile=zip_fopen_index(zip,i,0);
+    if (zfile)
+    {
+        int fd=open(tmp,O_CREAT|O_TRUNC|O_WRONLY,0644);
+        if (fd!=-1)
+        {
+            char buf[32768];
+            unsigned long long total=0;
+            ok=true;
+            for (;;)
+            {
+                int n=zip_fread(zfile,buf,sizeof(buf));
+                if (n<0) ok=false;
+                if (n<=0) break;
+                if (write(fd,buf,n)!=n)
+                {
+                    ok=false;
+                    break;
+                }
+                total+=n;
+            }
+            if (total!=size) ok=false;
+            if (close(fd)) ok=false;
+            if (ok && rename(tmp,dest)) ok=false;
+            if (!ok) unlink(tmp);
+        }
+        zip_fclose(zfile);
+    }
+    if (!ok) esyslog("failed to extract %s",name);
+    free(tmp);
+    free(dest);
+    return ok;
+}
+
+void cepgdataimages::Extract(struct zip *zip)
+{
+    int entries=zip_get_num_files(zip);
+    for (int i=0; i<entries; i++)
+    {
+        const char *name=zip_get_name(zip,i,0);
+        if (!name || !strstr(name,"jpg")) continue;
+        if (strchr(name,'/') || (name[0]=='.')) continue;
+
+        struct zip_stat sb;
+        memset(&sb,0,sizeof(sb));
+        if (zip_stat_index(zip,i,ZIP_FL_UNCHANGED,&sb)==-1) continue;
+
+        std::map<std::string,image>::iterator it=index.find(name);
+        if (it!=index.end())
+        {
+            if (it->second.seen && (it->second.crc==sb.crc) && (it->second.size==sb.size))
+            {
+                // already handled from a previous day
+                continue;
+            }
+            if ((it->second.crc==sb.crc) && (it->second.size==sb.size))
+            {
+                char *dest=NULL;
+                if (asprintf(&dest,EPGDATA2XMLTV_IMGDIR "/%s",name)!=-1)
+                {
+                    struct stat statbuf;
+                    bool exists=((stat(dest,&statbuf)!=-1) &&
+                                 ((unsigned long long) statbuf.st_size==sb.size));
+                    free(dest);
+                    if (exists)
+                    {
+                        it->second.seen=true;
+                        skipped++;
+                        continue;
+                    }
+                }
+            }
+        }
+
+        if (!Write(zip,i,name,sb.size))
+        {
+            failed++;
+            continue;
+        }
+        image img;
+        img.crc=sb.crc;
+        img.size=sb.size;
+        img.seen=true;
+        index[name]=img;
+        dirty=true;
+        written++;
+    }
+}
+
+void cepgdataimages::Cleanup()
+{
+    // remove images which are no longer in any zip
+    DIR *dir=opendir(EPGDATA2XMLTV_IMGDIR);
+    if (!dir) return;
+    struct dirent *entry;
+    while ((entry=readdir(dir)))
+    {
+        const char *name=entry->d_name;
+        bool stale=false;
+        if (name[0]=='.')
+        {
+            // leftovers of an interrupted run
+            size_t len=strlen(name);
+            stale=((len>4) && (!strcmp(name+len-4,".tmp")) && strcmp(name,EPGDATA2XMLTV_IMGINDEX ".tmp"));
+        }
+        else if (strstr(name,"jpg"))
+        {
+            std::map<std::string,image>::iterator it=index.find(name);
+            stale=((it==index.end()) || (!it->second.seen));
+        }
+        if (!stale) continue;
+        char *path=NULL;
+        if (asprintf(&path,EPGDATA2XMLTV_IMGDIR "/%s",name)==-1) continue;
+        if (!unlink(path) && (name[0]!='.')) removed++;
+        free(path);
+    }
+    closedir(dir);
+
+    std::map<std::string,image>::iterator it=index.begin();
+    while (it!=index.end())
+    {
+        if (!it->second.seen)
+        {
+            index.erase(it++);
+            dirty=true;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void cepgdataimages::Report()
+{
+    if (dirty) Save();
+    esyslog("images: written=%i skipped=%i removed=%i failed=%i",written,skipped,removed,failed);
+}
@@ -0,0 +1,41 @@
+/*
+ * images.h: a grabber for the xmltv2vdr plugin
+ *
+ */
+
+#ifndef __IMAGES_H
+#define __IMAGES_H
+
+#include <zip.h>
+#include <map>
+#include <string>
+
+#define EPGDATA2XMLTV_IMGDIR "/var/lib/epgsources/epgdata2xmltv-img"
+#define EPGDATA2XMLTV_IMGINDEX ".index"
+
+// extracts the images of the zip files, unchanged images (same crc32
+// and size as in the index) are skipped
+class cepgdataimages
+{
+private:
+    struct image
+    {
+        unsigned int crc;
+        unsigned long long size;
+        bool seen;
+    };
+    std::map<std::string,image> index;
+    bool dirty;
+    int written,skipped,removed,failed;
+    void Load();
+    void Save();
+    bool Write(struct zip *zip, int i, const char *name, unsigned long long size);
+public:
+    cepgdataimages();
+    ~cepgdataimages();
+    void Extract(struct zip *zip);
+    void Cleanup();
+    void Report();
+};
+
+#endif //__IMAGES_H
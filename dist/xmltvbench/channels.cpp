@@ -0,0 +1,25 @@
+/*
+ * channels.cpp: vdr channels and mappings for the offline benchmarks
+ *
+ */
+
+#include <vdr/channels.h>
+
+#include "xmltv2vdr.h"
+#include "channels.h"
+
+void XMLTVBenchChannels(cGlobals *Global, int Channels)
+{
+    int source=tChannelID::FromString("S19.2E-1-1-1").Source();
+    cStateKey StateKey;
+    cChannels *channels=cChannels::GetChannelsWrite(StateKey);
+    for (int i=1; i<=Channels; i++)
+    {
+        tChannelID id(source,1,1,i);
+        channels->Add(new cChannel(id,*cString::sprintf("Bench %i",i),i));
+        cString name=cString::sprintf("bench-%03i.de",i);
+        cString map=cString::sprintf("0;%i;%s",0x3FFF|OPT_APPEND,*id.ToString());
+        Global->EPGMappings()->Add(new cEPGMapping(name,map));
+    }
+    StateKey.Remove();
+}
@@ -0,0 +1,15 @@
+/*
+ * channels.h: vdr channels and mappings for the offline benchmarks
+ *
+ */
+
+#ifndef _CHANNELS_H
+#define _CHANNELS_H
+
+class cGlobals;
+
+// adds the vdr channels S19.2E-1-1-1 ... and maps bench-001.de ... to them,
+// with all fields and the append option
+void XMLTVBenchChannels(cGlobals *Global, int Channels);
+
+#endif
@@ -0,0 +1,188 @@
+/*
+ * generator.cpp: deterministic xmltv data for benchmarking the xmltv2vdr plugin
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#include "generator.h"
+
+static const char *titles[]=
+{
+    "Tatort","Die Rosenheim-Cops","Großstadtrevier","Der Bergdoktor","Heute-Show",
+    "Küstenwache","Alarm für Cobra 11 - Die Autobahnpolizei","SOKO München","Die Simpsons",
+    "Two and a Half Men","The Big Bang Theory","Navy CIS","Über Wasser: Die Nordsee",
+    "Mörderische Straßen","Tagesschau","Sportschau","Wer weiß denn sowas?","Lindenstraße"
+};
+#define NUMTITLES (int) (sizeof(titles)/sizeof(titles[0]))
+
+static const char *words[]=
+{
+    "Ärger","im","Revier","Die","Rückkehr","des","Königs","Flucht","über","Grenze",
+    "Schöne","Grüße","aus","Köln","Weiß","nicht","Spaß","beiseite","Größenwahn","Nacht"
+};
+#define NUMWORDS (int) (sizeof(words)/sizeof(words[0]))
+
+static const char *categories[]=
+{
+    "Krimi","Serie","Comedy","Dokumentation","Nachrichten","Sport","Show","Spielfilm"
+};
+#define NUMCATEGORIES (int) (sizeof(categories)/sizeof(categories[0]))
+
+static unsigned int rnd=1;
+
+static unsigned int Random()
+{
+    // deterministic, so that two runs produce the same data
+    rnd=rnd*1103515245+12345;
+    return (rnd>>16) & 0x7fff;
+}
+
+static void Words(char *Buffer, size_t Size, int Count, unsigned int Seed)
+{
+    Buffer[0]=0;
+    for (int i=0; i<Count; i++)
+    {
+        const char *w=words[(Seed+i*7) % NUMWORDS];
+        if (strlen(Buffer)+strlen(w)+2>=Size) break;
+        if (i) strcat(Buffer," ");
+        strcat(Buffer,w);
+    }
+}
+
+static void ShortText(char *Buffer, size_t Size, int Episode)
+{
+    Words(Buffer,Size,2+(Episode % 4),(unsigned int) Episode*13);
+    char num[16];
+    snprintf(num,sizeof(num)," %i",Episode);
+    if (strlen(Buffer)+strlen(num)<Size) strcat(Buffer,num);
+}
+
+static void XMLEscape(const char *In, FILE *Out)
+{
+    for (const char *p=In; *p; p++)
+    {
+        switch (*p)
+        {
+        case '&':
+            fputs("&amp;",Out);
+            break;
+        case '<':
+            fputs("&lt;",Out);
+            break;
+        case '>':
+            fputs("&gt;",Out);
+            break;
+        default:
+            fputc(*p,Out);
+            break;
+        }
+    }
+}
+
+int XMLTVBenchEPLists(const char *Dir, int Episodes)
+{
+    mkdir(Dir,0755);
+    for (int t=0; t<NUMTITLES; t++)
+    {
+        char *name=NULL;
+        if (asprintf(&name,"%s/%s.episodes",Dir,titles[t])==-1) return 1;
+        FILE *f=fopen(name,"w");
+        free(name);
+        if (!f) return 1;
+        fprintf(f,"# %s\n# SE\tEP\tNo.\tTitle\n",titles[t]);
+        for (int e=1; e<=Episodes; e++)
+        {
+            char stext[256];
+            ShortText(stext,sizeof(stext),e);
+            fprintf(f,"%i\t%i\t%i\t%s\n",1+((e-1)/20),1+((e-1) % 20),e,stext);
+        }
+        fclose(f);
+    }
+    return 0;
+}
+
+static void XMLTVTime(time_t Time, char *Buffer, size_t Size)
+{
+    struct tm tm;
+    gmtime_r(&Time,&tm);
+    strftime(Buffer,Size,"%Y%m%d%H%M%S +0000",&tm);
+}
+
+long XMLTVBenchGenerate(FILE *Out, int Days, int Channels, int Fields, int Episodes)
+{
+    time_t begin=(time(NULL)/86400)*86400;
+    long events=0;
+
+    fprintf(Out,"<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n");
+    fprintf(Out,"<tv generator-info-name=\"xmltvbench\">\n");
+    for (int c=1; c<=Channels; c++)
+    {
+        fprintf(Out,"<channel id=\"bench-%03i.de\">\n<display-name lang=\"de\">Bench %i</display-name>\n</channel>\n",c,c);
+    }
+    for (int c=1; c<=Channels; c++)
+    {
+        rnd=(unsigned int) c;
+        time_t start=begin;
+        unsigned int eventid=(unsigned int) c*100000;
+        while (start<begin+Days*86400)
+        {
+            int duration=(15+(Random() % 8)*15)*60;
+            int t=Random() % NUMTITLES;
+            int episode=1+(Random() % Episodes);
+            char tstart[32],tstop[32];
+            XMLTVTime(start,tstart,sizeof(tstart));
+            XMLTVTime(start+duration,tstop,sizeof(tstop));
+
+            fprintf(Out,"<programme start=\"%s\" stop=\"%s\" channel=\"bench-%03i.de\">\n",tstart,tstop,c);
+            fprintf(Out,"<!-- pid = %u -->\n",eventid++);
+            fprintf(Out,"<title lang=\"de\">");
+            XMLEscape(titles[t],Out);
+            fprintf(Out,"</title>\n");
+            if (Fields>=1)
+            {
+                char buf[1024];
+                ShortText(buf,sizeof(buf),episode);
+                fprintf(Out,"<sub-title lang=\"de\">");
+                XMLEscape(buf,Out);
+                fprintf(Out,"</sub-title>\n<desc lang=\"de\">");
+                for (int p=0; p<3; p++)
+                {
+                    Words(buf,sizeof(buf),40,Random());
+                    XMLEscape(buf,Out);
+                    fprintf(Out,". ");
+                }
+                fprintf(Out,"</desc>\n");
+            }
+            if (Fields>=2)
+            {
+                fprintf(Out,"<credits>\n<director>Regisseur %i</director>\n",Random() % 100);
+                for (int a=0; a<5; a++) fprintf(Out,"<actor>Schauspieler %i</actor>\n",Random() % 1000);
+                fprintf(Out,"</credits>\n");
+                fprintf(Out,"<date>%i</date>\n",1980+(Random() % 40));
+                fprintf(Out,"<category lang=\"de\">%s</category>\n",categories[Random() % NUMCATEGORIES]);
+                fprintf(Out,"<country>D</country>\n");
+                fprintf(Out,"<episode-num system=\"xmltv_ns\">%i.%i.</episode-num>\n",(episode-1)/20,(episode-1) % 20);
+                fprintf(Out,"<video><aspect>16:9</aspect><quality>HDTV</quality></video>\n");
+                fprintf(Out,"<audio><stereo>stereo</stereo></audio>\n");
+                fprintf(Out,"<rating system=\"FSK\"><value>%i</value></rating>\n",(Random() % 4)*6);
+                fprintf(Out,"<star-rating><value>%i/5</value></star-rating>\n",1+(Random() % 5));
+                fprintf(Out,"<review type=\"text\">");
+                char buf[512];
+                Words(buf,sizeof(buf),20,Random());
+                XMLEscape(buf,Out);
+                fprintf(Out,"</review>\n");
+            }
+            fprintf(Out,"</programme>\n");
+            start+=duration;
+            events++;
+        }
+    }
+    fprintf(Out,"</tv>\n");
+    fflush(Out);
+    return events;
+}
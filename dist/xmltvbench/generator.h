@@ -0,0 +1,19 @@
+/*
+ * generator.h: deterministic xmltv data for benchmarking the xmltv2vdr plugin
+ *
+ */
+
+#ifndef _GENERATOR_H
+#define _GENERATOR_H
+
+#include <stdio.h>
+
+// writes eplists for the generated series into Dir, returns 0 on success
+int XMLTVBenchEPLists(const char *Dir, int Episodes);
+
+// writes the xmltv data of Channels channels (bench-001.de ...) for Days days,
+// Fields: 0=title only, 1=title/subtitle/description, 2=all fields,
+// returns the number of events
+long XMLTVBenchGenerate(FILE *Out, int Days, int Channels, int Fields, int Episodes);
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ * kernels.cpp: runs the microbenchmarks of the xmltv2vdr plugin (see bench.cpp)
+ *              without vdr, with allocations per operation
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "xmltv2vdr.h"
+#include "bench.h"
+#include "generator.h"
+#include "channels.h"
+
+// count all allocations, glibc calls these for its own allocations too
+extern "C"
+{
+    void *__libc_malloc(size_t size);
+    void *__libc_calloc(size_t nmemb, size_t size);
+    void *__libc_realloc(void *ptr, size_t size);
+}
+
+static uint64_t allocations;
+
+extern "C" void *malloc(size_t size)
+{
+    __atomic_add_fetch(&allocations,1,__ATOMIC_RELAXED);
+    return __libc_malloc(size);
+}
+
+extern "C" void *calloc(size_t nmemb, size_t size)
+{
+    __atomic_add_fetch(&allocations,1,__ATOMIC_RELAXED);
+    return __libc_calloc(nmemb,size);
+}
+
+extern "C" void *realloc(void *ptr, size_t size)
+{
+    __atomic_add_fetch(&allocations,1,__ATOMIC_RELAXED);
+    return __libc_realloc(ptr,size);
+}
+
+static uint64_t Allocations(void)
+{
+    return __atomic_load_n(&allocations,__ATOMIC_RELAXED);
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,"usage: %s [-l loops] [-c channels] [-e episodes] [-v]\n\n"
+            "  -l loops     operations per benchmark, default %i\n"
+            "  -c channels  number of mappings for GetMap, default 50\n"
+            "  -e episodes  episodes per generated eplist for FetchSeasonEpisode, default 200,\n"
+            "               0 uses the eplists in ~/.eplists/lists\n"
+            "  -v           log like vdr with log level 3 to stderr\n\n"
+            "each benchmark writes one line to stdout\n",name,XMLTVBENCH_LOOPS);
+}
+
+int main(int argc, char *argv[])
+{
+    int loops=XMLTVBENCH_LOOPS,channels=50,episodes=200;
+    int c;
+    while ((c=getopt(argc,argv,"l:c:e:vh"))!=-1)
+    {
+        switch (c)
+        {
+        case 'l':
+            loops=atoi(optarg);
+            break;
+        case 'c':
+            channels=atoi(optarg);
+            break;
+        case 'e':
+            episodes=atoi(optarg);
+            break;
+        case 'v':
+            SysLogLevel=3;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (loops<1 || channels<1)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    char tmpdir[]="/tmp/xmltvbench.XXXXXX";
+    if (!mkdtemp(tmpdir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    cGlobals *g=new cGlobals();
+    if (episodes>0)
+    {
+        cString epdir=AddDirectory(tmpdir,"eplists");
+        if (mkdir(epdir,0755) || XMLTVBenchEPLists(epdir,episodes))
+        {
+            fprintf(stderr,"failed to write eplists to %s\n",*epdir);
+            return 1;
+        }
+        g->SetEPDir(epdir);
+    }
+    XMLTVBenchChannels(g,channels);
+
+    cXMLTVBench::SetAllocationCounter(Allocations);
+    cXMLTVBench bench(g,loops);
+    cString result=bench.Run();
+    printf("%s",*result ? *result : "");
+
+    delete g;
+    RemoveFileOrDir(tmpdir);
+    return 0;
+}
@@ -0,0 +1,206 @@
+/*
+ * offline.cpp: runs parse and import of the xmltv2vdr plugin on generated data,
+ *              without vdr (see vdrstub.h)
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <sys/resource.h>
+
+#include "xmltv2vdr.h"
+#include "generator.h"
+#include "channels.h"
+
+#define BENCHSOURCE "xmltvbench"
+
+class cBenchExecutor : public cEPGExecutor
+{
+private:
+    cGlobals *g;
+    cEPGSource *source;
+    char *buffer;
+    size_t size;
+    long events;
+    int runs;
+    int result;
+public:
+    cBenchExecutor(cGlobals *Global, cEPGSource *Source, char *Buffer, size_t Size, long Events, int Runs);
+    int Result()
+    {
+        return result;
+    }
+    virtual void Action();
+};
+
+cBenchExecutor::cBenchExecutor(cGlobals *Global, cEPGSource *Source, char *Buffer, size_t Size, long Events,
+                               int Runs): cEPGExecutor(Global->EPGSources())
+{
+    g=Global;
+    source=Source;
+    buffer=Buffer;
+    size=Size;
+    events=Events;
+    runs=Runs;
+    result=0;
+}
+
+void cBenchExecutor::Action()
+{
+    cParse parse(source,g);
+    cImport import(g);
+    cEPGSourceStats *stats=source->Stats();
+
+    for (int run=1; run<=runs && Running(); run++)
+    {
+        stats->Reset();
+        stats->bytes=size;
+        uint64_t start=cEPGSourceStats::Now();
+        result=parse.Process(*this,buffer,size);
+        uint64_t parsed=cEPGSourceStats::Now();
+        if (result) break;
+        result=import.Process(source,*this);
+        uint64_t imported=cEPGSourceStats::Now();
+        if (result) break;
+
+        struct rusage usage;
+        getrusage(RUSAGE_SELF,&usage);
+        double secs=(imported-start)/1000000.0;
+        printf("{\"run\":%i,\"events\":%li,\"bytes\":%llu,\"parse_ms\":%llu,\"import_ms\":%llu,"
+               "\"events_per_s\":%.0f,\"peak_rss_kb\":%li,\"xml_ms\":%llu,\"parse_sql_ms\":%llu,"
+               "\"import_sql_ms\":%llu,\"lockwait_ms\":%llu,\"lockhold_ms\":%llu,\"inserted\":%i,"
+               "\"updated\":%i,\"unchanged\":%i,\"skipped\":%i,\"rows\":%i,\"changed\":%i,"
+               "\"events_unchanged\":%i}\n",
+               run,events,(unsigned long long) size,(unsigned long long) (parsed-start)/1000,
+               (unsigned long long) (imported-parsed)/1000,secs>0 ? events/secs : 0,usage.ru_maxrss,
+               (unsigned long long) stats->xml/1000,(unsigned long long) stats->parsesql/1000,
+               (unsigned long long) stats->importsql/1000,(unsigned long long) stats->lockwait/1000,
+               (unsigned long long) stats->lockhold/1000,stats->inserted,stats->updated,stats->unchanged,
+               stats->skipped,stats->rows,stats->changed,stats->eventsunchanged);
+        fflush(stdout);
+    }
+}
+
+static void usage(const char *name)
+{
+    fprintf(stderr,"usage: %s [-c channels] [-d days] [-f fields] [-e episodes] [-r runs] [-o database] [-z] [-v]\n\n"
+            "  -c channels  number of channels, default 50\n"
+            "  -d days      days of data, default 7\n"
+            "  -f fields    0=title only, 1=title/subtitle/description, 2=all fields (default)\n"
+            "  -e episodes  write eplists with this number of episodes per series and\n"
+            "               look up season/episode, default off\n"
+            "  -r runs      number of parse/import runs on the same data, default 2\n"
+            "  -o database  epg database, default a new one in a temporary directory\n"
+            "  -z           compress texts (if built with libzstd)\n"
+            "  -v           log like vdr with log level 3 to stderr\n\n"
+            "each run writes one line of json to stdout, times in milliseconds\n",name);
+}
+
+int main(int argc, char *argv[])
+{
+    int channels=50,days=7,fields=2,episodes=0,runs=2;
+    const char *database=NULL;
+    bool compress=false;
+    int c;
+    while ((c=getopt(argc,argv,"c:d:f:e:r:o:zvh"))!=-1)
+    {
+        switch (c)
+        {
+        case 'c':
+            channels=atoi(optarg);
+            break;
+        case 'd':
+            days=atoi(optarg);
+            break;
+        case 'f':
+            fields=atoi(optarg);
+            break;
+        case 'e':
+            episodes=atoi(optarg);
+            break;
+        case 'r':
+            runs=atoi(optarg);
+            break;
+        case 'o':
+            database=optarg;
+            break;
+        case 'z':
+            compress=true;
+            break;
+        case 'v':
+            SysLogLevel=3;
+            break;
+        default:
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (channels<1 || days<1 || runs<1)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    char tmpdir[]="/tmp/xmltvbench.XXXXXX";
+    if (!mkdtemp(tmpdir))
+    {
+        perror("mkdtemp");
+        return 1;
+    }
+
+    cGlobals *g=new cGlobals();
+    g->SetConfDir(tmpdir);
+    g->SetCompress(compress);
+    // like in vdr the runtime database may be on a tmpfs, use a unique name
+    g->SetEPGFile(database ? database : *cString::sprintf("%s/%s.db",tmpdir,strrchr(tmpdir,'/')+1));
+    if (episodes>0)
+    {
+        cString epdir=AddDirectory(tmpdir,"eplists");
+        if (mkdir(epdir,0755) || XMLTVBenchEPLists(epdir,episodes))
+        {
+            fprintf(stderr,"failed to write eplists to %s\n",*epdir);
+            return 1;
+        }
+        g->SetEPDir(epdir);
+        g->AllocateEPGSeasonThread();
+    }
+    g->DBChanged();
+
+    XMLTVBenchChannels(g,channels);
+
+    char *buffer=NULL;
+    size_t size=0;
+    FILE *out=open_memstream(&buffer,&size);
+    if (!out)
+    {
+        perror("open_memstream");
+        return 1;
+    }
+    long events=XMLTVBenchGenerate(out,days,channels,fields,episodes>0 ? episodes : 200);
+    fclose(out);
+
+    cParse::InitLibXML();
+    sqlite3_enable_shared_cache(0);
+    // there is no control file in /var/lib/epgsources, don't log that
+    int loglevel=SysLogLevel;
+    SysLogLevel=0;
+    cEPGSource *source=new cEPGSource(BENCHSOURCE,g);
+    SysLogLevel=loglevel;
+    source->ChangeDaysInAdvance(days);
+    g->EPGSources()->Add(source);
+
+    cBenchExecutor executor(g,source,buffer,size,events,runs);
+    executor.Start();
+    while (executor.Active()) cCondWait::SleepMs(100);
+
+    if (g->EPGSeasonEpisode()) g->EPGSeasonEpisode()->Stop();
+    g->EPGBackup()->Stop();
+    if (!database || g->EPGBackup()->Save()) g->EPGDatabase()->Unlink();
+    cParse::CleanupLibXML();
+    delete g;
+    free(buffer);
+    RemoveFileOrDir(tmpdir);
+    return executor.Result() ? 1 : 0;
+}
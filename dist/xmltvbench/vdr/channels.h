@@ -0,0 +1,11 @@
+/*
+ * channels.h: stub for xmltvbench, see vdrstub.h
+ *
+ */
+
+#ifndef __CHANNELS_H
+#define __CHANNELS_H
+
+#include "vdrstub.h"
+
+#endif
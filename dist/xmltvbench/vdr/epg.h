@@ -0,0 +1,11 @@
+/*
+ * epg.h: stub for xmltvbench, see vdrstub.h
+ *
+ */
+
+#ifndef __EPG_H
+#define __EPG_H
+
+#include "vdrstub.h"
+
+#endif
@@ -0,0 +1,11 @@
+/*
+ * plugin.h: stub for xmltvbench, see vdrstub.h
+ *
+ */
+
+#ifndef __PLUGIN_H
+#define __PLUGIN_H
+
+#include "vdrstub.h"
+
+#endif
@@ -0,0 +1,11 @@
+/*
+ * thread.h: stub for xmltvbench, see vdrstub.h
+ *
+ */
+
+#ifndef __THREAD_H
+#define __THREAD_H
+
+#include "vdrstub.h"
+
+#endif
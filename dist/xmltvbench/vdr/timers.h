@@ -0,0 +1,11 @@
+/*
+ * timers.h: stub for xmltvbench, see vdrstub.h
+ *
+ */
+
+#ifndef __TIMERS_H
+#define __TIMERS_H
+
+#include "vdrstub.h"
+
+#endif
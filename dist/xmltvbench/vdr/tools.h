@@ -0,0 +1,11 @@
+/*
+ * tools.h: stub for xmltvbench, see vdrstub.h
+ *
+ */
+
+#ifndef __TOOLS_H
+#define __TOOLS_H
+
+#include "vdrstub.h"
+
+#endif
@@ -0,0 +1,679 @@
+/*
+ * vdrstub.h: the parts of the VDR API used by parse and import of xmltv2vdr, for benchmarks without VDR
+ *
+ * All stub headers (vdr/tools.h, vdr/epg.h ...) include this file. Only what the
+ * parser and the importer call is here: lists, strings, threads, channels, events
+ * and schedules behave like in VDR. The plugin class, the epg handler, the epg timer
+ * and the setup menus are not part of the offline build.
+ *
+ */
+
+#ifndef _VDRSTUB_H
+#define _VDRSTUB_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <iconv.h>
+#include <limits.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <syslog.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <map>
+
+#define VDRVERSION  "2.4.0"
+#define VDRVERSNUM  20400
+#define APIVERSION  "2.4.0"
+#define APIVERSNUM  20400
+
+typedef unsigned char uchar;
+typedef uint32_t tEventID;
+
+// --- logging ---------------------------------------------------------------
+
+extern int SysLogLevel;
+void syslog_with_tid(int priority, const char *format, ...) __attribute__ ((format (printf, 2, 3)));
+
+#define esyslog(a...) void( (SysLogLevel > 0) ? syslog_with_tid(LOG_ERR, a) : void() )
+#define isyslog(a...) void( (SysLogLevel > 1) ? syslog_with_tid(LOG_ERR, a) : void() )
+#define dsyslog(a...) void( (SysLogLevel > 2) ? syslog_with_tid(LOG_ERR, a) : void() )
+
+#define LOG_ERROR         esyslog("ERROR (%s,%d): %m", __FILE__, __LINE__)
+#define LOG_ERROR_STR(s)  esyslog("ERROR (%s,%d): %s: %m", __FILE__, __LINE__, s)
+
+#define tr(s)     (s)
+#define trNOOP(s) (s)
+#define trVDR(s)  (s)
+
+#define MaxEventContents 4
+
+template<class T> inline T min(T a, T b)
+{
+    return a <= b ? a : b;
+}
+template<class T> inline T max(T a, T b)
+{
+    return a >= b ? a : b;
+}
+
+// --- tools -----------------------------------------------------------------
+
+class cString
+{
+private:
+    char *s;
+public:
+    cString(const char *S=NULL, bool TakePointer=false);
+    cString(const cString &String);
+    virtual ~cString();
+    operator const void * () const
+    {
+        return s;
+    }
+    operator const char * () const
+    {
+        return s;
+    }
+    const char * operator*() const
+    {
+        return s;
+    }
+    cString &operator=(const cString &String);
+    cString &operator=(const char *String);
+    static cString sprintf(const char *fmt, ...) __attribute__ ((format (printf, 1, 2)));
+};
+
+class cListObject
+{
+private:
+    cListObject *prev,*next;
+public:
+    cListObject();
+    virtual ~cListObject();
+    virtual int Compare(const cListObject &) const
+    {
+        return 0;
+    }
+    void Append(cListObject *Object);
+    void Insert(cListObject *Object);
+    void Unlink();
+    int Index() const;
+    cListObject *Prev() const
+    {
+        return prev;
+    }
+    cListObject *Next() const
+    {
+        return next;
+    }
+};
+
+class cListBase
+{
+protected:
+    cListObject *objects,*lastObject;
+    int count;
+    cListBase();
+public:
+    virtual ~cListBase();
+    void Add(cListObject *Object, cListObject *After=NULL);
+    void Del(cListObject *Object, bool DeleteObject=true);
+    virtual void Move(int From, int To);
+    void Move(cListObject *From, cListObject *To);
+    virtual void Clear();
+    cListObject *Get(int Index) const;
+    int Count() const
+    {
+        return count;
+    }
+    void Sort();
+};
+
+template<class T> class cList : public cListBase
+{
+public:
+    cList(const char * =NULL) {}
+    T *Get(int Index) const
+    {
+        return (T *) cListBase::Get(Index);
+    }
+    T *First() const
+    {
+        return (T *) objects;
+    }
+    T *Last() const
+    {
+        return (T *) lastObject;
+    }
+    T *Prev(const T *Object) const
+    {
+        return (T *) Object->cListObject::Prev();
+    }
+    T *Next(const T *Object) const
+    {
+        return (T *) Object->cListObject::Next();
+    }
+};
+
+template<class T> class cVector
+{
+private:
+    mutable int allocated;
+    mutable int size;
+    mutable T *data;
+    cVector(const cVector &Vector) {}
+    void Realloc(int Index) const
+    {
+        if (++Index > allocated)
+        {
+            data=(T *) realloc(data,Index*sizeof(T));
+            for (int i=allocated; i<Index; i++) data[i]=T(0);
+            allocated=Index;
+        }
+    }
+public:
+    cVector(int Allocated=10)
+    {
+        allocated=0;
+        size=0;
+        data=NULL;
+        Realloc(Allocated);
+    }
+    virtual ~cVector()
+    {
+        free(data);
+    }
+    T& At(int Index) const
+    {
+        Realloc(Index);
+        if (Index>=size) size=Index+1;
+        return data[Index];
+    }
+    const T& operator[](int Index) const
+    {
+        return At(Index);
+    }
+    T& operator[](int Index)
+    {
+        return At(Index);
+    }
+    int IndexOf(const T &Data) const
+    {
+        for (int i=0; i<size; i++)
+            if (data[i]==Data) return i;
+        return -1;
+    }
+    int Size() const
+    {
+        return size;
+    }
+    virtual void Insert(T Data, int Before=0)
+    {
+        if (Before<size)
+        {
+            Realloc(size);
+            memmove(&data[Before+1],&data[Before],(size-Before)*sizeof(T));
+            size++;
+            data[Before]=Data;
+        }
+        else
+            Append(Data);
+    }
+    virtual void Append(T Data)
+    {
+        if (size>=allocated) Realloc(allocated*3/2 > size ? allocated*3/2 : size+1);
+        data[size++]=Data;
+    }
+    virtual void Remove(int Index)
+    {
+        if (Index<0) return;
+        if (Index<size-1) memmove(&data[Index],&data[Index+1],(size-Index)*sizeof(T));
+        size--;
+    }
+    virtual void Clear()
+    {
+        for (int i=0; i<size; i++) data[i]=T(0);
+        size=0;
+    }
+    void Sort(int (*Compare)(const void *, const void *))
+    {
+        qsort(data,size,sizeof(T),Compare);
+    }
+};
+
+int CompareStrings(const void *a, const void *b);
+
+class cStringList : public cVector<char *>
+{
+public:
+    cStringList(int Allocated=10): cVector<char *>(Allocated) {}
+    virtual ~cStringList();
+    int Find(const char *s) const;
+    void Sort()
+    {
+        cVector<char *>::Sort(CompareStrings);
+    }
+    virtual void Clear();
+};
+
+class cTimeMs
+{
+private:
+    uint64_t begin;
+public:
+    cTimeMs(int Ms=0);
+    static uint64_t Now();
+    void Set(int Ms=0);
+    bool TimedOut() const;
+    uint64_t Elapsed() const;
+};
+
+class cCharSetConv
+{
+private:
+    iconv_t cd;
+    char *result;
+    size_t length;
+public:
+    cCharSetConv(const char *FromCode=NULL, const char *ToCode=NULL);
+    ~cCharSetConv();
+    const char *Convert(const char *From, char *To=NULL, size_t ToLength=0);
+};
+
+char *strcpyrealloc(char *dest, const char *src);
+char *strn0cpy(char *dest, const char *src, size_t n);
+char *strreplace(char *s, const char *s1, const char *s2);
+char *compactspace(char *s);
+bool RemoveFileOrDir(const char *FileName, bool FollowSymlinks=false);
+cString AddDirectory(const char *DirName, const char *FileName);
+
+// --- thread ----------------------------------------------------------------
+
+class cMutex
+{
+    friend class cCondVar;
+private:
+    pthread_mutex_t mutex;
+    int locked;
+public:
+    cMutex();
+    ~cMutex();
+    void Lock();
+    void Unlock();
+};
+
+class cMutexLock
+{
+private:
+    cMutex *mutex;
+    bool locked;
+public:
+    cMutexLock(cMutex *Mutex=NULL);
+    ~cMutexLock();
+    bool Lock(cMutex *Mutex);
+};
+
+class cCondVar
+{
+private:
+    pthread_cond_t cond;
+public:
+    cCondVar();
+    ~cCondVar();
+    void Wait(cMutex &Mutex);
+    bool TimedWait(cMutex &Mutex, int TimeoutMs);
+    void Broadcast();
+};
+
+class cCondWait
+{
+public:
+    static void SleepMs(int TimeoutMs);
+};
+
+class cStateKey
+{
+    friend class cStateLock;
+private:
+    class cStateLock *stateLock;
+    int state;
+public:
+    cStateKey(bool IgnoreFirst=false);
+    ~cStateKey();
+    void Reset();
+    void Remove(bool IncState=true);
+    int State() const
+    {
+        return state;
+    }
+};
+
+class cStateLock
+{
+    friend class cStateKey;
+private:
+    pthread_rwlock_t rwlock;
+    int state;
+public:
+    cStateLock();
+    ~cStateLock();
+    bool Lock(cStateKey &StateKey, bool Write=false, int TimeoutMs=0);
+    void Unlock(cStateKey &StateKey, bool IncState=true);
+};
+
+class cThread
+{
+private:
+    bool active;
+    bool running;
+    pthread_t childTid;
+    static void *StartThread(cThread *Thread);
+protected:
+    virtual void Action()=0;
+    bool Running()
+    {
+        return running;
+    }
+    void Cancel(int WaitSeconds=0);
+    void SetPriority(int Priority);
+public:
+    cThread(const char *Description=NULL, bool LowPriority=false);
+    virtual ~cThread();
+    bool Start();
+    bool Active();
+    static int ThreadId();
+};
+
+// --- channels --------------------------------------------------------------
+
+struct tChannelID
+{
+private:
+    int source;
+    int nid;
+    int tid;
+    int sid;
+    int rid;
+public:
+    tChannelID()
+    {
+        source=nid=tid=sid=rid=0;
+    }
+    tChannelID(int Source, int Nid, int Tid, int Sid, int Rid=0)
+    {
+        source=Source;
+        nid=Nid;
+        tid=Tid;
+        sid=Sid;
+        rid=Rid;
+    }
+    bool operator==(const tChannelID &arg) const
+    {
+        return source==arg.source && nid==arg.nid && tid==arg.tid && sid==arg.sid && rid==arg.rid;
+    }
+    bool Valid() const
+    {
+        return (nid || tid) && sid;
+    }
+    int Source() const
+    {
+        return source;
+    }
+    int Nid() const
+    {
+        return nid;
+    }
+    int Tid() const
+    {
+        return tid;
+    }
+    int Sid() const
+    {
+        return sid;
+    }
+    int Rid() const
+    {
+        return rid;
+    }
+    static tChannelID FromString(const char *s);
+    cString ToString() const;
+    static const tChannelID InvalidID;
+};
+
+class cSchedule;
+
+class cChannel : public cListObject
+{
+private:
+    tChannelID channelID;
+    char *name;
+    int number;
+public:
+    // not in VDR, channels.conf is not read
+    cChannel(tChannelID ChannelID, const char *Name, int Number);
+    virtual ~cChannel();
+    tChannelID GetChannelID() const
+    {
+        return channelID;
+    }
+    const char *Name() const
+    {
+        return name;
+    }
+    int Number() const
+    {
+        return number;
+    }
+    int Sid() const
+    {
+        return channelID.Sid();
+    }
+};
+
+class cChannels : public cList<cChannel>
+{
+public:
+    static const cChannels *GetChannelsRead(cStateKey &StateKey, int TimeoutMs=0);
+    static cChannels *GetChannelsWrite(cStateKey &StateKey, int TimeoutMs=0);
+    const cChannel *GetByNumber(int Number) const;
+    const cChannel *GetByChannelID(tChannelID ChannelID, bool TryWithoutRid=false,
+                                   bool TryWithoutPolarization=false) const;
+};
+
+// --- epg -------------------------------------------------------------------
+
+class cEvent : public cListObject
+{
+    friend class cSchedule;
+private:
+    cSchedule *schedule;
+    tEventID eventID;
+    uchar tableID;
+    uchar version;
+    uchar contents[MaxEventContents];
+    int parentalRating;
+    char *title;
+    char *shortText;
+    char *description;
+    time_t startTime;
+    int duration;
+public:
+    cEvent(tEventID EventID);
+    virtual ~cEvent();
+    virtual int Compare(const cListObject &ListObject) const;
+    tChannelID ChannelID() const;
+    const cSchedule *Schedule() const
+    {
+        return schedule;
+    }
+    tEventID EventID() const
+    {
+        return eventID;
+    }
+    uchar TableID() const
+    {
+        return tableID;
+    }
+    uchar Version() const
+    {
+        return version;
+    }
+    const char *Title() const
+    {
+        return title;
+    }
+    const char *ShortText() const
+    {
+        return shortText;
+    }
+    const char *Description() const
+    {
+        return description;
+    }
+    uchar Contents(int i=0) const
+    {
+        return (0<=i && i<MaxEventContents) ? contents[i] : uchar(0);
+    }
+    int ParentalRating() const
+    {
+        return parentalRating;
+    }
+    time_t StartTime() const
+    {
+        return startTime;
+    }
+    time_t EndTime() const
+    {
+        return startTime+duration;
+    }
+    int Duration() const
+    {
+        return duration;
+    }
+    void SetEventID(tEventID EventID);
+    void SetTableID(uchar TableID)
+    {
+        tableID=TableID;
+    }
+    void SetVersion(uchar Version)
+    {
+        version=Version;
+    }
+    void SetTitle(const char *Title);
+    void SetShortText(const char *ShortText);
+    void SetDescription(const char *Description);
+    void SetContents(uchar *Contents);
+    void SetParentalRating(int ParentalRating)
+    {
+        parentalRating=ParentalRating;
+    }
+    void SetStartTime(time_t StartTime);
+    void SetDuration(int Duration)
+    {
+        duration=Duration;
+    }
+};
+
+class cSchedule : public cListObject
+{
+private:
+    tChannelID channelID;
+    cList<cEvent> events;
+    std::map<tEventID,cEvent *> eventsHashID;
+    bool modified;
+public:
+    cSchedule(tChannelID ChannelID);
+    tChannelID ChannelID() const
+    {
+        return channelID;
+    }
+    bool Modified() const
+    {
+        return modified;
+    }
+    void SetModified()
+    {
+        modified=true;
+    }
+    const cList<cEvent> *Events() const
+    {
+        return &events;
+    }
+    cEvent *AddEvent(cEvent *Event);
+    void HashEvent(cEvent *Event);
+    void UnhashEvent(cEvent *Event);
+    void Sort();
+    const cEvent *GetEvent(tEventID EventID, time_t StartTime=0) const;
+};
+
+class cSchedules : public cList<cSchedule>
+{
+public:
+    static cSchedules *GetSchedulesWrite(cStateKey &StateKey, int TimeoutMs=0);
+    cSchedule *AddSchedule(tChannelID ChannelID);
+    const cSchedule *GetSchedule(tChannelID ChannelID) const;
+    const cSchedule *GetSchedule(const cChannel *Channel, bool AddIfMissing=false) const;
+};
+
+// only a base class for cEPGHandler in xmltv2vdr.h
+class cEpgHandler : public cListObject
+{
+};
+
+// --- timers ----------------------------------------------------------------
+
+// the day and time functions used for the source's update times
+class cTimer
+{
+public:
+    static int GetWDay(time_t t);
+    static time_t IncDay(time_t t, int Days);
+    static time_t SetTime(time_t t, int SecondsFromMidnight);
+    static int TimeToInt(int t);
+    static cString PrintDay(time_t Day, int WeekDays, bool SingleByteChars);
+};
+
+// --- plugin ----------------------------------------------------------------
+
+// only for the declarations in xmltv2vdr.h
+class cOsdObject;
+class cMenuSetupPage;
+
+class cPlugin
+{
+public:
+    virtual ~cPlugin() {}
+    virtual bool Service(const char *, void * =NULL)
+    {
+        return false;
+    }
+};
+
+// there are no other plugins, e.g. no epgsearch for the sources
+class cPluginManager
+{
+public:
+    static cPlugin *GetPlugin(const char *)
+    {
+        return NULL;
+    }
+};
+
+class cVideoDirectory
+{
+public:
+    static const char *Name();
+};
+
+#endif
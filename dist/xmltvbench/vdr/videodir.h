@@ -0,0 +1,11 @@
+/*
+ * videodir.h: stub for xmltvbench, see vdrstub.h
+ *
+ */
+
+#ifndef __VIDEODIR_H
+#define __VIDEODIR_H
+
+#include "vdrstub.h"
+
+#endif
@@ -0,0 +1,1058 @@
+/*
+ * vdrstub.cpp: the parts of the VDR API used by parse and import of xmltv2vdr, for benchmarks without VDR
+ *
+ * Most of the code follows the implementation in VDR.
+ *
+ */
+
+#include <ctype.h>
+#include <sys/time.h>
+#include <sys/syscall.h>
+
+#include "vdr/vdrstub.h"
+
+// --- logging ---------------------------------------------------------------
+
+int SysLogLevel=1;
+
+void syslog_with_tid(int, const char *format, ...)
+{
+    va_list ap;
+    va_start(ap,format);
+    fprintf(stderr,"[%i] ",cThread::ThreadId());
+    vfprintf(stderr,format,ap);
+    fputc('\n',stderr);
+    va_end(ap);
+}
+
+// --- cString ---------------------------------------------------------------
+
+cString::cString(const char *S, bool TakePointer)
+{
+    s=TakePointer ? (char *) S : S ? strdup(S) : NULL;
+}
+
+cString::cString(const cString &String)
+{
+    s=String.s ? strdup(String.s) : NULL;
+}
+
+cString::~cString()
+{
+    free(s);
+}
+
+cString &cString::operator=(const cString &String)
+{
+    if (this==&String) return *this;
+    free(s);
+    s=String.s ? strdup(String.s) : NULL;
+    return *this;
+}
+
+cString &cString::operator=(const char *String)
+{
+    if (s==String) return *this;
+    free(s);
+    s=String ? strdup(String) : NULL;
+    return *this;
+}
+
+cString cString::sprintf(const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap,fmt);
+    char *buffer;
+    if (!fmt || vasprintf(&buffer,fmt,ap)<0) buffer=strdup("???");
+    va_end(ap);
+    return cString(buffer,true);
+}
+
+// --- cListObject, cListBase ------------------------------------------------
+
+cListObject::cListObject()
+{
+    prev=next=NULL;
+}
+
+cListObject::~cListObject()
+{
+}
+
+void cListObject::Append(cListObject *Object)
+{
+    next=Object;
+    Object->prev=this;
+}
+
+void cListObject::Insert(cListObject *Object)
+{
+    prev=Object;
+    Object->next=this;
+}
+
+void cListObject::Unlink()
+{
+    if (next) next->prev=prev;
+    if (prev) prev->next=next;
+    next=prev=NULL;
+}
+
+int cListObject::Index() const
+{
+    cListObject *p=prev;
+    int i=0;
+    while (p)
+    {
+        i++;
+        p=p->prev;
+    }
+    return i;
+}
+
+cListBase::cListBase()
+{
+    objects=lastObject=NULL;
+    count=0;
+}
+
+cListBase::~cListBase()
+{
+    Clear();
+}
+
+void cListBase::Add(cListObject *Object, cListObject *After)
+{
+    if (After && After!=lastObject)
+    {
+        After->Next()->Insert(Object);
+        After->Append(Object);
+    }
+    else
+    {
+        if (lastObject)
+            lastObject->Append(Object);
+        else
+            objects=Object;
+        lastObject=Object;
+    }
+    count++;
+}
+
+void cListBase::Del(cListObject *Object, bool DeleteObject)
+{
+    if (Object==objects) objects=Object->Next();
+    if (Object==lastObject) lastObject=Object->Prev();
+    Object->Unlink();
+    if (DeleteObject) delete Object;
+    count--;
+}
+
+void cListBase::Move(int From, int To)
+{
+    Move(Get(From),Get(To));
+}
+
+void cListBase::Move(cListObject *From, cListObject *To)
+{
+    if (From && To && From!=To)
+    {
+        if (From->Index()<To->Index()) To=To->Next();
+        if (From==objects) objects=From->Next();
+        if (From==lastObject) lastObject=From->Prev();
+        From->Unlink();
+        if (To)
+        {
+            if (To->Prev()) To->Prev()->Append(From);
+            From->Append(To);
+        }
+        else
+        {
+            lastObject->Append(From);
+            lastObject=From;
+        }
+        if (!From->Prev()) objects=From;
+    }
+}
+
+void cListBase::Clear()
+{
+    while (objects)
+    {
+        cListObject *object=objects->Next();
+        delete objects;
+        objects=object;
+    }
+    objects=lastObject=NULL;
+    count=0;
+}
+
+cListObject *cListBase::Get(int Index) const
+{
+    if (Index<0) return NULL;
+    cListObject *object=objects;
+    while (object && Index-->0) object=object->Next();
+    return object;
+}
+
+static int CompareListObjects(const void *a, const void *b)
+{
+    const cListObject *la=*(const cListObject **) a;
+    const cListObject *lb=*(const cListObject **) b;
+    return la->Compare(*lb);
+}
+
+void cListBase::Sort()
+{
+    int n=Count();
+    if (n<2) return;
+    cListObject **a=(cListObject **) malloc(n*sizeof(cListObject *));
+    if (!a) return;
+    cListObject *object=objects;
+    int i=0;
+    while (object && i<n)
+    {
+        a[i++]=object;
+        object=object->Next();
+    }
+    qsort(a,n,sizeof(cListObject *),CompareListObjects);
+    objects=lastObject=NULL;
+    for (i=0; i<n; i++)
+    {
+        a[i]->Unlink();
+        count--;
+        Add(a[i]);
+    }
+    free(a);
+}
+
+// --- cStringList -----------------------------------------------------------
+
+int CompareStrings(const void *a, const void *b)
+{
+    return strcmp(*(const char **) a,*(const char **) b);
+}
+
+cStringList::~cStringList()
+{
+    Clear();
+}
+
+int cStringList::Find(const char *s) const
+{
+    for (int i=0; i<Size(); i++)
+    {
+        if (!strcmp(s,At(i))) return i;
+    }
+    return -1;
+}
+
+void cStringList::Clear()
+{
+    for (int i=0; i<Size(); i++) free(At(i));
+    cVector<char *>::Clear();
+}
+
+// --- cTimeMs ---------------------------------------------------------------
+
+cTimeMs::cTimeMs(int Ms)
+{
+    if (Ms>=0)
+        Set(Ms);
+    else
+        begin=0;
+}
+
+uint64_t cTimeMs::Now()
+{
+    struct timespec tp;
+    clock_gettime(CLOCK_MONOTONIC,&tp);
+    return (uint64_t(tp.tv_sec))*1000+tp.tv_nsec/1000000;
+}
+
+void cTimeMs::Set(int Ms)
+{
+    begin=Now()+Ms;
+}
+
+bool cTimeMs::TimedOut() const
+{
+    return Now()>=begin;
+}
+
+uint64_t cTimeMs::Elapsed() const
+{
+    return Now()-begin;
+}
+
+// --- cCharSetConv ----------------------------------------------------------
+
+cCharSetConv::cCharSetConv(const char *FromCode, const char *ToCode)
+{
+    if (!FromCode) FromCode="UTF-8";
+    if (!ToCode) ToCode="UTF-8";
+    cd=iconv_open(ToCode,FromCode);
+    result=NULL;
+    length=0;
+}
+
+cCharSetConv::~cCharSetConv()
+{
+    free(result);
+    if (cd!=(iconv_t) -1) iconv_close(cd);
+}
+
+const char *cCharSetConv::Convert(const char *From, char *To, size_t ToLength)
+{
+    if (cd==(iconv_t) -1 || !From || !*From) return From;
+    char *FromPtr=(char *) From;
+    size_t FromLength=strlen(From);
+    char *ToPtr=To;
+    if (!ToPtr)
+    {
+        int NewLength=max(length,FromLength*2);
+        if (char *NewBuffer=(char *) realloc(result,NewLength))
+        {
+            length=NewLength;
+            result=NewBuffer;
+        }
+        else
+        {
+            esyslog("ERROR: out of memory");
+            return From;
+        }
+        ToPtr=result;
+        ToLength=length;
+    }
+    else if (!ToLength)
+        return From;
+    char *Converted=ToPtr;
+    while (FromLength>0)
+    {
+        if (iconv(cd,&FromPtr,&FromLength,&ToPtr,&ToLength)==size_t(-1))
+        {
+            if (errno==E2BIG || (errno==EILSEQ && ToLength<1))
+            {
+                if (To) break;
+                size_t d=ToPtr-result;
+                size_t r=length/2;
+                int NewLength=length+r;
+                if (char *NewBuffer=(char *) realloc(result,NewLength))
+                {
+                    length=NewLength;
+                    Converted=result=NewBuffer;
+                }
+                else
+                {
+                    esyslog("ERROR: out of memory");
+                    return From;
+                }
+                ToLength+=r;
+                ToPtr=result+d;
+            }
+            if (errno==EILSEQ)
+            {
+                FromPtr++;
+                FromLength--;
+                *ToPtr++='?';
+                ToLength--;
+            }
+            else if (errno!=E2BIG)
+                return From;
+        }
+    }
+    if (ToLength<1)
+    {
+        if (To)
+            ToPtr--;
+        else
+        {
+            size_t d=ToPtr-result;
+            if (char *NewBuffer=(char *) realloc(result,length+1))
+            {
+                length++;
+                Converted=result=NewBuffer;
+                ToPtr=result+d;
+            }
+            else
+                ToPtr--;
+        }
+    }
+    *ToPtr=0;
+    return Converted;
+}
+
+// --- string and file functions ---------------------------------------------
+
+char *strcpyrealloc(char *dest, const char *src)
+{
+    if (src)
+    {
+        int l=max(dest ? strlen(dest) : 0,strlen(src))+1;
+        if ((dest=(char *) realloc(dest,l))!=NULL)
+            strcpy(dest,src);
+        else
+            esyslog("ERROR: out of memory");
+    }
+    else
+    {
+        free(dest);
+        dest=NULL;
+    }
+    return dest;
+}
+
+char *strn0cpy(char *dest, const char *src, size_t n)
+{
+    char *s=dest;
+    for (; --n && (*dest=*src)!=0; dest++, src++) ;
+    *dest=0;
+    return s;
+}
+
+char *strreplace(char *s, const char *s1, const char *s2)
+{
+    if (!s || !s1 || !s2) return s;
+    char *p=strstr(s,s1);
+    if (p)
+    {
+        int of=p-s;
+        int l=strlen(s);
+        int l1=strlen(s1);
+        int l2=strlen(s2);
+        if (l2>l1)
+        {
+            if (char *NewBuffer=(char *) realloc(s,l+l2-l1+1))
+                s=NewBuffer;
+            else
+            {
+                esyslog("ERROR: out of memory");
+                return s;
+            }
+        }
+        char *sof=s+of;
+        if (l2!=l1) memmove(sof+l2,sof+l1,l-of-l1+1);
+        memcpy(sof,s2,l2);
+    }
+    return s;
+}
+
+static char *skipspace(const char *s)
+{
+    if ((uchar)*s>' ') return (char *) s;
+    while (*s && (uchar)*s<=' ') s++;
+    return (char *) s;
+}
+
+static char *stripspace(char *s)
+{
+    if (s && *s)
+    {
+        for (char *p=s+strlen(s)-1; p>=s; p--)
+        {
+            if (!isspace(*p)) break;
+            *p=0;
+        }
+    }
+    return s;
+}
+
+char *compactspace(char *s)
+{
+    if (s && *s)
+    {
+        char *t=stripspace(skipspace(s));
+        char *p=t;
+        while (p && *p)
+        {
+            char *q=skipspace(p);
+            if (q-p>1) memmove(p+1,q,strlen(q)+1);
+            p++;
+        }
+        if (t!=s) memmove(s,t,strlen(t)+1);
+    }
+    return s;
+}
+
+bool RemoveFileOrDir(const char *FileName, bool FollowSymlinks)
+{
+    struct stat st;
+    if (stat(FileName,&st)==0)
+    {
+        if (S_ISDIR(st.st_mode))
+        {
+            DIR *d=opendir(FileName);
+            if (d)
+            {
+                struct dirent *e;
+                while ((e=readdir(d))!=NULL)
+                {
+                    if (!strcmp(e->d_name,".") || !strcmp(e->d_name,"..")) continue;
+                    cString buffer=AddDirectory(FileName,e->d_name);
+                    if (!RemoveFileOrDir(buffer,FollowSymlinks))
+                    {
+                        closedir(d);
+                        return false;
+                    }
+                }
+                closedir(d);
+            }
+            return rmdir(FileName)==0;
+        }
+        return remove(FileName)==0;
+    }
+    return errno==ENOENT;
+}
+
+cString AddDirectory(const char *DirName, const char *FileName)
+{
+    if (*FileName=='/') FileName++;
+    return cString::sprintf("%s/%s",DirName && *DirName ? DirName : ".",FileName);
+}
+
+// --- cMutex, cCondVar, cCondWait -------------------------------------------
+
+cMutex::cMutex()
+{
+    locked=0;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_settype(&attr,PTHREAD_MUTEX_ERRORCHECK);
+    pthread_mutex_init(&mutex,&attr);
+    pthread_mutexattr_destroy(&attr);
+}
+
+cMutex::~cMutex()
+{
+    pthread_mutex_destroy(&mutex);
+}
+
+void cMutex::Lock()
+{
+    pthread_mutex_lock(&mutex);
+    locked++;
+}
+
+void cMutex::Unlock()
+{
+    if (!--locked) pthread_mutex_unlock(&mutex);
+}
+
+cMutexLock::cMutexLock(cMutex *Mutex)
+{
+    mutex=NULL;
+    locked=false;
+    Lock(Mutex);
+}
+
+cMutexLock::~cMutexLock()
+{
+    if (mutex && locked) mutex->Unlock();
+}
+
+bool cMutexLock::Lock(cMutex *Mutex)
+{
+    if (Mutex && !mutex)
+    {
+        mutex=Mutex;
+        Mutex->Lock();
+        locked=true;
+        return true;
+    }
+    return false;
+}
+
+static bool GetAbsTime(struct timespec *Abstime, int MillisecondsFromNow)
+{
+    struct timeval now;
+    if (gettimeofday(&now,NULL)==0)
+    {
+        now.tv_sec+=MillisecondsFromNow/1000;
+        now.tv_usec+=(MillisecondsFromNow%1000)*1000;
+        if (now.tv_usec>=1000000)
+        {
+            now.tv_sec++;
+            now.tv_usec-=1000000;
+        }
+        Abstime->tv_sec=now.tv_sec;
+        Abstime->tv_nsec=now.tv_usec*1000;
+        return true;
+    }
+    return false;
+}
+
+cCondVar::cCondVar()
+{
+    pthread_cond_init(&cond,0);
+}
+
+cCondVar::~cCondVar()
+{
+    pthread_cond_broadcast(&cond);
+    pthread_cond_destroy(&cond);
+}
+
+void cCondVar::Wait(cMutex &Mutex)
+{
+    if (Mutex.locked)
+    {
+        int locked=Mutex.locked;
+        Mutex.locked=0;
+        pthread_cond_wait(&cond,&Mutex.mutex);
+        Mutex.locked=locked;
+    }
+}
+
+bool cCondVar::TimedWait(cMutex &Mutex, int TimeoutMs)
+{
+    bool r=true;
+    if (Mutex.locked)
+    {
+        struct timespec abstime;
+        if (GetAbsTime(&abstime,TimeoutMs))
+        {
+            int locked=Mutex.locked;
+            Mutex.locked=0;
+            if (pthread_cond_timedwait(&cond,&Mutex.mutex,&abstime)==ETIMEDOUT) r=false;
+            Mutex.locked=locked;
+        }
+    }
+    return r;
+}
+
+void cCondVar::Broadcast()
+{
+    pthread_cond_broadcast(&cond);
+}
+
+void cCondWait::SleepMs(int TimeoutMs)
+{
+    TimeoutMs=max(TimeoutMs,3);
+    struct timespec ts;
+    ts.tv_sec=TimeoutMs/1000;
+    ts.tv_nsec=(TimeoutMs%1000)*1000000;
+    while (nanosleep(&ts,&ts)==-1 && errno==EINTR) ;
+}
+
+// --- cStateKey, cStateLock -------------------------------------------------
+
+cStateKey::cStateKey(bool IgnoreFirst)
+{
+    stateLock=NULL;
+    state=0;
+    if (!IgnoreFirst) Reset();
+}
+
+cStateKey::~cStateKey()
+{
+    if (stateLock)
+    {
+        esyslog("ERROR: cStateKey::~cStateKey() called without releasing the lock first");
+        Remove(false);
+    }
+}
+
+void cStateKey::Reset()
+{
+    state=-1;
+}
+
+void cStateKey::Remove(bool IncState)
+{
+    if (stateLock) stateLock->Unlock(*this,IncState);
+}
+
+cStateLock::cStateLock()
+{
+    pthread_rwlock_init(&rwlock,NULL);
+    state=0;
+}
+
+cStateLock::~cStateLock()
+{
+    pthread_rwlock_destroy(&rwlock);
+}
+
+bool cStateLock::Lock(cStateKey &StateKey, bool Write, int TimeoutMs)
+{
+    struct timespec abstime;
+    int rc;
+    if (TimeoutMs && GetAbsTime(&abstime,TimeoutMs))
+        rc=Write ? pthread_rwlock_timedwrlock(&rwlock,&abstime) : pthread_rwlock_timedrdlock(&rwlock,&abstime);
+    else
+        rc=Write ? pthread_rwlock_wrlock(&rwlock) : pthread_rwlock_rdlock(&rwlock);
+    if (rc) return false;
+    if (Write || StateKey.state!=state)
+    {
+        StateKey.stateLock=this;
+        if (!Write) StateKey.state=state;
+        return true;
+    }
+    pthread_rwlock_unlock(&rwlock);
+    return false;
+}
+
+void cStateLock::Unlock(cStateKey &StateKey, bool)
+{
+    if (StateKey.stateLock!=this) return;
+    StateKey.stateLock=NULL;
+    StateKey.state=state;
+    pthread_rwlock_unlock(&rwlock);
+}
+
+// --- cThread ---------------------------------------------------------------
+
+cThread::cThread(const char *, bool)
+{
+    active=running=false;
+    childTid=0;
+}
+
+cThread::~cThread()
+{
+    Cancel();
+}
+
+void cThread::SetPriority(int)
+{
+}
+
+void *cThread::StartThread(cThread *Thread)
+{
+    Thread->Action();
+    Thread->running=false;
+    Thread->active=false;
+    return NULL;
+}
+
+bool cThread::Start()
+{
+    if (!running)
+    {
+        if (active)
+        {
+            cTimeMs RestartTimeout;
+            while (!running && active && RestartTimeout.Elapsed()<5000)
+                cCondWait::SleepMs(10);
+        }
+        if (!active)
+        {
+            active=running=true;
+            if (pthread_create(&childTid,NULL,(void *(*)(void *)) &StartThread,(void *) this)==0)
+            {
+                pthread_detach(childTid);
+            }
+            else
+            {
+                LOG_ERROR;
+                active=running=false;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool cThread::Active()
+{
+    return active;
+}
+
+void cThread::Cancel(int WaitSeconds)
+{
+    running=false;
+    if (active && WaitSeconds>-1)
+    {
+        // threads are never killed, the benchmark waits for them
+        while (active) cCondWait::SleepMs(10);
+    }
+}
+
+int cThread::ThreadId()
+{
+    return syscall(SYS_gettid);
+}
+
+// --- channels --------------------------------------------------------------
+
+const tChannelID tChannelID::InvalidID;
+
+// sources are given as in channels.conf, e.g. S19.2E
+static int SourceFromString(const char *s)
+{
+    if (!s || !isalpha(*s)) return 0;
+    int type=toupper(*s)<<24;
+    int pos=0;
+    char *p;
+    double d=strtod(s+1,&p);
+    if (p!=s+1)
+    {
+        pos=int(d*10+0.5);
+        if (*p=='W') pos|=0x0800;
+        pos&=0xFFFF;
+    }
+    return type | pos;
+}
+
+static cString SourceToString(int Source)
+{
+    char type=(Source>>24) & 0xFF;
+    int pos=Source & 0x07FF;
+    if (!pos) return cString::sprintf("%c",type);
+    return cString::sprintf("%c%i.%i%c",type,pos/10,pos%10,(Source & 0x0800) ? 'W' : 'E');
+}
+
+tChannelID tChannelID::FromString(const char *s)
+{
+    char *sourcebuf=NULL;
+    int nid,tid,sid,rid=0;
+    int fields=sscanf(s,"%m[^-]-%d-%d-%d-%d",&sourcebuf,&nid,&tid,&sid,&rid);
+    if (fields==4 || fields==5)
+    {
+        int source=SourceFromString(sourcebuf);
+        free(sourcebuf);
+        if (source) return tChannelID(source,nid,tid,sid,rid);
+    }
+    else
+        free(sourcebuf);
+    return tChannelID::InvalidID;
+}
+
+cString tChannelID::ToString() const
+{
+    if (rid) return cString::sprintf("%s-%d-%d-%d-%d",*SourceToString(source),nid,tid,sid,rid);
+    return cString::sprintf("%s-%d-%d-%d",*SourceToString(source),nid,tid,sid);
+}
+
+cChannel::cChannel(tChannelID ChannelID, const char *Name, int Number)
+{
+    channelID=ChannelID;
+    name=strdup(Name ? Name : "");
+    number=Number;
+}
+
+cChannel::~cChannel()
+{
+    free(name);
+}
+
+static cChannels channels;
+static cStateLock channelsLock;
+
+const cChannels *cChannels::GetChannelsRead(cStateKey &StateKey, int TimeoutMs)
+{
+    return channelsLock.Lock(StateKey,false,TimeoutMs) ? &channels : NULL;
+}
+
+cChannels *cChannels::GetChannelsWrite(cStateKey &StateKey, int TimeoutMs)
+{
+    return channelsLock.Lock(StateKey,true,TimeoutMs) ? &channels : NULL;
+}
+
+const cChannel *cChannels::GetByNumber(int Number) const
+{
+    for (const cChannel *channel=First(); channel; channel=Next(channel))
+    {
+        if (channel->Number()==Number) return channel;
+    }
+    return NULL;
+}
+
+const cChannel *cChannels::GetByChannelID(tChannelID ChannelID, bool, bool) const
+{
+    for (const cChannel *channel=First(); channel; channel=Next(channel))
+    {
+        if (channel->GetChannelID()==ChannelID) return channel;
+    }
+    return NULL;
+}
+
+// --- epg -------------------------------------------------------------------
+
+cEvent::cEvent(tEventID EventID)
+{
+    schedule=NULL;
+    eventID=EventID;
+    tableID=0xFF;
+    version=0xFF;
+    memset(contents,0,sizeof(contents));
+    parentalRating=0;
+    title=shortText=description=NULL;
+    startTime=0;
+    duration=0;
+}
+
+cEvent::~cEvent()
+{
+    free(title);
+    free(shortText);
+    free(description);
+}
+
+int cEvent::Compare(const cListObject &ListObject) const
+{
+    cEvent *e=(cEvent *) &ListObject;
+    return startTime-e->startTime;
+}
+
+tChannelID cEvent::ChannelID() const
+{
+    return schedule ? schedule->ChannelID() : tChannelID();
+}
+
+void cEvent::SetEventID(tEventID EventID)
+{
+    if (eventID!=EventID)
+    {
+        if (schedule) schedule->UnhashEvent(this);
+        eventID=EventID;
+        if (schedule) schedule->HashEvent(this);
+    }
+}
+
+void cEvent::SetTitle(const char *Title)
+{
+    title=strcpyrealloc(title,Title);
+}
+
+void cEvent::SetShortText(const char *ShortText)
+{
+    shortText=strcpyrealloc(shortText,ShortText);
+}
+
+void cEvent::SetDescription(const char *Description)
+{
+    description=strcpyrealloc(description,Description);
+}
+
+void cEvent::SetContents(uchar *Contents)
+{
+    for (int i=0; i<MaxEventContents; i++) contents[i]=Contents[i];
+}
+
+void cEvent::SetStartTime(time_t StartTime)
+{
+    startTime=StartTime;
+}
+
+cSchedule::cSchedule(tChannelID ChannelID)
+{
+    channelID=ChannelID;
+    modified=false;
+}
+
+cEvent *cSchedule::AddEvent(cEvent *Event)
+{
+    events.Add(Event);
+    Event->schedule=this;
+    HashEvent(Event);
+    return Event;
+}
+
+void cSchedule::HashEvent(cEvent *Event)
+{
+    eventsHashID[Event->EventID()]=Event;
+}
+
+void cSchedule::UnhashEvent(cEvent *Event)
+{
+    std::map<tEventID,cEvent *>::iterator it=eventsHashID.find(Event->EventID());
+    if (it!=eventsHashID.end() && it->second==Event) eventsHashID.erase(it);
+}
+
+void cSchedule::Sort()
+{
+    events.Sort();
+}
+
+const cEvent *cSchedule::GetEvent(tEventID EventID, time_t StartTime) const
+{
+    std::map<tEventID,cEvent *>::const_iterator it=eventsHashID.find(EventID);
+    if (it==eventsHashID.end()) return NULL;
+    if (StartTime>0 && it->second->StartTime()!=StartTime) return NULL;
+    return it->second;
+}
+
+static cSchedules schedules;
+static cStateLock schedulesLock;
+
+cSchedules *cSchedules::GetSchedulesWrite(cStateKey &StateKey, int TimeoutMs)
+{
+    return schedulesLock.Lock(StateKey,true,TimeoutMs) ? &schedules : NULL;
+}
+
+cSchedule *cSchedules::AddSchedule(tChannelID ChannelID)
+{
+    cSchedule *p=(cSchedule *) GetSchedule(ChannelID);
+    if (!p)
+    {
+        p=new cSchedule(ChannelID);
+        Add(p);
+    }
+    return p;
+}
+
+const cSchedule *cSchedules::GetSchedule(tChannelID ChannelID) const
+{
+    for (const cSchedule *p=First(); p; p=Next(p))
+    {
+        if (p->ChannelID()==ChannelID) return p;
+    }
+    return NULL;
+}
+
+const cSchedule *cSchedules::GetSchedule(const cChannel *Channel, bool AddIfMissing) const
+{
+    const cSchedule *p=GetSchedule(Channel->GetChannelID());
+    if (!p && AddIfMissing) p=((cSchedules *) this)->AddSchedule(Channel->GetChannelID());
+    return p;
+}
+
+// --- timers ----------------------------------------------------------------
+
+int cTimer::GetWDay(time_t t)
+{
+    struct tm tm_r;
+    int weekday=localtime_r(&t,&tm_r)->tm_wday;
+    return weekday==0 ? 6 : weekday-1;
+}
+
+time_t cTimer::IncDay(time_t t, int Days)
+{
+    struct tm tm_r;
+    tm tm=*localtime_r(&t,&tm_r);
+    tm.tm_mday+=Days;
+    tm.tm_isdst=-1;
+    return mktime(&tm);
+}
+
+time_t cTimer::SetTime(time_t t, int SecondsFromMidnight)
+{
+    struct tm tm_r;
+    tm tm=*localtime_r(&t,&tm_r);
+    tm.tm_hour=SecondsFromMidnight/3600;
+    tm.tm_min=(SecondsFromMidnight%3600)/60;
+    tm.tm_sec=SecondsFromMidnight%60;
+    tm.tm_isdst=-1;
+    return mktime(&tm);
+}
+
+int cTimer::TimeToInt(int t)
+{
+    return (t/100*60+t%100)*60;
+}
+
+cString cTimer::PrintDay(time_t, int WeekDays, bool)
+{
+    char buffer[8];
+    for (int i=0; i<7; i++) buffer[i]=(WeekDays & (1<<i)) ? "MTWTFSS"[i] : '-';
+    buffer[7]=0;
+    return buffer;
+}
+
+// --- videodir --------------------------------------------------------------
+
+const char *cVideoDirectory::Name()
+{
+    return "/tmp";
+}
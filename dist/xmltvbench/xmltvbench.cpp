@@ -0,0 +1,52 @@
+/*
+ * xmltvbench.cpp: a synthetic epg source for benchmarking the xmltv2vdr plugin
+ *
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "generator.h"
+
+// called by xmltv2vdr as: xmltvbench <daysinadvance> <pin> <usepics>
+//
+// environment:
+// XMLTVBENCH_CHANNELS  number of channels (bench-001.de ...), default 50
+// XMLTVBENCH_FIELDS    0=title only, 1=title/subtitle/description, 2=all fields (default)
+// XMLTVBENCH_EPLISTS   directory, where eplists for the generated series are written
+// XMLTVBENCH_EPISODES  number of episodes per eplist, default 200
+
+int main(int argc, char *argv[])
+{
+    if (argc<4) return 132;
+    int days=atoi(argv[1]);
+    if (days<1) days=1;
+
+    int channels=50,fields=2,episodes=200;
+    if (getenv("XMLTVBENCH_CHANNELS")) channels=atoi(getenv("XMLTVBENCH_CHANNELS"));
+    if (getenv("XMLTVBENCH_FIELDS")) fields=atoi(getenv("XMLTVBENCH_FIELDS"));
+    if (getenv("XMLTVBENCH_EPISODES")) episodes=atoi(getenv("XMLTVBENCH_EPISODES"));
+    if (channels<1) channels=1;
+    if (episodes<1) episodes=1;
+
+    struct timespec t0,t1;
+    clock_gettime(CLOCK_MONOTONIC,&t0);
+
+    if (getenv("XMLTVBENCH_EPLISTS"))
+    {
+        if (XMLTVBenchEPLists(getenv("XMLTVBENCH_EPLISTS"),episodes))
+        {
+            fprintf(stderr,"failed to write eplists to %s\n",getenv("XMLTVBENCH_EPLISTS"));
+            return 1;
+        }
+    }
+
+    long events=XMLTVBenchGenerate(stdout,days,channels,fields,episodes);
+
+    clock_gettime(CLOCK_MONOTONIC,&t1);
+    long ms=(t1.tv_sec-t0.tv_sec)*1000+(t1.tv_nsec-t0.tv_nsec)/1000000;
+    fprintf(stderr,"xmltvbench channels=%i days=%i fields=%i episodes=%i events=%li ms=%li\n",
+            channels,days,fields,episodes,events,ms);
+    return 0;
+}
@@ -11,6 +11,9 @@
 #include <vdr/tools.h>
 #include <pcrecpp.h>
 #include "event.h"
+#include "import.h"
+#include "compress.h"
+#include "db.h"
 
 extern char *strcatrealloc(char *, const char*);
 
@@ -125,6 +128,7 @@ void cXMLTVEvent::SetShortText(const char *ShortText)
 
 void cXMLTVEvent::AddDescription(const char *Description)
 {
+    if (packed[XMLTVPACK_DESCRIPTION]) Unpack(XMLTVPACK_DESCRIPTION);
     if (!description)
     {
         SetDescription(Description);
@@ -140,6 +144,7 @@ void cXMLTVEvent::AddDescription(const char *Description)
 
 void cXMLTVEvent::SetDescription(const char *Description)
 {
+    DropPacked(XMLTVPACK_DESCRIPTION);
     description=strcpyrealloc(description, Description);
     if (description)
     {
@@ -150,6 +155,7 @@ void cXMLTVEvent::SetDescription(const char *Description)
 
 void cXMLTVEvent::SetEITDescription(const char *EITDescription)
 {
+    DropPacked(XMLTVPACK_EITDESCRIPTION);
     eitdescription=strcpyrealloc(eitdescription, EITDescription);
     if (eitdescription)
     {
@@ -180,6 +186,7 @@ void cXMLTVEvent::SetAudio(const char *Audio)
 
 void cXMLTVEvent::SetCredits(const char *Credits)
 {
+    if (packed[XMLTVPACK_CREDITS]) Unpack(XMLTVPACK_CREDITS);
     if (!Credits) return;
     char *c=strdup(Credits);
     if (!c) return;
@@ -226,6 +233,7 @@ void cXMLTVEvent::SetCategory(const char *Category)
 
 void cXMLTVEvent::SetReview(const char *Review)
 {
+    if (packed[XMLTVPACK_REVIEW]) Unpack(XMLTVPACK_REVIEW);
     if (!Review) return;
     char *c=strdup(Review);
     if (!c) return;
@@ -345,6 +353,7 @@ void cXMLTVEvent::SetStarRating(const char *StarRating)
 
 void cXMLTVEvent::AddReview(const char *Review)
 {
+    if (packed[XMLTVPACK_REVIEW]) Unpack(XMLTVPACK_REVIEW);
     char *val=strdup(Review);
     if (val)
     {
@@ -416,6 +425,7 @@ void cXMLTVEvent::AddCategory(const char *Category)
 
 void cXMLTVEvent::AddCredits(const char *CreditType, const char *Credit, const char *Addendum)
 {
+    if (packed[XMLTVPACK_CREDITS]) Unpack(XMLTVPACK_CREDITS);
     char *value=NULL;
     if (Addendum)
     {
@@ -451,7 +461,7 @@ void cXMLTVEvent::CreateEventID(time_t StartTime)
     weakid=true;
 }
 
-void cXMLTVEvent::GetSQL(const char *Source, int SrcIdx, const char *ChannelID, char **Insert, char **Update)
+void cXMLTVEvent::GetSQL(const char *Source, int SrcIdx, const char *XMLTVID, char **Insert, char **Update)
 {
     if (sql_insert)
     {
@@ -467,6 +477,9 @@ void cXMLTVEvent::GetSQL(const char *Source, int SrcIdx, const char *ChannelID,
     if (!Insert) return;
     if (!Update) return;
 
+    for (int i=0; i<XMLTVPACK_COUNT; i++)
+        if (packed[i]) Unpack(i);
+
     *Insert=NULL;
     *Update=NULL;
 
@@ -480,15 +493,20 @@ void cXMLTVEvent::GetSQL(const char *Source, int SrcIdx, const char *ChannelID,
 
     if (!eventid) return;
 
+    char key[256],sndx[11];
+    cImport::TitleKey(title,key,sizeof(key));
+    if (!cImport::SoundEx(sndx,title,0,1)) strcpy(sndx,"NULL");
+
     if (asprintf(&sql_insert,
-                 "INSERT OR FAIL INTO epg (src,channelid,eventid,starttime,duration,"\
+                 "INSERT OR FAIL INTO epgevents_%i (src,xmltvid,eventid,starttime,duration,"\
                  "title,alttitle,origtitle,shorttext,description,country,year,credits,category,"\
-                 "review,rating,starrating,video,audio,season,episode,episodeoverall,pics,srcidx) "\
+                 "review,rating,starrating,video,audio,season,episode,episodeoverall,pics,srcidx,"\
+                 "titlekey,soundex,epcheck) "\
                  "VALUES (^%s^,^%s^,%u,%li,%i,"\
-                 "^%s^,^%s^,^%s^,^%s^,^%s^,^%s^,%i,^%s^,^%s^,"\
-                 "^%s^,^%s^,^%s^,^%s^,^%s^,%i,%i,%i,^%s^,%i);"
+                 "^%s^,^%s^,^%s^,^%s^," EPGZ("^%s^") ",^%s^,%i," EPGZ("^%s^") ",^%s^,"\
+                 EPGZ("^%s^") ",^%s^,^%s^,^%s^,^%s^,%i,%i,%i,^%s^,%i,^%s^,^%s^,0);"
                  ,
-                 Source,ChannelID,eventid,starttime,duration,title,
+                 cEPGDatabase::Day(starttime),Source,XMLTVID,eventid,starttime,duration,title,
                  alttitle ? alttitle : "NULL",
                  origtitle ? origtitle : "NULL",
                  shorttext ? shorttext : "NULL",
@@ -497,7 +515,8 @@ void cXMLTVEvent::GetSQL(const char *Source, int SrcIdx, const char *ChannelID,
                  year,
                  cr,ca,re,ra,sr,vi,
                  audio ? audio : "NULL",
-                 season, episode, episodeoverall, pi, SrcIdx
+                 season, episode, episodeoverall, pi, SrcIdx,
+                 key, sndx
                 )==-1)
     {
         sql_insert=NULL;
@@ -505,13 +524,15 @@ void cXMLTVEvent::GetSQL(const char *Source, int SrcIdx, const char *ChannelID,
     }
 
     if (asprintf(&sql_update,
-                 "UPDATE epg SET duration=%i,starttime=%li,title=^%s^,alttitle=^%s^,origtitle=^%s^,"\
-                 "shorttext=^%s^,description=^%s^,country=^%s^,year=%i,credits=^%s^,category=^%s^,"\
-                 "review=^%s^,rating=^%s^,starrating=^%s^,video=^%s^,audio=^%s^,season=%i,episode=%i, "\
-                 "episodeoverall=%i,pics=^%s^,srcidx=%i " \
-                 " where src=^%s^ and channelid=^%s^ and eventid=%u"
+                 "UPDATE epgevents_%i SET duration=%i,starttime=%li,title=^%s^,alttitle=^%s^,origtitle=^%s^,"\
+                 "shorttext=^%s^,description=" EPGZ("^%s^") ",country=^%s^,year=%i,"\
+                 "credits=" EPGZ("^%s^") ",category=^%s^,review=" EPGZ("^%s^") ",rating=^%s^,starrating=^%s^,video=^%s^,audio=^%s^,season=%i,episode=%i, "\
+                 "episodeoverall=%i,pics=^%s^,srcidx=%i,titlekey=^%s^,soundex=^%s^," \
+                 "epcheck=CASE WHEN title IS ^%s^ AND shorttext IS ^%s^ AND alttitle IS ^%s^ AND season=%i " \
+                 "AND episode=%i THEN epcheck ELSE 0 END" \
+                 " where src=^%s^ and xmltvid=^%s^ and eventid=%u"
                  ,
-                 duration,starttime,title,
+                 cEPGDatabase::Day(starttime),duration,starttime,title,
                  alttitle ? alttitle : "NULL",
                  origtitle ? origtitle : "NULL",
                  shorttext ? shorttext : "NULL",
@@ -521,7 +542,12 @@ void cXMLTVEvent::GetSQL(const char *Source, int SrcIdx, const char *ChannelID,
                  cr,ca,re,ra,sr,vi,
                  audio ? audio : "NULL",
                  season, episode, episodeoverall, pi, SrcIdx,
-                 Source,ChannelID,eventid
+                 key, sndx,
+                 title,
+                 shorttext ? shorttext : "NULL",
+                 alttitle ? alttitle : "NULL",
+                 season, episode,
+                 Source,XMLTVID,eventid
                 )==-1)
     {
         sql_update=NULL;
@@ -553,8 +579,89 @@ void cXMLTVEvent::GetSQL(const char *Source, int SrcIdx, const char *ChannelID,
     *Update=sql_update;
 }
 
+void cXMLTVEvent::SetPacked(int Field, const void *Data, int Size, cEPGCompression *Codec)
+{
+    if ((Field<0) || (Field>=XMLTVPACK_COUNT)) return;
+    switch (Field)
+    {
+    case XMLTVPACK_DESCRIPTION:
+        SetDescription(NULL);
+        break;
+    case XMLTVPACK_EITDESCRIPTION:
+        SetEITDescription(NULL);
+        break;
+    case XMLTVPACK_CREDITS:
+        DropPacked(Field);
+        credits.Clear();
+        break;
+    case XMLTVPACK_REVIEW:
+        DropPacked(Field);
+        review.Clear();
+        break;
+    }
+    if (!Data || (Size<=0)) return;
+    packed[Field]=malloc(Size);
+    if (!packed[Field]) return;
+    memcpy(packed[Field],Data,Size);
+    packedsize[Field]=Size;
+    codec=Codec;
+}
+
+void cXMLTVEvent::CopyEITDescription(cXMLTVEvent *From)
+{
+    // a packed text is copied without decoding it
+    if (From->packed[XMLTVPACK_EITDESCRIPTION])
+        SetPacked(XMLTVPACK_EITDESCRIPTION,From->packed[XMLTVPACK_EITDESCRIPTION],
+                  From->packedsize[XMLTVPACK_EITDESCRIPTION],From->codec);
+    else
+        SetEITDescription(From->eitdescription);
+}
+
+void cXMLTVEvent::DropPacked(int Field)
+{
+    free(packed[Field]);
+    packed[Field]=NULL;
+    packedsize[Field]=0;
+}
+
+void cXMLTVEvent::Unpack(int Field)
+{
+    void *data=packed[Field];
+    int size=packedsize[Field];
+    packed[Field]=NULL;
+    packedsize[Field]=0;
+    char *text=NULL;
+    if (codec)
+        text=codec->Decompress(data,size);
+    else
+        esyslog("compression: cannot decode text, no codec");
+    free(data);
+    if (!text) return;
+    switch (Field)
+    {
+    case XMLTVPACK_DESCRIPTION:
+        free(description);
+        description=text;
+        return;
+    case XMLTVPACK_EITDESCRIPTION:
+        free(eitdescription);
+        eitdescription=text;
+        return;
+    case XMLTVPACK_CREDITS:
+        SetCredits(text);
+        break;
+    case XMLTVPACK_REVIEW:
+        SetReview(text);
+        break;
+    }
+    free(text);
+}
+
 void cXMLTVEvent::Clear()
 {
+    for (int i=0; i<XMLTVPACK_COUNT; i++)
+        DropPacked(i);
+    codec=NULL;
     if (source)
     {
         free(source);
@@ -633,6 +740,52 @@ void cXMLTVEvent::Clear()
     weakid=false;
 }
 
+void cXMLTVEvent::CopyList(cXMLTVStringList *Dest, cXMLTVStringList *From)
+{
+    for (int i=0; i<From->Size(); i++)
+    {
+        char *val=strdup(From->At(i));
+        if (val) Dest->Append(val);
+    }
+}
+
+void cXMLTVEvent::CopyFrom(cXMLTVEvent *From)
+{
+    Clear();
+    if (!From) return;
+    if (From->source) source=strdup(From->source);
+    if (From->channelid) channelid=strdup(From->channelid);
+    if (From->title) title=strdup(From->title);
+    if (From->alttitle) alttitle=strdup(From->alttitle);
+    if (From->shorttext) shorttext=strdup(From->shorttext);
+    if (From->description) description=strdup(From->description);
+    if (From->eitdescription) eitdescription=strdup(From->eitdescription);
+    for (int i=0; i<XMLTVPACK_COUNT; i++)
+    {
+        if (From->packed[i]) SetPacked(i,From->packed[i],From->packedsize[i],From->codec);
+    }
+    if (From->country) country=strdup(From->country);
+    if (From->origtitle) origtitle=strdup(From->origtitle);
+    if (From->audio) audio=strdup(From->audio);
+    year=From->year;
+    starttime=From->starttime;
+    duration=From->duration;
+    eventid=From->eventid;
+    eiteventid=From->eiteventid;
+    CopyList(&video,&From->video);
+    CopyList(&credits,&From->credits);
+    CopyList(&category,&From->category);
+    CopyList(&review,&From->review);
+    CopyList(&rating,&From->rating);
+    CopyList(&starrating,&From->starrating);
+    CopyList(&pics,&From->pics);
+    season=From->season;
+    episode=From->episode;
+    episodeoverall=From->episodeoverall;
+    parentalRating=From->parentalRating;
+    weakid=From->weakid;
+}
+
 cXMLTVEvent::cXMLTVEvent()
 {
     sql_insert=NULL;
@@ -646,6 +799,11 @@ cXMLTVEvent::cXMLTVEvent()
     country=NULL;
     origtitle=NULL;
     audio=NULL;
+    for (int i=0; i<XMLTVPACK_COUNT; i++)
+    {
+        packed[i]=NULL;
+        packedsize[i]=0;
+    }
     Clear();
 }
 
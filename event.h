@@ -11,6 +11,18 @@
 #include <time.h>
 #include <vdr/epg.h>
 
+// columns which may be stored compressed, decoded on first access
+enum
+{
+    XMLTVPACK_DESCRIPTION=0,
+    XMLTVPACK_EITDESCRIPTION,
+    XMLTVPACK_CREDITS,
+    XMLTVPACK_REVIEW,
+    XMLTVPACK_COUNT
+};
+
+class cEPGCompression;
+
 class cXMLTVStringList : public cVector<char *>
 {
 private:
@@ -61,11 +73,18 @@ private:
     cXMLTVStringList starrating;
     cXMLTVStringList pics;
     int parentalRating;
+    void *packed[XMLTVPACK_COUNT];
+    int packedsize[XMLTVPACK_COUNT];
+    cEPGCompression *codec;
+    void DropPacked(int Field);
+    void Unpack(int Field);
     char *removechar(char *s, char what);
+    void CopyList(cXMLTVStringList *Dest, cXMLTVStringList *From);
 public:
     cXMLTVEvent();
     ~cXMLTVEvent();
     void Clear();
+    void CopyFrom(cXMLTVEvent *From);
     void SetSource(const char *Source);
     void SetChannelID(const char *ChannelID);
     void SetTitle(const char *Title);
@@ -91,14 +110,17 @@ public:
     void SetStarRating(const char *StarRating);
     void SetVideo(const char *Video);
     void SetPics(const char *Pics);
+    void SetPacked(int Field, const void *Data, int Size, cEPGCompression *Codec);
+    void CopyEITDescription(cXMLTVEvent *From);
     void CreateEventID(time_t StartTime);
-    void GetSQL(const char *Source, int SrcIdx, const char *ChannelID, char **Insert, char **Update);
+    void GetSQL(const char *Source, int SrcIdx, const char *XMLTVID, char **Insert, char **Update);
     bool WeakID()
     {
         return weakid;
     }
     cXMLTVStringList *Credits()
     {
+        if (packed[XMLTVPACK_CREDITS]) Unpack(XMLTVPACK_CREDITS);
         return &credits;
     }
     cXMLTVStringList *Category()
@@ -107,6 +129,7 @@ public:
     }
     cXMLTVStringList *Review()
     {
+        if (packed[XMLTVPACK_REVIEW]) Unpack(XMLTVPACK_REVIEW);
         return &review;
     }
     cXMLTVStringList *Rating()
@@ -195,10 +218,12 @@ public:
     }
     const char *Description(void) const
     {
+        if (packed[XMLTVPACK_DESCRIPTION]) const_cast<cXMLTVEvent *>(this)->Unpack(XMLTVPACK_DESCRIPTION);
         return description;
     }
     const char *EITDescription(void) const
     {
+        if (packed[XMLTVPACK_EITDESCRIPTION]) const_cast<cXMLTVEvent *>(this)->Unpack(XMLTVPACK_EITDESCRIPTION);
         return eitdescription;
     }
     const char *Country(void) const
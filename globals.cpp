@@ -0,0 +1,547 @@
+/*
+ * globals.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <vdr/videodir.h>
+#include <unistd.h>
+#include <stdarg.h>
+#include <locale.h>
+#include <langinfo.h>
+#include <time.h>
+#include <pwd.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <libgen.h>
+#include <sys/syscall.h>
+#include <sys/vfs.h>
+#include <sys/stat.h>
+
+#include "xmltv2vdr.h"
+#include "debug.h"
+
+int ioprio_set(int which, int who, int ioprio)
+{
+#if defined(__i386__)
+#define __NR_ioprio_set  289
+#elif defined(__ppc__)
+#define __NR_ioprio_set  273
+#elif defined(__x86_64__)
+#define __NR_ioprio_set  251
+#elif defined(__ia64__)
+#define __NR_ioprio_set  1274
+#else
+#define __NR_ioprio_set  0
+#endif
+    if (__NR_ioprio_set)
+    {
+        return syscall(__NR_ioprio_set, which, who, ioprio);
+    }
+    else
+    {
+        return 0; // just do nothing
+    }
+}
+
+char *strcatrealloc(char *dest, const char *src)
+{
+    if (!src || !*src)
+        return dest;
+
+    size_t l = (dest ? strlen(dest) : 0) + strlen(src) + 1;
+    if (dest)
+    {
+        dest = (char *)realloc(dest, l);
+        strcat(dest, src);
+    }
+    else
+    {
+        dest = (char*)malloc(l);
+        strcpy(dest, src);
+    }
+    return dest;
+}
+
+char *logfile=NULL;
+
+void logger(cEPGSource *source, char logtype, const char* format, ...)
+{
+    va_list ap;
+    char fmt[255];
+    if (source && logtype!='T')
+    {
+        if (logtype=='E')
+        {
+            if (snprintf(fmt,sizeof(fmt),"xmltv2vdr: '%s' ERROR %s",source->Name(),format)==-1) return;
+        }
+        else
+        {
+            if (snprintf(fmt,sizeof(fmt),"xmltv2vdr: '%s' %s",source->Name(),format)==-1) return;
+        }
+    }
+    else
+    {
+        if (logtype=='E')
+        {
+            snprintf(fmt,sizeof(fmt),"xmltv2vdr: ERROR %s",format);
+        }
+        else
+        {
+            snprintf(fmt,sizeof(fmt),"xmltv2vdr: %s",format);
+        }
+    }
+
+    va_start(ap, format);
+    char *ptr;
+    if (vasprintf(&ptr,fmt,ap)==-1) return;
+    va_end(ap);
+
+    struct tm tm;
+    if (logfile || source)
+    {
+        time_t now=time(NULL);
+        localtime_r(&now,&tm);
+    }
+
+    char *crlf=strchr(ptr,'\n');
+    if (crlf) *crlf=0;
+    crlf=strchr(ptr,'\r');
+    if (crlf) *crlf=0;
+
+    if (source && logtype!='T')
+    {
+        source->Add2Log(&tm,logtype,ptr);
+    }
+
+    if (logfile)
+    {
+        char dt[30];
+        strftime(dt,sizeof(dt)-1,"%b %d %H:%M:%S",&tm);
+
+        FILE *l=fopen(logfile,"a+");
+        if (l)
+        {
+            fprintf(l,"%s [%i] %s\n",dt,cThread::ThreadId(),ptr);
+            fclose(l);
+        }
+    }
+    switch (logtype)
+    {
+    case 'E':
+        if (SysLogLevel>0) syslog_with_tid(LOG_ERR,"%s",ptr);
+        break;
+    case 'I':
+        if (SysLogLevel>1) syslog_with_tid(LOG_ERR,"%s",ptr);
+        break;
+    case 'D':
+        if (SysLogLevel>2) syslog_with_tid(LOG_ERR,"%s",ptr);
+        break;
+    default:
+        break;
+    }
+
+    free(ptr);
+}
+
+// -------------------------------------------------------------
+
+bool cSVDRPMsg::readreply(int fd)
+{
+    usleep(400000);
+    char c=' ';
+    do
+    {
+        struct pollfd fds;
+        fds.fd=fd;
+        fds.events=POLLIN;
+        fds.revents=0;
+        int ret=poll(&fds,1,600);
+
+        if (ret<=0) return false;
+        if (fds.revents!=POLLIN) return false;
+        if (read(fd,&c,1)<0) return false;
+    }
+    while (c!='\n');
+    return true;
+}
+
+bool cSVDRPMsg::Send(const char *format, ...)
+{
+    char *msg;
+    va_list ap;
+    va_start(ap, format);
+    if (vasprintf(&msg,format,ap)==-1) return false;
+    va_end(ap);
+
+    int port;
+    struct servent *serv=getservbyname("svdrp","tcp");
+    if (serv)
+    {
+        port=htons(serv->s_port);
+    }
+    else
+    {
+#if VDRVERSNUM < 10715
+        port=2001;
+#else
+        port=6419;
+#endif
+    }
+
+    struct sockaddr_in name;
+    name.sin_family = AF_INET;
+    name.sin_port = htons(port);
+    name.sin_addr.s_addr=inet_addr("127.0.0.1");
+    uint size = sizeof(name);
+
+    int sock;
+    sock=socket(PF_INET, SOCK_STREAM, 0);
+    if (sock<0) return false;
+
+    if (connect(sock, (struct sockaddr *)&name,size)!=0)
+    {
+        close(sock);
+        free(msg);
+        return false;
+    }
+
+    if (!readreply(sock))
+    {
+        close(sock);
+        free(msg);
+        return false;
+    }
+
+    ssize_t ret;
+    ret=write(sock,"PLUG epgsearch ",15);
+    if (ret!=(ssize_t)-1) ret=write(sock,msg,strlen(msg));
+    if (ret!=(ssize_t)-1) ret=write(sock,"\r\n",2);
+
+    if (!readreply(sock) || (ret==(ssize_t)-1))
+    {
+        close(sock);
+        free(msg);
+        return false;
+    }
+
+    ret=write(sock,"QUIT\r\n",6);
+
+    if (ret!=(ssize_t)-1) readreply(sock);
+    close(sock);
+    free(msg);
+    return true;
+}
+
+// -------------------------------------------------------------
+
+cEPGSearch_Client::cEPGSearch_Client()
+{
+    plugin=cPluginManager::GetPlugin("epgsearch");
+}
+
+bool cEPGSearch_Client::EnableSearchTimer()
+{
+    if (!plugin) return false;
+    Epgsearch_enablesearchtimers_v1_0 serviceData;
+    serviceData.enable = true;
+    if (!plugin->Service("Epgsearch-enablesearchtimers-v1.0", (void*) &serviceData))
+    {
+        // SVDRP fallback
+        cSVDRPMsg msg;
+        if (!msg.Send("SETS ON")) return false;
+    }
+    return true;
+}
+
+bool cEPGSearch_Client::DisableSearchTimer()
+{
+    if (!plugin) return false;
+    Epgsearch_enablesearchtimers_v1_0 serviceData;
+    serviceData.enable = false;
+    if (!plugin->Service("Epgsearch-enablesearchtimers-v1.0", (void*) &serviceData))
+    {
+        // SVDRP fallback
+        cSVDRPMsg msg;
+        if (!msg.Send("SETS OFF")) return false;
+    }
+    return true;
+}
+
+// -------------------------------------------------------------
+
+unsigned int cEPGTimer::Signature(const cEvent *Event)
+{
+    // FNV-1a over version and text, changes whenever the event needs processing
+    unsigned int hash=2166136261U;
+    hash^=Event->Version();
+    hash*=16777619U;
+    const char *text[3]={Event->Title(),Event->ShortText(),Event->Description()};
+    for (int i=0; i<3; i++)
+    {
+        for (const char *p=text[i]; p && *p; p++)
+        {
+            hash^=(unsigned char) *p;
+            hash*=16777619U;
+        }
+        hash^=0xff;
+        hash*=16777619U;
+    }
+    return hash;
+}
+
+// -------------------------------------------------------------
+
+cGlobals::cGlobals(): xmltvcache(this), epgdatabase(this), epgcompression(this), epgbackup(this),
+    epgwriter(this)
+{
+    confdir=NULL;
+    epgfile_store=NULL;
+    epgfiledir=NULL;
+    epgfile=NULL;
+    epdir=NULL;
+    epcodeset=NULL;
+    imgdir=NULL;
+    codeset=NULL;
+    srcorder=NULL;
+    wakeup=false;
+    compress=false;
+    epghandler=NULL;
+    epgtimer=NULL;
+    epgseasonepisode=NULL;
+    epall=0;
+    order=strdup(GetDefaultOrder());
+    imgdelafter=30;
+    soundex=true; // computed in process, see cImport::SoundEx
+    dbexists=false;
+    dbgeneration=0;
+    dbreplaced=0;
+    setupgeneration=0;
+
+#if APIVERSNUM > 20101
+    if (asprintf(&epgfile_store,"%s/epg.db",cVideoDirectory::Name())==-1) {};
+#else
+    if (asprintf(&epgfile_store,"%s/epg.db",VideoDirectory)==-1) {};
+#endif
+
+    if (!CheckEPGDir("/var/run/vdr"))
+    {
+        if (!CheckEPGDir("/tmp"))
+        {
+            if (!CheckEPGDir("/dev/shm"))
+            {
+                epgfiledir=NULL;
+                epgfile=strdup(epgfile_store);
+            }
+            else
+            {
+                epgfiledir=strdup("/dev/shm");
+            }
+        }
+        else
+        {
+            epgfiledir=strdup("/tmp");
+        }
+    }
+    else
+    {
+        epgfiledir=strdup("/var/run/vdr");
+    }
+
+    if (epgfiledir)
+    {
+        if (asprintf(&epgfile,"%s/epg.db",epgfiledir)==-1) {};
+    }
+
+    if (asprintf(&imgdir,"%s","/var/cache/vdr/epgimages")==-1) {};
+    if (access(imgdir,R_OK|W_OK)==-1)
+    {
+        free(imgdir);
+        imgdir=NULL;
+    }
+
+    if (setlocale(LC_CTYPE,""))
+        codeset=strdup(nl_langinfo(CODESET));
+    else
+    {
+        char *LangEnv=getenv("LANG");
+        if (LangEnv)
+        {
+            char *codeset_p=strchr(LangEnv,'.');
+            if (codeset_p)
+            {
+                codeset_p++; // skip dot
+                codeset=strdup(codeset_p);
+            }
+        }
+    }
+    if (!codeset)
+    {
+        codeset=strdup("ASCII//TRANSLIT");
+    }
+
+    struct passwd pwd,*pwdbuf;
+    char buf[1024];
+    getpwuid_r(getuid(),&pwd,buf,sizeof(buf),&pwdbuf);
+    if (pwdbuf)
+    {
+        if (asprintf(&epdir,"%s/.eplists/lists",pwdbuf->pw_dir)!=-1)
+        {
+            if (access(epdir,R_OK))
+            {
+                free(epdir);
+                epdir=NULL;
+            }
+            else
+            {
+                epcodeset=codeset;
+            }
+        }
+    }
+}
+
+cGlobals::~cGlobals()
+{
+    free(confdir);
+    free(epgfile);
+    free(epgfile_store);
+    free(epgfiledir);
+    free(epdir);
+    free(imgdir);
+    free(codeset);
+    free(order);
+    free(srcorder);
+    if (epgtimer)
+    {
+        epgtimer->Stop();
+        delete epgtimer;
+    }
+    if (epgseasonepisode)
+    {
+        epgseasonepisode->Stop();
+        delete epgseasonepisode;
+    }
+    epgsources.Remove();
+    epgmappings.Remove();
+    textmappings.Remove();
+}
+
+bool cGlobals::CheckEPGDir(const char* EPGFileDir)
+{
+    struct statfs statfsbuf;
+    if (statfs(EPGFileDir,&statfsbuf)==-1) return false;
+    if ((statfsbuf.f_type!=0x01021994) && (statfsbuf.f_type!=0x28cd3d45)) return false;
+    if (access(EPGFileDir,R_OK|W_OK)==-1) return false;
+    return true;
+}
+
+void cGlobals::SetEPGFile(const char *EPGFile)
+{
+    free(epgfile_store);
+    free(epgfile);
+    epgfile_store=strdup(EPGFile);
+    if (!epgfile_store)
+    {
+        epgfile=NULL;
+        return;
+    }
+
+    char *tm2=strdup(epgfile_store);
+    if (!tm2)
+    {
+        free(epgfile_store);
+        epgfile_store=NULL;
+        epgfile=NULL;
+        return;
+    }
+    char *dn=dirname(tm2);
+    bool usestore=CheckEPGDir(dn);
+    free(tm2);
+
+    if ((usestore) || (!epgfiledir))
+    {
+        epgfile=strdup(epgfile_store);
+    }
+    else
+    {
+        char *tmp=strdup(epgfile_store);
+        if (!tmp)
+        {
+            free(epgfile_store);
+            epgfile_store=NULL;
+            epgfile=NULL;
+            return;
+        }
+        char *bn=basename(tmp);
+        if (asprintf(&epgfile,"%s/%s",epgfiledir,bn)==-1)
+        {
+            free(epgfile_store);
+            free(tmp);
+            epgfile_store=NULL;
+            epgfile=NULL;
+            return;
+        }
+        free(tmp);
+    }
+}
+
+
+char *cGlobals::GetDefaultOrder()
+{
+    return (char *) "LOT,CRS,CAD,ORT,CAT,VID,AUD,SEE,RAT,STR,REV";
+}
+
+void cGlobals::SetImgDir(const char* ImgDir)
+{
+    if (!ImgDir) return;
+    if (access(ImgDir,R_OK|W_OK)==-1)
+    {
+        esyslog("cannot access %s",ImgDir);
+        return;
+    }
+    free(imgdir);
+    imgdir=strdup(ImgDir);
+}
+
+
+void cGlobals::SetEPDir(const char* EPDir)
+{
+    if (!EPDir) return;
+    if (access(EPDir,R_OK)==-1)
+    {
+        esyslog("cannot access %s",EPDir);
+        return;
+    }
+    free(epdir);
+    epcodeset=codeset;
+    epdir=strdup(EPDir);
+    if (!epdir) return;
+    epcodeset=strchr((char *) epdir,',');
+    if (epcodeset)
+    {
+        *epcodeset=0;
+    }
+    else
+    {
+        epcodeset=(char *) codeset;
+    }
+}
+
+void cGlobals::DBChanged(bool Replaced)
+{
+    // called whenever the database is changed, created, replaced or removed
+    bool existed=dbexists;
+    struct stat statbuf;
+    if (!epgfile)
+    {
+        dbexists=true; // is this safe?
+    }
+    else
+    {
+        dbexists=((stat(epgfile,&statbuf)!=-1) && (statbuf.st_size));
+    }
+    dbgeneration++;
+    // the file is another one than before, other than a parse run into the same file
+    if (Replaced || (!existed && dbexists)) dbreplaced++;
+}
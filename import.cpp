@@ -10,7 +10,10 @@
 #include <time.h>
 #include <pcrecpp.h>
 #include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
 #include <sys/types.h>
+#include <sys/stat.h>
 #include <vdr/channels.h>
 
 #include "xmltv2vdr.h"
@@ -304,119 +307,179 @@ bool cImport::WasChanged(cEvent* Event)
     return true;
 }
 
-void cImport::LinkPictures(const char *Source, cXMLTVStringList *Pics, tEventID DestID, tChannelID ChanID, bool MakeOld)
+static bool SameLink(int DirFd, const char *Link, const char *Target)
 {
-    // source-pics are located in /var/lib/epgsources/%SOURCE%-img/
-    // dest-pics are located in imgdir (default /var/cache/vdr/epgimages)
+    // the link in imgdir still exists and points to Target
+    struct stat statbuf;
+    if (fstatat(DirFd,Link,&statbuf,AT_SYMLINK_NOFOLLOW)==-1) return false;
+    if (!S_ISLNK(statbuf.st_mode)) return false;
+    size_t len=strlen(Target);
+    if ((size_t) statbuf.st_size!=len) return false;
+    char *buf=(char *) malloc(len+1);
+    if (!buf) return false;
+    ssize_t ret=readlinkat(DirFd,Link,buf,len+1);
+    bool same=((ret==(ssize_t) len) && !memcmp(buf,Target,len));
+    free(buf);
+    return same;
+}
 
-    for (int i=0; i<Pics->Size(); i++)
+bool cImport::LinkPicture(sqlite3 *Db, const char *Link, const char *Target, const char *ChanID, tEventID DestID)
+{
+    if (Db)
     {
-        char *pic=(*Pics)[i];
-
-        char *ext=strrchr(pic,'.');
-        if (!ext) continue;
-
-        ext++;
-        char *dst,*dstold=NULL;
-        int ret;
-
-        char *src;
-        if (asprintf(&src,"/var/lib/epgsources/%s-img/%s",Source,pic)==-1) return;
-
-        if (MakeOld)
+        // already linked to the same target -> nothing to do
+        sqlite3_stmt *stmt=Statement(Db,STMT_PICLINK_GET);
+        if (stmt)
         {
-            if (!i)
+            sqlite3_bind_text(stmt,1,Link,-1,SQLITE_STATIC);
+            bool recorded=false,same=false;
+            if (sqlite3_step(stmt)==SQLITE_ROW)
             {
-                ret=asprintf(&dstold,"%s/%i.%s",g->ImgDir(),DestID,ext);
+                const char *target=(const char *) sqlite3_column_text(stmt,0);
+                recorded=true;
+                if (target && !strcmp(target,Target)) same=SameLink(imgdirfd,Link,Target);
             }
-            else
+            sqlite3_reset(stmt);
+            if (same)
             {
-                ret=asprintf(&dstold,"%s/%i_%i.%s",g->ImgDir(),DestID,i,ext);
+                pickept++;
+                return true;
             }
-            if (ret==-1)
+            if (recorded)
             {
-                free(src);
-                return;
+                // the recorded link is stale (other target, removed or changed), forget it
+                stmt=Statement(Db,STMT_PICLINK_DEL);
+                if (stmt)
+                {
+                    sqlite3_bind_text(stmt,1,Link,-1,SQLITE_STATIC);
+                    Step(stmt);
+                    sqlite3_reset(stmt);
+                }
             }
         }
+    }
 
-        if (!i)
-        {
-            ret=asprintf(&dst,"%s/%s_%i.%s",g->ImgDir(),*ChanID.ToString(),DestID,ext);
-        }
-        else
+    if ((unlinkat(imgdirfd,Link,0)==-1) && (errno!=ENOENT))
+    {
+        tsyslog("failed to unlink %s",Link);
+    }
+    if (symlinkat(Target,imgdirfd,Link)==-1)
+    {
+        tsyslog("failed to link %s to %s",Target,Link);
+        return false;
+    }
+    tsyslog("linked %s to %s",Target,Link);
+    piccreated++;
+
+    if (Db)
+    {
+        sqlite3_stmt *stmt=Statement(Db,STMT_PICLINK_SET);
+        if (stmt)
         {
-            ret=asprintf(&dst,"%s/%s_%i_%i.%s",g->ImgDir(),*ChanID.ToString(),DestID,i,ext);
+            sqlite3_bind_text(stmt,1,Link,-1,SQLITE_STATIC);
+            sqlite3_bind_text(stmt,2,Target,-1,SQLITE_STATIC);
+            sqlite3_bind_text(stmt,3,ChanID,-1,SQLITE_STATIC);
+            sqlite3_bind_int(stmt,4,DestID);
+            Step(stmt);
+            sqlite3_reset(stmt);
         }
-        if (ret==-1)
+    }
+    return true;
+}
+
+void cImport::LinkPictures(cEPGSource *Source, sqlite3 *Db, cXMLTVEvent *xEvent, tEventID DestID,
+                           tChannelID ChanID, bool MakeOld)
+{
+    // source-pics are located in /var/lib/epgsources/%SOURCE%-img/
+    // dest-pics are located in imgdir (default /var/cache/vdr/epgimages)
+    // links are recorded in the piclinks table, so only changed links are touched
+
+    if (!xEvent) return;
+    if (!g->ImgDir()) return;
+    if (imgdirfd==-1)
+    {
+        imgdirfd=open(g->ImgDir(),O_RDONLY|O_DIRECTORY);
+        if (imgdirfd==-1)
         {
-            free(src);
-            if (dstold) free(dstold);
+            esyslog("cannot open %s",g->ImgDir());
             return;
         }
+    }
+    if (Db && Source && !Begin(Source,Db)) Db=NULL;
+
+    cXMLTVStringList *Pics=xEvent->Pics();
+    cString chanid=ChanID.ToString();
+    cStringList links;
+
+    for (int i=0; i<Pics->Size(); i++)
+    {
+        char *pic=(*Pics)[i];
+
+        char *ext=strrchr(pic,'.');
+        if (!ext) continue;
+        ext++;
+
+        char *src;
+        if (asprintf(&src,"/var/lib/epgsources/%s-img/%s",xEvent->Source(),pic)==-1) return;
 
-        struct stat statbuf;
         if (MakeOld)
         {
-            if (stat(dstold,&statbuf)!=-1)
-            {
-                unlink(dstold);
-            }
-            if (symlink(src,dstold)==-1)
+            cString dstold;
+            if (!i)
             {
-                if (!i)
-                {
-                    tsyslog("failed to link %s to %i.%s",pic,DestID,ext);
-                }
-                else
-                {
-                    tsyslog("failed to link %s to %i_%i.%s",pic,DestID,i,ext);
-                }
+                dstold=cString::sprintf("%i.%s",DestID,ext);
             }
             else
             {
-                if (!i)
-                {
-                    tsyslog("linked %s to %i.%s",pic,DestID,ext);
-                }
-                else
-                {
-                    tsyslog("linked %s to %i_%i.%s",pic,DestID,i,ext);
-                }
+                dstold=cString::sprintf("%i_%i.%s",DestID,i,ext);
             }
+            LinkPicture(Db,dstold,src,chanid,DestID);
+            links.Append(strdup(dstold));
         }
 
-        if (stat(dst,&statbuf)!=-1)
-        {
-            unlink(dst);
-        }
-        if (symlink(src,dst)==-1)
+        cString dst;
+        if (!i)
         {
-            if (!i)
-            {
-                tsyslog("failed to link %s to %s_%i.%s",pic,*ChanID.ToString(),DestID,ext);
-            }
-            else
-            {
-                tsyslog("failed to link %s to %s_%i_%i.%s",pic,*ChanID.ToString(),DestID,i,ext);
-            }
+            dst=cString::sprintf("%s_%i.%s",*chanid,DestID,ext);
         }
         else
         {
-            if (!i)
-            {
-                tsyslog("linked %s to %s_%i.%s",pic,*ChanID.ToString(),DestID,ext);
-            }
-            else
-            {
-                tsyslog("linked %s to %s_%i_%i.%s",pic,*ChanID.ToString(),DestID,i,ext);
-            }
+            dst=cString::sprintf("%s_%i_%i.%s",*chanid,DestID,i,ext);
         }
+        LinkPicture(Db,dst,src,chanid,DestID);
+        links.Append(strdup(dst));
 
         free(src);
-        free(dst);
-        if (dstold) free(dstold);
+    }
+
+    if (!Db) return;
+
+    // remove links of this event which are no longer needed
+    sqlite3_stmt *stmt=Statement(Db,STMT_PICLINK_LIST);
+    if (!stmt) return;
+    sqlite3_bind_text(stmt,1,chanid,-1,SQLITE_STATIC);
+    sqlite3_bind_int(stmt,2,DestID);
+    cStringList stale;
+    while (sqlite3_step(stmt)==SQLITE_ROW)
+    {
+        const char *link=(const char *) sqlite3_column_text(stmt,0);
+        if (link && (links.Find(link)==-1)) stale.Append(strdup(link));
+    }
+    sqlite3_reset(stmt);
 
+    if (!stale.Size()) return;
+    stmt=Statement(Db,STMT_PICLINK_DEL);
+    if (!stmt) return;
+    for (int i=0; i<stale.Size(); i++)
+    {
+        if ((unlinkat(imgdirfd,stale[i],0)!=-1) || (errno==ENOENT))
+        {
+            tsyslog("removed link %s",stale[i]);
+            sqlite3_bind_text(stmt,1,stale[i],-1,SQLITE_STATIC);
+            Step(stmt);
+            sqlite3_reset(stmt);
+            picremoved++;
+        }
     }
 }
 
@@ -878,7 +941,7 @@ bool cImport::PutEvent(cEPGSource *Source, sqlite3 *Db, cSchedule* Schedule,
         if (xEvent->Pics()->Size() && Source->UsePics())
         {
             /* here's a good place to link pictures! */
-            LinkPictures(xEvent->Source(),xEvent->Pics(),Event->EventID(),Event->ChannelID());
+            LinkPictures(Source,Db,xEvent,Event->EventID(),Event->ChannelID());
         }
         if (Source->Trace())
         {
@@ -967,7 +1030,7 @@ bool cImport::PutEvent(cEPGSource *Source, sqlite3 *Db, cSchedule* Schedule,
             if (!xEvent->EITEventID() && xEvent->Pics()->Size() && Source->UsePics())
             {
                 /* here's a good place to link pictures! */
-                LinkPictures(xEvent->Source(),xEvent->Pics(),Event->EventID(),Event->ChannelID());
+                LinkPictures(Source,Db,xEvent,Event->EventID(),Event->ChannelID());
             }
             UpdateXMLTVEvent(Source,Db,Event,xEvent,eitdescription);
         }
@@ -1119,7 +1182,7 @@ bool cImport::PutEvent(cEPGSource *Source, sqlite3 *Db, cSchedule* Schedule,
     return retcode;
 }
 
-bool cImport::FetchXMLTVEvent(sqlite3_stmt *stmt, cXMLTVEvent *xevent)
+bool cImport::FetchXMLTVEvent(sqlite3_stmt *stmt, cXMLTVEvent *xevent, cEPGCompression *Codec)
 {
     if (!stmt) return false;
     if (!xevent) return false;
@@ -1151,6 +1214,12 @@ bool cImport::FetchXMLTVEvent(sqlite3_stmt *stmt, cXMLTVEvent *xevent)
             xevent->SetShortText((const char *) sqlite3_column_text(stmt,col));
             break;
         case 7:
+            if (sqlite3_column_type(stmt,col)==SQLITE_BLOB)
+            {
+                xevent->SetPacked(XMLTVPACK_DESCRIPTION,sqlite3_column_blob(stmt,col),
+                                  sqlite3_column_bytes(stmt,col),Codec);
+                break;
+            }
             xevent->SetDescription((const char *) sqlite3_column_text(stmt,col));
             break;
         case 8:
@@ -1160,12 +1229,24 @@ bool cImport::FetchXMLTVEvent(sqlite3_stmt *stmt, cXMLTVEvent *xevent)
             xevent->SetYear(sqlite3_column_int(stmt,col));
             break;
         case 10:
+            if (sqlite3_column_type(stmt,col)==SQLITE_BLOB)
+            {
+                xevent->SetPacked(XMLTVPACK_CREDITS,sqlite3_column_blob(stmt,col),
+                                  sqlite3_column_bytes(stmt,col),Codec);
+                break;
+            }
             xevent->SetCredits((const char *) sqlite3_column_text(stmt,col));
             break;
         case 11:
             xevent->SetCategory((const char *) sqlite3_column_text(stmt,col));
             break;
         case 12:
+            if (sqlite3_column_type(stmt,col)==SQLITE_BLOB)
+            {
+                xevent->SetPacked(XMLTVPACK_REVIEW,sqlite3_column_blob(stmt,col),
+                                  sqlite3_column_bytes(stmt,col),Codec);
+                break;
+            }
             xevent->SetReview((const char *) sqlite3_column_text(stmt,col));
             break;
         case 13:
@@ -1199,6 +1280,12 @@ bool cImport::FetchXMLTVEvent(sqlite3_stmt *stmt, cXMLTVEvent *xevent)
             xevent->SetEITEventID(sqlite3_column_int(stmt,col));
             break;
         case 23:
+            if (sqlite3_column_type(stmt,col)==SQLITE_BLOB)
+            {
+                xevent->SetPacked(XMLTVPACK_EITDESCRIPTION,sqlite3_column_blob(stmt,col),
+                                  sqlite3_column_bytes(stmt,col),Codec);
+                break;
+            }
             xevent->SetEITDescription((const char *) sqlite3_column_text(stmt,col));
             break;
         case 24:
@@ -1209,25 +1296,115 @@ bool cImport::FetchXMLTVEvent(sqlite3_stmt *stmt, cXMLTVEvent *xevent)
     return true;
 }
 
-cXMLTVEvent *cImport::PrepareAndReturn(sqlite3 **db, char *sql)
+static const char *stmtsql[cImport::STMT_COUNT]=
+{
+    // STMT_SEARCH_EITID
+    "select " XMLTV_COLUMNS " from epg_%1$i where (starttime>=?1 and starttime<=?2) and eiteventid=?3 " \
+    "and channelid=?4 order by abs(starttime-?5),srcidx asc limit 1;",
+    // STMT_SEARCH_SOUNDEX
+    "select " XMLTV_COLUMNS " from epg_%1$i where (starttime>=?1 and starttime<=?2) and soundex=?3 " \
+    "and channelid=?4 order by abs(starttime-?5),srcidx asc limit 1;",
+    // STMT_SEARCH_TITLE
+    "select " XMLTV_COLUMNS " from epg_%1$i where (starttime>=?1 and starttime<=?2) and titlekey=?3 " \
+    "and channelid=?4 order by abs(starttime-?5),srcidx asc limit 1;",
+    // STMT_UPDATE_EITID
+    "update epglinks_%1$i set eiteventid=?1 where eventid=?2 and src=?3 and channelid=?4;",
+    // STMT_UPDATE_EITDESCRIPTION
+    "update epglinks_%1$i set eiteventid=?1, eitdescription=" EPGZ("?5") " where eventid=?2 and src=?3 " \
+    "and channelid=?4;",
+    // STMT_UPDATE_SEASON
+    "update epgevents_%1$i set season=?1, episode=?2, episodeoverall=?3, changeseq=(select seq from epgseq) " \
+    "where eventid=?4 and src=?5 and xmltvid in (select xmltvid from epglinks_%1$i where eventid=?4 " \
+    "and src=?5 and channelid=?6);",
+    // STMT_UPDATE_SEASON_SHORTTEXT
+    "update epgevents_%1$i set season=?1, episode=?2, episodeoverall=?3, shorttext=?7, " \
+    "changeseq=(select seq from epgseq) where eventid=?4 and src=?5 and xmltvid in (select xmltvid " \
+    "from epglinks_%1$i where eventid=?4 and src=?5 and channelid=?6);",
+    // STMT_INSERT
+    "INSERT OR FAIL INTO epgevents_%1$i (src,xmltvid,eventid,starttime,duration,title,alttitle,origtitle," \
+    "shorttext,description,country,year,credits,category,review,rating,starrating,video,audio,season,episode," \
+    "episodeoverall,pics,srcidx,titlekey,soundex) VALUES (?1,?2,?3,?4,?5,?6,?7,?8,?9," EPGZ("?10") ",?11,?12," \
+    EPGZ("?13") ",?14," EPGZ("?15") "," \
+    "?16,?17,?18,?19,?20,?21,?22,?23,?24,?25,?26);",
+    // STMT_UPDATE
+    "UPDATE epgevents_%1$i SET duration=?5,starttime=?4,title=?6,alttitle=?7,origtitle=?8,shorttext=?9," \
+    "description=" EPGZ("?10") ",country=?11,year=?12,credits=" EPGZ("?13") ",category=?14," \
+    "review=" EPGZ("?15") ",rating=?16,starrating=?17,video=?18,audio=?19," \
+    "season=?20,episode=?21,episodeoverall=?22,pics=?23,srcidx=?24,titlekey=?25,soundex=?26 " \
+    "where src=?1 and xmltvid=?2 and eventid=?3;",
+    // STMT_UPSERT
+    "INSERT INTO epgevents_%1$i (src,xmltvid,eventid,starttime,duration,title,alttitle,origtitle," \
+    "shorttext,description,country,year,credits,category,review,rating,starrating,video,audio,season,episode," \
+    "episodeoverall,pics,srcidx,titlekey,soundex) VALUES (?1,?2,?3,?4,?5,?6,?7,?8,?9," EPGZ("?10") ",?11,?12," \
+    EPGZ("?13") ",?14," EPGZ("?15") "," \
+    "?16,?17,?18,?19,?20,?21,?22,?23,?24,?25,?26) ON CONFLICT(eventid,src,xmltvid) DO UPDATE SET " \
+    "duration=excluded.duration,starttime=excluded.starttime,title=excluded.title,alttitle=excluded.alttitle," \
+    "origtitle=excluded.origtitle,shorttext=excluded.shorttext,description=excluded.description," \
+    "country=excluded.country,year=excluded.year,credits=excluded.credits,category=excluded.category," \
+    "review=excluded.review,rating=excluded.rating,starrating=excluded.starrating,video=excluded.video," \
+    "audio=excluded.audio,season=excluded.season,episode=excluded.episode," \
+    "episodeoverall=excluded.episodeoverall,pics=excluded.pics,srcidx=excluded.srcidx," \
+    "titlekey=excluded.titlekey,soundex=excluded.soundex;",
+    // STMT_INSERT_LINK
+    "INSERT OR IGNORE INTO epglinks_%1$i (src,xmltvid,eventid,channelid) VALUES (?1,?2,?3,?4);",
+    // STMT_FTS_INDEX
+    EPGDB_FTSINDEX "SELECT rowid,?4,?5,?6,?7,?8 FROM epgevents_%1$i WHERE eventid=?1 AND src=?2 AND xmltvid IN " \
+    "(SELECT xmltvid FROM epglinks_%1$i WHERE eventid=?1 AND src=?2 AND channelid=?3);",
+    // STMT_PICLINK_GET
+    "select target from piclinks where link=?1;",
+    // STMT_PICLINK_SET
+    "insert or replace into piclinks (link,target,channelid,eventid) values (?1,?2,?3,?4);",
+    // STMT_PICLINK_LIST
+    "select link from piclinks where channelid=?1 and eventid=?2;",
+    // STMT_PICLINK_DEL
+    "delete from piclinks where link=?1;"
+};
+
+sqlite3_stmt *cImport::Statement(sqlite3 *Db, int Which, int Day)
 {
-    if (!db) return NULL;
-    if (!*db) return NULL;
-    if (!sql) return NULL;
+    if (!Db) return NULL;
+    if ((Which<0) || (Which>=STMT_COUNT)) return NULL;
+    if (Db!=stmtdb)
+    {
+        FinalizeStatements();
+        stmtdb=Db;
+    }
+    int dropped=g->EPGDatabase()->Dropped();
+    if (dropped!=stmtdropped)
+    {
+        // statements of dropped partitions would fail
+        FinalizeStatements(dropped);
+        stmtdropped=dropped;
+    }
+    // statements on the xmltv data are prepared per day partition
+    std::pair<int,int> key(Which,Day);
+    std::map<std::pair<int,int>,sqlite3_stmt *>::iterator it=stmts.find(key);
+    if (it!=stmts.end())
+    {
+        if (!it->second) return NULL;
+        sqlite3_reset(it->second);
+        sqlite3_clear_bindings(it->second);
+        return it->second;
+    }
 
     sqlite3_stmt *stmt=NULL;
-    int ret=sqlite3_prepare_v2(*db,sql,strlen(sql),&stmt,NULL);
+    cString sql=(Day>=0) ? cString::sprintf(stmtsql[Which],Day) : cString(stmtsql[Which]);
+    int ret=sqlite3_prepare_v2(Db,sql,-1,&stmt,NULL);
     if (ret!=SQLITE_OK)
     {
-        const char *errmsg=sqlite3_errmsg(*db);
+        const char *errmsg=sqlite3_errmsg(Db);
         if (errmsg)
         {
-            if (strstr(errmsg,"no such column"))
+            if ((Day>=0) && strstr(errmsg,"no such table"))
+            {
+                // no xmltv data for this day, a missing full text index is
+                // not prepared again until the statements are finalized
+                if (Which==STMT_FTS_INDEX) stmts[key]=NULL;
+            }
+            else if (strstr(errmsg,"no such column"))
             {
                 esyslog("sqlite3: database schema changed, unlinking epg.db!");
-                sqlite3_close(*db);
-                *db=NULL;
-                unlink(g->EPGFile());
+                g->EPGDatabase()->Unlink();
             }
             else
             {
@@ -1238,22 +1415,108 @@ cXMLTVEvent *cImport::PrepareAndReturn(sqlite3 **db, char *sql)
                 else
                 {
                     esyslog("sqlite3: %i %s (par)",ret,errmsg);
-                    tsyslog("sqlite3: %s",sql);
+                    tsyslog("sqlite3: %s",*sql);
                 }
             }
         }
-        free(sql);
+        sqlite3_finalize(stmt);
         return NULL;
     }
+    stmts[key]=stmt;
+    return stmt;
+}
+
+void cImport::FinalizeStatements()
+{
+    std::map<std::pair<int,int>,sqlite3_stmt *>::iterator it;
+    for (it=stmts.begin(); it!=stmts.end(); ++it)
+        sqlite3_finalize(it->second);
+    stmts.clear();
+    stmtdb=NULL;
+}
+
+void cImport::FinalizeStatements(int Before)
+{
+    std::map<std::pair<int,int>,sqlite3_stmt *>::iterator it=stmts.begin();
+    while (it!=stmts.end())
+    {
+        if ((it->first.second>=0) && (it->first.second<Before))
+        {
+            sqlite3_finalize(it->second);
+            stmts.erase(it++);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+void cImport::BindText(sqlite3_stmt *stmt, int Index, const char *Value)
+{
+    if (!Value || !strcmp(Value,"NULL"))
+    {
+        sqlite3_bind_null(stmt,Index);
+    }
+    else
+    {
+        sqlite3_bind_text(stmt,Index,Value,-1,SQLITE_STATIC);
+    }
+}
+
+int cImport::Step(sqlite3_stmt *stmt)
+{
+    if (!writer) return sqlite3_step(stmt);
+    char *sql=sqlite3_expanded_sql(stmt);
+    if (!sql) return SQLITE_NOMEM;
+    // a full queue is an error, the writer logs the number of dropped changes
+    bool queued=writer->Queue(sql);
+    sqlite3_free(sql);
+    return queued ? SQLITE_DONE : SQLITE_FULL;
+}
+
+void cImport::IndexXMLTVEvent(sqlite3 *Db, const char *Source, const char *ChannelID, cXMLTVEvent *xEvent)
+{
+    // days without full text index have no statement
+    if (!cEPGDatabase::FullTextAvailable()) return;
+    sqlite3_stmt *stmt=Statement(Db,STMT_FTS_INDEX,cEPGDatabase::Day(xEvent->StartTime()));
+    if (!stmt) return;
+    sqlite3_bind_int64(stmt,1,xEvent->EventID());
+    BindText(stmt,2,Source);
+    BindText(stmt,3,ChannelID);
+    BindText(stmt,4,xEvent->Title());
+    BindText(stmt,5,xEvent->ShortText());
+    BindText(stmt,6,xEvent->Description());
+    BindText(stmt,7,xEvent->Credits()->toString());
+    BindText(stmt,8,xEvent->Category()->toString());
+    if (Step(stmt)!=SQLITE_DONE) tsyslog("sqlite3: %s (fulltext)",sqlite3_errmsg(Db));
+    sqlite3_reset(stmt);
+}
+
+cXMLTVEvent *cImport::StepAndReturn(sqlite3_stmt *stmt)
+{
+    if (!stmt) return NULL;
 
     cXMLTVEvent *xevent=NULL;
-    if (sqlite3_step(stmt)==SQLITE_ROW)
+    int ret=sqlite3_step(stmt);
+    stepfailed=((ret!=SQLITE_ROW) && (ret!=SQLITE_DONE));
+    if (ret==SQLITE_ROW)
     {
         xevent = new cXMLTVEvent();
-        FetchXMLTVEvent(stmt,xevent);
+        FetchXMLTVEvent(stmt,xevent,g->EPGCompression());
     }
-    sqlite3_finalize(stmt);
-    free(sql);
+    else if (ret!=SQLITE_DONE)
+    {
+        if ((ret==SQLITE_BUSY) || (ret==SQLITE_LOCKED))
+        {
+            tsyslog("sqlite3: %i %s (step)",ret,sqlite3_errmsg(sqlite3_db_handle(stmt)));
+        }
+        else
+        {
+            esyslog("sqlite3: %i %s (step)",ret,sqlite3_errmsg(sqlite3_db_handle(stmt)));
+        }
+    }
+    sqlite3_reset(stmt); // don't hold the read lock
     return xevent;
 }
 
@@ -1278,6 +1541,40 @@ bool cImport::AddShortTextFromEITDescription(cXMLTVEvent *xEvent, const char *EI
     return true;
 }
 
+void cImport::BindXMLTVEvent(sqlite3_stmt *stmt, const char *Source, int SrcIdx, const char *XMLTVID,
+                             cXMLTVEvent *xEvent)
+{
+    // same values as cXMLTVEvent::GetSQL, see STMT_INSERT/STMT_UPDATE
+    BindText(stmt,1,Source);
+    BindText(stmt,2,XMLTVID);
+    sqlite3_bind_int64(stmt,3,xEvent->EventID());
+    sqlite3_bind_int64(stmt,4,xEvent->StartTime());
+    sqlite3_bind_int(stmt,5,xEvent->Duration());
+    sqlite3_bind_text(stmt,6,xEvent->Title(),-1,SQLITE_STATIC);
+    BindText(stmt,7,xEvent->AltTitle());
+    BindText(stmt,8,xEvent->OrigTitle());
+    BindText(stmt,9,xEvent->ShortText());
+    BindText(stmt,10,xEvent->Description());
+    BindText(stmt,11,xEvent->Country());
+    sqlite3_bind_int(stmt,12,xEvent->Year());
+    BindText(stmt,13,xEvent->Credits()->toString());
+    BindText(stmt,14,xEvent->Category()->toString());
+    BindText(stmt,15,xEvent->Review()->toString());
+    BindText(stmt,16,xEvent->Rating()->toString());
+    BindText(stmt,17,xEvent->StarRating()->toString());
+    BindText(stmt,18,xEvent->Video()->toString());
+    BindText(stmt,19,xEvent->Audio());
+    sqlite3_bind_int(stmt,20,xEvent->Season());
+    sqlite3_bind_int(stmt,21,xEvent->Episode());
+    sqlite3_bind_int(stmt,22,xEvent->EpisodeOverall());
+    BindText(stmt,23,xEvent->Pics()->toString());
+    sqlite3_bind_int(stmt,24,SrcIdx);
+    char key[256],sndx[11];
+    TitleKey(xEvent->Title(),key,sizeof(key));
+    sqlite3_bind_text(stmt,25,key,-1,SQLITE_TRANSIENT);
+    if (SoundEx(sndx,(char *) xEvent->Title(),0,1)!=0) sqlite3_bind_text(stmt,26,sndx,-1,SQLITE_TRANSIENT);
+}
+
 cXMLTVEvent *cImport::AddXMLTVEvent(cEPGSource *Source,sqlite3 *Db, const char *ChannelID, const cEvent *Event,
                                     const char *EITDescription, bool UseEPText)
 {
@@ -1350,35 +1647,62 @@ cXMLTVEvent *cImport::AddXMLTVEvent(cEPGSource *Source,sqlite3 *Db, const char *
         return NULL;
     }
 
-    char *isql,*usql;
-    xevent->GetSQL(Source->Name(),99,ChannelID,&isql,&usql);
-    if (isql && usql)
+    // partitions are created by the parser and the housekeeping, without
+    // one for this day Statement() fails and the event is not added
+    int day=cEPGDatabase::Day(xevent->StartTime());
+    // the writer cannot report constraints back, it gets an upsert
+    bool inserted=!writer;
+    sqlite3_stmt *stmt=Statement(Db,writer ? STMT_UPSERT : STMT_INSERT,day);
+    if (!stmt)
     {
-        char *errmsg;
-        int ret=sqlite3_exec(Db,isql,NULL,NULL,&errmsg);
-        if (ret!=SQLITE_OK)
+        delete xevent;
+        return NULL;
+    }
+    BindXMLTVEvent(stmt,Source->Name(),99,ChannelID,xevent);
+    int ret=Step(stmt);
+    if (ret==SQLITE_CONSTRAINT)
+    {
+        inserted=false;
+        sqlite3_reset(stmt);
+        stmt=Statement(Db,STMT_UPDATE,day);
+        if (!stmt)
         {
-            if (ret==SQLITE_CONSTRAINT)
-            {
-                sqlite3_free(errmsg);
-                ret=sqlite3_exec(Db,usql,NULL,NULL,&errmsg);
-            }
-            if (ret!=SQLITE_OK)
-            {
-                esyslogs(Source,"sqlite3: %s",errmsg);
-                sqlite3_free(errmsg);
-                delete xevent;
-                return NULL;
-            }
+            delete xevent;
+            return NULL;
         }
-        /*
-        if (ret==SQLITE_OK)
+        BindXMLTVEvent(stmt,Source->Name(),99,ChannelID,xevent);
+        ret=Step(stmt);
+    }
+    if (ret==SQLITE_DONE)
+    {
+        // events from eit have no xmltv channel, the vdr channel is used instead
+        sqlite3_reset(stmt);
+        stmt=Statement(Db,STMT_INSERT_LINK,day);
+        if (!stmt)
         {
-            tsyslogs(Source,"{%5i} adding '%s'/'%s' to db",xevent->EventID(),
-                     xevent->Title(),xevent->ShortText());
+            delete xevent;
+            return NULL;
         }
-        */
+        BindText(stmt,1,Source->Name());
+        BindText(stmt,2,ChannelID);
+        sqlite3_bind_int64(stmt,3,xevent->EventID());
+        BindText(stmt,4,ChannelID);
+        ret=Step(stmt);
+    }
+    if (ret!=SQLITE_DONE)
+    {
+        esyslogs(Source,"sqlite3: %s",sqlite3_errmsg(Db));
+        sqlite3_reset(stmt);
+        delete xevent;
+        return NULL;
     }
+    sqlite3_reset(stmt);
+    IndexXMLTVEvent(Db,Source->Name(),ChannelID,xevent);
+    g->XMLTVCache()->Put(Source->Name(),ChannelID,xevent,99,inserted ? XMLTVCACHE_EIT_CLEAR : XMLTVCACHE_EIT_KEEP);
+    /*
+    tsyslogs(Source,"{%5i} adding '%s'/'%s' to db",xevent->EventID(),
+             xevent->Title(),xevent->ShortText());
+    */
     return xevent;
 }
 
@@ -1390,49 +1714,16 @@ bool cImport::UpdateXMLTVEvent(cEPGSource *Source, sqlite3 *Db, cXMLTVEvent *xEv
 
     if (!Begin(Source,Db)) return false;
 
-    char *sql=NULL;
-
-    if (xEvent->ShortText())
-    {
-        char *shortdesc=strdup(xEvent->ShortText());
-        if (!shortdesc)
-        {
-            esyslogs(Source,"out of memory");
-            return false;
-        }
-
-        string ed=shortdesc;
-
-        int reps;
-        reps=pcrecpp::RE("'").GlobalReplace("''",&ed);
-        if (reps)
-        {
-            shortdesc=(char *) realloc(shortdesc,ed.size()+1);
-            strcpy(shortdesc,ed.c_str());
-        }
-
-        if (asprintf(&sql,"update epg set season=%li, episode=%li, episodeoverall=%li, shorttext='%s' "
-                     " where eventid=%li and src='%s' and channelid='%s'", (long int) xEvent->Season(),
-                     (long int) xEvent->Episode(), (long int) xEvent->EpisodeOverall()   ,shortdesc,
-                     (long int) xEvent->EventID(),Source->Name(),xEvent->ChannelID())==-1)
-        {
-            free(shortdesc);
-            esyslogs(Source,"out of memory");
-            return false;
-        }
-        free(shortdesc);
-    }
-    else
-    {
-        if (asprintf(&sql,"update epg set season=%li, episode=%li, episodeoverall=%li "
-                     " where eventid=%li and src='%s' and channelid='%s'", (long int) xEvent->Season(),
-                     (long int) xEvent->Episode(), (long int) xEvent->EpisodeOverall(),
-                     (long int) xEvent->EventID(),Source->Name(),xEvent->ChannelID())==-1)
-        {
-            esyslogs(Source,"out of memory");
-            return false;
-        }
-    }
+    sqlite3_stmt *stmt=Statement(Db,xEvent->ShortText() ? STMT_UPDATE_SEASON_SHORTTEXT : STMT_UPDATE_SEASON,
+                                 cEPGDatabase::Day(xEvent->StartTime()));
+    if (!stmt) return false;
+    sqlite3_bind_int(stmt,1,xEvent->Season());
+    sqlite3_bind_int(stmt,2,xEvent->Episode());
+    sqlite3_bind_int(stmt,3,xEvent->EpisodeOverall());
+    sqlite3_bind_int64(stmt,4,xEvent->EventID());
+    sqlite3_bind_text(stmt,5,Source->Name(),-1,SQLITE_STATIC);
+    sqlite3_bind_text(stmt,6,xEvent->ChannelID(),-1,SQLITE_STATIC);
+    if (xEvent->ShortText()) sqlite3_bind_text(stmt,7,xEvent->ShortText(),-1,SQLITE_STATIC);
 
     if (Source->Trace())
     {
@@ -1464,16 +1755,15 @@ bool cImport::UpdateXMLTVEvent(cEPGSource *Source, sqlite3 *Db, cXMLTVEvent *xEv
         }
     }
 
-    char *errmsg;
-    if (sqlite3_exec(Db,sql,NULL,NULL,&errmsg)!=SQLITE_OK)
+    if (Step(stmt)!=SQLITE_DONE)
     {
-        esyslogs(Source,"%s -> %s",sql,errmsg);
-        free(sql);
-        sqlite3_free(errmsg);
+        esyslogs(Source,"sqlite3: update season -> %s",sqlite3_errmsg(Db));
+        sqlite3_reset(stmt);
         return false;
     }
-
-    free(sql);
+    sqlite3_reset(stmt);
+    if (xEvent->ShortText()) IndexXMLTVEvent(Db,Source->Name(),xEvent->ChannelID(),xEvent);
+    g->XMLTVCache()->Put(Source->Name(),xEvent->ChannelID(),xEvent,-1,XMLTVCACHE_EIT_KEEP);
     return true;
 }
 
@@ -1487,6 +1777,8 @@ bool cImport::UpdateXMLTVEvent(cEPGSource *Source, sqlite3 *Db, const cEvent *Ev
 
     // prevent unnecessary updates
     if (!Description && Event->EventID() && (xEvent->EITEventID()==Event->EventID())) return false;
+    if (Description && Event->EventID() && (xEvent->EITEventID()==Event->EventID()) &&
+            xEvent->EITDescription() && !strcmp(xEvent->EITDescription(),Description)) return false;
 
     if (Description)
     {
@@ -1501,46 +1793,15 @@ bool cImport::UpdateXMLTVEvent(cEPGSource *Source, sqlite3 *Db, const cEvent *Ev
 
     if (!Begin(Source,Db)) return false;
 
-    char *sql=NULL;
-    if (Description)
-    {
-        char *eitdescription=strdup(Description);
-        if (!eitdescription)
-        {
-            esyslogs(Source,"out of memory");
-            return false;
-        }
-
-        string ed=eitdescription;
-
-        int reps;
-        reps=pcrecpp::RE("'").GlobalReplace("''",&ed);
-        if (reps)
-        {
-            eitdescription=(char *) realloc(eitdescription,ed.size()+1);
-            strcpy(eitdescription,ed.c_str());
-        }
-
-        if (asprintf(&sql,"update epg set eiteventid=%li, eitdescription='%s' where eventid=%li and "
-                     "src='%s' and channelid='%s'",(long int) Event->EventID(),eitdescription,
-                     (long int) xEvent->EventID(),Source->Name(),*Event->ChannelID().ToString())==-1)
-        {
-            free(eitdescription);
-            esyslogs(Source,"out of memory");
-            return false;
-        }
-        free(eitdescription);
-    }
-    else
-    {
-        if (asprintf(&sql,"update epg set eiteventid=%li where eventid=%li and src='%s' and "
-                     "channelid='%s'",(long int) Event->EventID(),(long int) xEvent->EventID(),
-                     Source->Name(),*Event->ChannelID().ToString())==-1)
-        {
-            esyslogs(Source,"out of memory");
-            return false;
-        }
-    }
+    sqlite3_stmt *stmt=Statement(Db,Description ? STMT_UPDATE_EITDESCRIPTION : STMT_UPDATE_EITID,
+                                 cEPGDatabase::Day(xEvent->StartTime()));
+    if (!stmt) return false;
+    cString channelid=Event->ChannelID().ToString();
+    sqlite3_bind_int64(stmt,1,Event->EventID());
+    sqlite3_bind_int64(stmt,2,xEvent->EventID());
+    sqlite3_bind_text(stmt,3,Source->Name(),-1,SQLITE_STATIC);
+    sqlite3_bind_text(stmt,4,channelid,-1,SQLITE_STATIC);
+    if (Description) sqlite3_bind_text(stmt,5,Description,-1,SQLITE_STATIC);
 
     if (Source->Trace())
     {
@@ -1562,16 +1823,18 @@ bool cImport::UpdateXMLTVEvent(cEPGSource *Source, sqlite3 *Db, const cEvent *Ev
         }
     }
 
-    char *errmsg;
-    if (sqlite3_exec(Db,sql,NULL,NULL,&errmsg)!=SQLITE_OK)
+    if (Step(stmt)!=SQLITE_DONE)
     {
-        esyslogs(Source,"%s -> %s",sql,errmsg);
-        free(sql);
-        sqlite3_free(errmsg);
+        esyslogs(Source,"sqlite3: update eit -> %s",sqlite3_errmsg(Db));
+        sqlite3_reset(stmt);
         return false;
     }
-
-    free(sql);
+    sqlite3_reset(stmt);
+    // the database row now carries the eiteventid of this event
+    tEventID eiteventid=xEvent->EITEventID();
+    xEvent->SetEITEventID(Event->EventID());
+    g->XMLTVCache()->Put(Source->Name(),channelid,xEvent);
+    xEvent->SetEITEventID(eiteventid);
     return true;
 }
 
@@ -1579,111 +1842,126 @@ cXMLTVEvent *cImport::SearchXMLTVEvent(sqlite3 **Db,const char *ChannelID, const
 {
     if (!Event) return NULL;
     if (!Db) return NULL;
-    if (!*Db)
-    {
-        // we need READWRITE because the epg.db maybe updated later
-        if (sqlite3_open_v2(g->EPGFile(),Db,SQLITE_OPEN_READWRITE,NULL)!=SQLITE_OK)
-        {
-            esyslog("failed to open %s",g->EPGFile());
-            *Db=NULL;
-            return NULL;
-        }
-    }
-
-    cXMLTVEvent *xevent=NULL;
-    char *sql=NULL;
 
     int eventTimeDiff=0;
     if (Event->Duration()) eventTimeDiff=Event->Duration()/4;
     if (eventTimeDiff<100) eventTimeDiff=100;
     if (eventTimeDiff>720) eventTimeDiff=720;
 
-    if (asprintf(&sql,"select channelid,eventid,starttime,duration,title,origtitle,shorttext,description," \
-                 "country,year,credits,category,review,rating,starrating,video,audio,season,episode," \
-                 "episodeoverall,pics,src,eiteventid,eitdescription,alttitle,abs(starttime-%li) as diff from epg where " \
-                 " (starttime>=%li and starttime<=%li) and eiteventid=%u and channelid='%s' " \
-                 " order by diff,srcidx asc limit 1;",Event->StartTime(),Event->StartTime()-eventTimeDiff,
-                 Event->StartTime()+eventTimeDiff,Event->EventID(),ChannelID)==-1)
+    cXMLTVEvent *xevent=NULL;
+    if (g->XMLTVCache()->Lookup(ChannelID,Event,eventTimeDiff,&xevent)!=XMLTVCACHE_UNKNOWN) return xevent;
+    if (g->XMLTVCache()->IsNegative(ChannelID,Event)) return NULL;
+
+    if (!OpenDB(Db)) return NULL;
+
+    xevent=SearchDays(*Db,STMT_SEARCH_EITID,ChannelID,Event,eventTimeDiff,NULL);
+    if (xevent) return xevent;
+    if (!DBExists())
     {
-        esyslog("out of memory");
+        // database was removed because of a schema change
+        FinalizeStatements();
+        sqlite3_close(*Db);
+        *Db=NULL;
         return NULL;
     }
+    bool failed=stepfailed;
 
-    xevent=PrepareAndReturn(Db,sql);
-    if (xevent) return xevent;
-
-    bool bUseRawTitle=false;
-    if (g->SoundEx())
+    char wstr[256];
+    if (g->SoundEx() && (SoundEx((char *) &wstr,(char *) Event->Title(),0,1)!=0))
     {
-        char wstr[128];
-        if (SoundEx((char *) &wstr,(char *) Event->Title(),0,1)==0)
-        {
-            bUseRawTitle=true;
-        }
-        else
-        {
-
-            if (asprintf(&sql,"select channelid,eventid,starttime,duration,title,origtitle,shorttext,description," \
-                         "country,year,credits,category,review,rating,starrating,video,audio,season,episode," \
-                         "episodeoverall,pics,src,eiteventid,eitdescription,alttitle,abs(starttime-%li) as diff from epg where " \
-                         " (starttime>=%li and starttime<=%li) and soundex(title)='%s' and channelid='%s' " \
-                         " order by diff,srcidx asc limit 1;",Event->StartTime(),Event->StartTime()-eventTimeDiff,
-                         Event->StartTime()+eventTimeDiff,wstr,ChannelID)==-1)
-            {
-                esyslog("out of memory");
-                return NULL;
-            }
-        }
+        xevent=SearchDays(*Db,STMT_SEARCH_SOUNDEX,ChannelID,Event,eventTimeDiff,wstr);
     }
     else
     {
-        bUseRawTitle=true;
+        TitleKey(Event->Title(),wstr,sizeof(wstr));
+        xevent=SearchDays(*Db,STMT_SEARCH_TITLE,ChannelID,Event,eventTimeDiff,wstr);
     }
+    if (!xevent && !failed && !stepfailed) g->XMLTVCache()->AddNegative(ChannelID,Event);
+    return xevent;
+}
 
-    if (bUseRawTitle)
+cXMLTVEvent *cImport::SearchDays(sqlite3 *Db, int Which, const char *ChannelID, const cEvent *Event,
+                                 int TimeDiff, const char *Key)
+{
+    // the window touches one or two day partitions, the nearest match wins
+    cXMLTVEvent *best=NULL;
+    bool failed=false;
+    int last=cEPGDatabase::Day(Event->StartTime()+TimeDiff);
+    for (int day=cEPGDatabase::Day(Event->StartTime()-TimeDiff); day<=last; day++)
     {
-        char *sqltitle=strdup(Event->Title());
-        if (!sqltitle)
+        sqlite3_stmt *stmt=Statement(Db,Which,day);
+        if (!stmt) continue;
+        sqlite3_bind_int64(stmt,1,Event->StartTime()-TimeDiff);
+        sqlite3_bind_int64(stmt,2,Event->StartTime()+TimeDiff);
+        if (Key)
         {
-            esyslog("out of memory");
-            return NULL;
+            sqlite3_bind_text(stmt,3,Key,-1,SQLITE_STATIC);
         }
-
-        string st=sqltitle;
-
-        int reps;
-        reps=pcrecpp::RE("'").GlobalReplace("''",&st);
-        if (reps)
+        else
         {
-            char *tmp_sqltitle=(char *) realloc(sqltitle,st.size()+1);
-            if (tmp_sqltitle)
-            {
-                sqltitle=tmp_sqltitle;
-                strcpy(sqltitle,st.c_str());
-            }
+            sqlite3_bind_int64(stmt,3,Event->EventID());
         }
+        sqlite3_bind_text(stmt,4,ChannelID,-1,SQLITE_STATIC);
+        sqlite3_bind_int64(stmt,5,Event->StartTime());
+        cXMLTVEvent *xevent=StepAndReturn(stmt);
+        if (stepfailed) failed=true;
+        if (!xevent) continue;
+        if (!best || (labs(xevent->StartTime()-Event->StartTime())<labs(best->StartTime()-Event->StartTime())))
+        {
+            delete best;
+            best=xevent;
+        }
+        else
+        {
+            delete xevent;
+        }
+    }
+    stepfailed=failed;
+    return best;
+}
 
-        if (asprintf(&sql,"select channelid,eventid,starttime,duration,title,origtitle,shorttext,description," \
-                     "country,year,credits,category,review,rating,starrating,video,audio,season,episode," \
-                     "episodeoverall,pics,src,eiteventid,eitdescription,abs(starttime-%li) as diff from epg where " \
-                     " (starttime>=%li and starttime<=%li) and title='%s' and channelid='%s' " \
-                     " order by diff,srcidx asc limit 1;",Event->StartTime(),Event->StartTime()-eventTimeDiff,
-                     Event->StartTime()+eventTimeDiff,sqltitle,ChannelID)==-1)
+void cImport::TitleKey(const char *Title, char *Key, int KeySize)
+{
+    // lowercase ascii letters and digits, other ascii characters are dropped,
+    // utf-8 sequences are kept as they are
+    if (!Key) return;
+    if (KeySize<=0) return;
+    int len=0;
+    if (Title)
+    {
+        for (const unsigned char *p=(const unsigned char *) Title; *p && (len<KeySize-1); p++)
         {
-            free(sqltitle);
-            esyslog("out of memory");
-            return NULL;
+            if (*p>=0x80)
+            {
+                Key[len++]=*p;
+            }
+            else if (isalnum(*p))
+            {
+                Key[len++]=tolower(*p);
+            }
         }
-        free(sqltitle);
     }
+    Key[len]=0;
+}
 
-    return PrepareAndReturn(Db,sql);
+bool cImport::OpenDB(sqlite3 **Db)
+{
+    if (!Db) return false;
+    if (*Db) return true;
+    // we need READWRITE because the epg.db maybe updated later
+    if (!g->EPGDatabase()->Open(Db))
+    {
+        esyslog("failed to open %s",g->EPGFile());
+        return false;
+    }
+    return true;
 }
 
 bool cImport::Begin(cEPGSource *Source, sqlite3 *Db)
 {
     if (!Source) return false;
     if (!Db) return false;
+    if (writer) return true;
     if (!pendingtransaction)
     {
         char *errmsg;
@@ -1696,11 +1974,21 @@ bool cImport::Begin(cEPGSource *Source, sqlite3 *Db)
         else
         {
             pendingtransaction=true;
+            pendingchanges=sqlite3_total_changes(Db);
+            pendingtime.Set();
         }
     }
     return true;
 }
 
+bool cImport::CommitDue(sqlite3 *Db)
+{
+    if (!Db) return false;
+    if (!pendingtransaction) return false;
+    if ((sqlite3_total_changes(Db)-pendingchanges)>=EPGDB_GROUPROWS) return true;
+    return (pendingtime.Elapsed()>=EPGDB_GROUPMS);
+}
+
 bool cImport::Commit(cEPGSource *Source, sqlite3 *Db)
 {
     if (!Db) return false;
@@ -1725,15 +2013,72 @@ bool cImport::Commit(cEPGSource *Source, sqlite3 *Db)
     return true;
 }
 
+bool cImport::ChangedEvents(sqlite3 *Db, const cSchedules *Schedules)
+{
+    // collect the vdr events changed since they were imported, e.g. by a new eit version
+    char *errmsg;
+    if (sqlite3_exec(Db,"CREATE TEMP TABLE IF NOT EXISTS eitchanged (channelid nvarchar(255), eiteventid int, " \
+                     "PRIMARY KEY(channelid, eiteventid)); DELETE FROM temp.eitchanged;",NULL,NULL,&errmsg)!=SQLITE_OK)
+    {
+        esyslog("sqlite3: %s (eitchanged)",errmsg);
+        sqlite3_free(errmsg);
+        return false;
+    }
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(Db,"INSERT OR IGNORE INTO temp.eitchanged (channelid,eiteventid) VALUES (?1,?2);",
+                           -1,&stmt,NULL)!=SQLITE_OK)
+    {
+        esyslog("sqlite3: %s (eitchanged)",sqlite3_errmsg(Db));
+        return false;
+    }
+
+    bool ret=true;
+    std::string channelid;
+    const cSchedule *schedule=NULL;
+    std::map<std::pair<std::string,tEventID>,unsigned int>::iterator it=imported.begin();
+    while (it!=imported.end())
+    {
+        if (it->first.first!=channelid)
+        {
+            channelid=it->first.first;
+            schedule=Schedules->GetSchedule(tChannelID::FromString(channelid.c_str()));
+        }
+        const cEvent *event=schedule ? schedule->GetEvent(it->first.second) : NULL;
+        if (event && (cEPGTimer::Signature(event)==it->second))
+        {
+            it++;
+            continue;
+        }
+        // changed or gone, the rows of the event are imported again
+        sqlite3_bind_text(stmt,1,channelid.c_str(),-1,SQLITE_TRANSIENT);
+        sqlite3_bind_int64(stmt,2,it->first.second);
+        if (sqlite3_step(stmt)!=SQLITE_DONE) ret=false;
+        sqlite3_reset(stmt);
+        imported.erase(it++);
+    }
+    sqlite3_finalize(stmt);
+    return ret;
+}
+
 int cImport::Process(cEPGSource *Source, cEPGExecutor &myExecutor)
 {
     if (!Source) return 0;
+
+    // let the background season/episode lookup finish its rows first
+    cEPGSeasonEpisode *seasonepisode=g->EPGSeasonEpisode();
+    while (seasonepisode && !seasonepisode->WaitIdle(1000))
+    {
+        if (!myExecutor.StillRunning()) break;
+    }
+
     time_t begin=time(NULL);
     time_t end=begin+(Source->DaysInAdvance()*86400);
 #if VDRVERSNUM < 10726 && (!EPGHANDLER)
     time_t endoneday=begin+86400;
 #endif
 
+    cEPGSourceStats *stats=Source->Stats();
+    uint64_t lockstart=cEPGSourceStats::Now();
     const cSchedules *schedules=NULL;
     int l=0;
 #if VDRVERSNUM<20301
@@ -1776,10 +2121,12 @@ int cImport::Process(cEPGSource *Source, cEPGExecutor &myExecutor)
         esyslogs(Source,"failed to get schedules lock");
         return 141;
     }
+    uint64_t lockacquired=cEPGSourceStats::Now();
+    stats->lockwait=lockacquired-lockstart;
 
     dsyslogs(Source,"importing from db");
     sqlite3 *db=NULL;
-    if (sqlite3_open_v2(g->EPGFile(),&db,SQLITE_OPEN_READWRITE,NULL)!=SQLITE_OK)
+    if (!g->EPGDatabase()->Open(&db))
     {
         esyslogs(Source,"failed to open %s",g->EPGFile());
 #if VDRVERSNUM<20301
@@ -1791,12 +2138,43 @@ int cImport::Process(cEPGSource *Source, cEPGExecutor &myExecutor)
         return 141;
     }
 
+    // rows changed since the last import of this source get a higher change sequence,
+    // writers stamp their rows with the current value, we start a new one
+    int seq=-1;
+    sqlite3_stmt *seqstmt;
+    if (sqlite3_prepare_v2(db,"select seq from epgseq;",-1,&seqstmt,NULL)==SQLITE_OK)
+    {
+        if (sqlite3_step(seqstmt)==SQLITE_ROW) seq=sqlite3_column_int(seqstmt,0);
+        sqlite3_finalize(seqstmt);
+    }
+    if ((seq>=0) && (sqlite3_exec(db,"UPDATE epgseq SET seq=seq+1;",NULL,NULL,NULL)!=SQLITE_OK)) seq=-1;
+
+    // a replaced database or changed mappings/options need a full import
+    int generation=g->DBReplaced(),setup=g->SetupGeneration();
+    bool incremental=((seq>=0) && (importseq>=0) && (importgeneration==generation) && (importsetup==setup) &&
+                      !myExecutor.ForcedImport() && ChangedEvents(db,schedules));
+    cString changed="";
+    if (incremental)
+    {
+        // besides the changed rows: rows which entered the time window, rows without
+        // vdr event and rows whose vdr event changed after the last import
+        changed=cString::sprintf(" and (changeseq>%i or (starttime + duration)>=%li or eiteventid is null or " \
+                                 "eiteventid=0 or exists (select 1 from temp.eitchanged c where " \
+                                 "c.channelid=epg.channelid and c.eiteventid=epg.eiteventid))",
+                                 importseq,importend);
+        dsyslogs(Source,"importing rows changed since %i",importseq);
+    }
+    else
+    {
+        imported.clear();
+    }
+
     char *sql;
     if (asprintf(&sql,"select channelid,eventid,starttime,duration,title,origtitle,shorttext,description," \
                  "country,year,credits,category,review,rating,starrating,video,audio,season,episode,episodeoverall," \
                  "pics,src,eiteventid,eitdescription from epg where (starttime > %li or " \
                  " (starttime + duration) > %li) and (starttime + duration) < %li "\
-                 " and src='%s' order by channelid,starttime;",begin,begin,end,Source->Name())==-1)
+                 " and src='%s'%s order by channelid,starttime;",begin,begin,end,Source->Name(),*changed)==-1)
     {
         sqlite3_close(db);
         esyslogs(Source,"out of memory");
@@ -1829,15 +2207,20 @@ int cImport::Process(cEPGSource *Source, cEPGExecutor &myExecutor)
     int lerr=0;
     int cnt=0;
     char *lastChannelID=NULL;
+    piccreated=pickept=picremoved=0;
     int flags=0,hint=0;
     bool addevents=false;
     cSchedule* schedule=NULL;
     for (;;)
     {
-        if (sqlite3_step(stmt)==SQLITE_ROW)
+        uint64_t stepstart=cEPGSourceStats::Now();
+        int stepret=sqlite3_step(stmt);
+        stats->importsql+=cEPGSourceStats::Now()-stepstart;
+        if (stepret==SQLITE_ROW)
         {
+            stats->rows++;
             cXMLTVEvent xevent;
-            if (FetchXMLTVEvent(stmt,&xevent))
+            if (FetchXMLTVEvent(stmt,&xevent,g->EPGCompression()))
             {
                 if (!lastChannelID || strcmp(lastChannelID,xevent.ChannelID()))
                 {
@@ -1948,6 +2331,15 @@ int cImport::Process(cEPGSource *Source, cEPGExecutor &myExecutor)
 #endif
                     cnt++;
                 }
+                else if (event)
+                {
+                    stats->eventsunchanged++;
+                }
+                if (event)
+                    imported[std::make_pair(std::string(xevent.ChannelID()),event->EventID())]=
+                        cEPGTimer::Signature(event);
+                // commit in groups, the eit writer must not wait for the whole import
+                if (CommitDue(db)) Commit(Source,db);
             }
         }
         else
@@ -1956,17 +2348,30 @@ int cImport::Process(cEPGSource *Source, cEPGExecutor &myExecutor)
         }
     }
 
-    if (Commit(Source,db))
+    bool ok=Commit(Source,db);
+    if (ok && (seq>=0))
+    {
+        importgeneration=generation;
+        importsetup=setup;
+        importseq=seq;
+        importend=end;
+    }
+    else
+    {
+        importseq=-1;
+    }
+    if (ok)
     {
         if (cnt)
         {
             if (!lerr)
             {
-                isyslogs(Source,"processed %i vdr events",cnt);
+                isyslogs(Source,"processed %i vdr events, %i unchanged",cnt,stats->eventsunchanged);
             }
             else
             {
-                isyslogs(Source,"processed %i vdr events - see ERRORs above!",cnt);
+                isyslogs(Source,"processed %i vdr events, %i unchanged - see ERRORs above!",cnt,
+                         stats->eventsunchanged);
             }
         }
         else
@@ -1980,9 +2385,14 @@ int cImport::Process(cEPGSource *Source, cEPGExecutor &myExecutor)
                 isyslogs(Source,"processed no vdr events - see ERRORs above!");
             }
         }
+        if (piccreated || pickept || picremoved)
+        {
+            isyslogs(Source,"pictures: %i links created, %i kept, %i removed",piccreated,pickept,picremoved);
+        }
     }
 
     sqlite3_finalize(stmt);
+    FinalizeStatements();
     sqlite3_close(db);
 #if VDRVERSNUM<20301
     delete schedulesLock;
@@ -1991,22 +2401,34 @@ int cImport::Process(cEPGSource *Source, cEPGExecutor &myExecutor)
 #else
     StateKey.Remove();
 #endif
+    stats->lockhold=cEPGSourceStats::Now()-lockacquired;
+    stats->changed=cnt;
+    stats->piccreated=piccreated;
+    stats->pickept=pickept;
+    stats->picremoved=picremoved;
+    g->XMLTVCache()->Refresh();
+    g->EPGBackup()->Trigger();
     return 0;
 }
 
 bool cImport::DBExists()
 {
-    if (!g->EPGFile()) return true; // is this safe?
-    struct stat statbuf;
-    if (stat(g->EPGFile(),&statbuf)==-1) return false; // no database
-    if (!statbuf.st_size) return false; // no database
-    return true;
+    return g->DBExists();
 }
 
 cImport::cImport(cGlobals *Global)
 {
     g=Global;
     pendingtransaction=false;
+    imgdirfd=-1;
+    piccreated=pickept=picremoved=0;
+    stmtdb=NULL;
+    stmtdropped=0;
+    stepfailed=false;
+    writer=NULL;
+    pendingchanges=0;
+    importgeneration=importsetup=importseq=-1;
+    importend=0;
     conv = new cCharSetConv("UTF-8",g->Codeset());
 
     if (Global->EPDir())
@@ -2023,7 +2445,9 @@ cImport::cImport(cGlobals *Global)
 
 cImport::~cImport()
 {
+    FinalizeStatements();
     if (cep2ascii!=(iconv_t) -1) iconv_close(cep2ascii);
     if (cutf2ascii!=(iconv_t) -1) iconv_close(cutf2ascii);
+    if (imgdirfd!=-1) close(imgdirfd);
     delete conv;
 }
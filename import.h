@@ -11,17 +11,45 @@
 #include <vdr/epg.h>
 #include <vdr/channels.h>
 #include <sqlite3.h>
+#include <map>
 
 #include "event.h"
 #include "source.h"
 #include "maps.h"
+#include "db.h"
+
+#define XMLTV_COLUMNS "channelid,eventid,starttime,duration,title,origtitle,shorttext,description," \
+                      "country,year,credits,category,review,rating,starrating,video,audio,season,episode," \
+                      "episodeoverall,pics,src,eiteventid,eitdescription,alttitle"
 
 class cEPGSource;
+class cEPGCompression;
 class cEPGExecutor;
 class cGlobals;
 
 class cImport
 {
+public:
+    enum
+    {
+        STMT_SEARCH_EITID=0,
+        STMT_SEARCH_SOUNDEX,
+        STMT_SEARCH_TITLE,
+        STMT_UPDATE_EITID,
+        STMT_UPDATE_EITDESCRIPTION,
+        STMT_UPDATE_SEASON,
+        STMT_UPDATE_SEASON_SHORTTEXT,
+        STMT_INSERT,
+        STMT_UPDATE,
+        STMT_UPSERT,
+        STMT_INSERT_LINK,
+        STMT_FTS_INDEX,
+        STMT_PICLINK_GET,
+        STMT_PICLINK_SET,
+        STMT_PICLINK_LIST,
+        STMT_PICLINK_DEL,
+        STMT_COUNT
+    };
 private:
     struct split
     {
@@ -43,6 +71,8 @@ private:
     iconv_t cep2ascii;
     iconv_t cutf2ascii;
     bool pendingtransaction;
+    int imgdirfd;
+    int piccreated,pickept,picremoved;
     char *RemoveLastCharFromDescription(char *description);
     char *Add2Description(char *description, const char *value);
     char *Add2Description(char *description, const char *name, const char *value);
@@ -54,19 +84,49 @@ private:
     cEvent *SearchVDREvent(cEPGSource *source, cSchedule* schedule, cXMLTVEvent *event, bool append, int hint);
     cEvent *SearchVDREventByTitle(cEPGSource *source, cSchedule* schedule, const char *Title, time_t StartTime,
                                   int Duration, int hint);
-    bool FetchXMLTVEvent(sqlite3_stmt *stmt, cXMLTVEvent *xevent);
-    char *RemoveNonASCII(const char *src);
-    cXMLTVEvent *PrepareAndReturn(sqlite3 **db, char *sql);
-    int SoundEx(char *SoundEx,char *WordString,int LengthOption,int CensusOption);
+    sqlite3 *stmtdb;
+    std::map<std::pair<int,int>,sqlite3_stmt *> stmts; // statement,day
+    int stmtdropped; // see cEPGDatabase::Dropped
+    bool stepfailed;
+    cEPGWriter *writer;
+    int pendingchanges;
+    cTimeMs pendingtime;
+    int importgeneration,importsetup,importseq; // last successful import, see Process
+    time_t importend;
+    std::map<std::pair<std::string,tEventID>,unsigned int> imported; // channelid/eventid -> signature
+    bool ChangedEvents(sqlite3 *Db, const cSchedules *Schedules);
+    sqlite3_stmt *Statement(sqlite3 *Db, int Which, int Day=-1);
+    void FinalizeStatements(int Before);
+    void BindXMLTVEvent(sqlite3_stmt *stmt, const char *Source, int SrcIdx, const char *XMLTVID,
+                        cXMLTVEvent *xEvent);
+    cXMLTVEvent *StepAndReturn(sqlite3_stmt *stmt);
+    void IndexXMLTVEvent(sqlite3 *Db, const char *Source, const char *ChannelID, cXMLTVEvent *xEvent);
+    int Step(sqlite3_stmt *stmt);
+    cXMLTVEvent *SearchDays(sqlite3 *Db, int Which, const char *ChannelID, const cEvent *Event, int TimeDiff,
+                            const char *Key);
+    bool LinkPicture(sqlite3 *Db, const char *Link, const char *Target, const char *ChanID, tEventID DestID);
 public:
     cImport(cGlobals *Global);
     ~cImport();
-    void LinkPictures(const char *Source, cXMLTVStringList *Pics, tEventID DestID,
+    void LinkPictures(cEPGSource *Source, sqlite3 *Db, cXMLTVEvent *xEvent, tEventID DestID,
                       tChannelID ChanID, bool MakeOld=true);
     int Process(cEPGSource *Source, cEPGExecutor &myExecutor);
     bool Begin(cEPGSource *Source, sqlite3 *Db);
     bool Commit(cEPGSource *Source, sqlite3 *Db);
+    bool CommitDue(sqlite3 *Db);
+    void SetWriter(cEPGWriter *Writer)
+    {
+        // changes are queued for the writer thread
+        writer=Writer;
+    }
+    void FinalizeStatements();
+    bool OpenDB(sqlite3 **Db);
     bool DBExists();
+    static bool FetchXMLTVEvent(sqlite3_stmt *stmt, cXMLTVEvent *xevent, cEPGCompression *Codec=NULL);
+    static int SoundEx(char *SoundEx,char *WordString,int LengthOption,int CensusOption);
+    static void TitleKey(const char *Title, char *Key, int KeySize);
+    static void BindText(sqlite3_stmt *stmt, int Index, const char *Value);
+    static char *RemoveNonASCII(const char *src);
     bool PutEvent(cEPGSource *Source, sqlite3 *Db, cSchedule* Schedule, cEvent *Event,
                   cXMLTVEvent *xEvent, int Flags);
     bool UpdateXMLTVEvent(cEPGSource *Source, sqlite3 *Db, cXMLTVEvent *xEvent);
@@ -22,6 +22,7 @@
 
 #include "xmltv2vdr.h"
 #include "parse.h"
+#include "xtvb.h"
 #include "debug.h"
 
 // -------------------------------------------------------
@@ -509,7 +510,7 @@ bool cParse::FetchSeasonEpisode(iconv_t cEP2ASCII, iconv_t cUTF2ASCII, const cha
     return found;
 }
 
-bool cParse::FetchEvent(xmlNodePtr enode, bool useeptext)
+bool cParse::FetchEvent(xmlNodePtr enode)
 {
     char *slang=getenv("LANG");
     xmlNodePtr node=enode->xmlChildrenNode;
@@ -877,29 +878,709 @@ bool cParse::FetchEvent(xmlNodePtr enode, bool useeptext)
         node=node->next;
     }
 
-    int season=xevent.Season(),episode=xevent.Episode(),episodeoverall=0;
-    char *epshorttext=NULL;
-    char *eptitle=NULL;
+    return xevent.HasTitle();
+}
+
+bool cParse::OpenDB(sqlite3 **db)
+{
+    if (!g->EPGDatabase()->Open(db,SQLITE_OPEN_READWRITE|SQLITE_OPEN_CREATE))
+    {
+        esyslogs(source,"failed to open or create %s",g->EPGFile());
+        return false;
+    }
 
-    if (FetchSeasonEpisode(cep2ascii,cutf2ascii,g->EPDir(),xevent.Title(),xevent.ShortText(),
-                           xevent.Description(),season,episode,episodeoverall,&epshorttext,
-                           &eptitle))
+    // events are stored in per day partitions, see cEPGDatabase::Partition,
+    // drop the tables of older layouts
+    char *errmsg;
+    sqlite3_stmt *stmt;
+    bool hasview=false,oldtable=false,oldevents=false;
+    if (sqlite3_prepare_v2(*db,"select name,type from sqlite_master where name in ('epg','epgevents','epglinks');",
+                           -1,&stmt,NULL)==SQLITE_OK)
     {
-        xevent.SetSeason(season);
-        xevent.SetEpisode(episode);
-        xevent.SetEpisodeOverall(episodeoverall);
-        if (epshorttext)
+        while (sqlite3_step(stmt)==SQLITE_ROW)
         {
-            if (useeptext) xevent.SetShortText(epshorttext);
-            free(epshorttext);
+            const char *name=(const char *) sqlite3_column_text(stmt,0);
+            const char *type=(const char *) sqlite3_column_text(stmt,1);
+            if (!name || !type) continue;
+            if (!strcmp(name,"epg"))
+            {
+                oldtable=!strcmp(type,"table");
+                hasview=!oldtable;
+            }
+            else
+            {
+                oldevents=true;
+            }
         }
+        sqlite3_finalize(stmt);
     }
-    if (eptitle)
+    if (oldtable || oldevents)
     {
-        if (useeptext) xevent.SetAltTitle(eptitle);
-        free(eptitle);
+        isyslogs(source,"sqlite3: converting database to day partitions");
+        if (sqlite3_exec(*db,oldtable ? "DROP TABLE epg;" : "DROP VIEW IF EXISTS epg; DROP TABLE IF EXISTS epglinks; " \
+                         "DROP TABLE IF EXISTS epgevents;",NULL,NULL,&errmsg)!=SQLITE_OK)
+        {
+            esyslogs(source,"sqlite3: DROP %s",errmsg);
+            sqlite3_free(errmsg);
+        }
+        hasview=false;
     }
-    return xevent.HasTitle();
+
+    char sql[]="PRAGMA auto_vacuum=INCREMENTAL;" \
+               "CREATE TABLE IF NOT EXISTS epgdays (day int PRIMARY KEY);" \
+               "CREATE TABLE IF NOT EXISTS dicts (id int PRIMARY KEY, version int, dict blob);" \
+               "CREATE TABLE IF NOT EXISTS piclinks (" \
+               "link nvarchar(255) PRIMARY KEY, target nvarchar(255), channelid nvarchar(255), eventid int" \
+               ");" \
+               "CREATE INDEX IF NOT EXISTS idx4 on piclinks (channelid, eventid); " \
+               "CREATE TABLE IF NOT EXISTS epgseq (seq int);" \
+               "INSERT INTO epgseq (seq) SELECT 1 WHERE NOT EXISTS (SELECT seq FROM epgseq);" \
+               "BEGIN";
+
+    if (sqlite3_exec(*db,sql,NULL,NULL,&errmsg)!=SQLITE_OK)
+    {
+        esyslogs(source,"createdb: %s",errmsg);
+        sqlite3_free(errmsg);
+        sqlite3_close(*db);
+        *db=NULL;
+        return false;
+    }
+
+    std::vector<int> known;
+    dropped=g->EPGDatabase()->Dropped();
+    if ((!hasview && !cEPGDatabase::CreateView(*db)) || !cEPGDatabase::Days(*db,known))
+    {
+        esyslogs(source,"createdb: cannot create epg view");
+        sqlite3_exec(*db,"ROLLBACK",NULL,NULL,NULL);
+        sqlite3_close(*db);
+        *db=NULL;
+        return false;
+    }
+    days.clear();
+    days.insert(known.begin(),known.end());
+    ftsdays.clear();
+    for (size_t i=0; i<known.size(); i++)
+    {
+        cEPGDatabase::Upgrade(*db,known[i]);
+        if (cEPGDatabase::FullText(*db,known[i])) ftsdays.insert(known[i]);
+    }
+    RemoveStaleLinks(*db);
+
+    batchchanges=sqlite3_total_changes(*db);
+    batchtime.Set();
+    return true;
+}
+
+bool cParse::Mapped(const char *XMLTVID, const char *ChannelID)
+{
+    cEPGMapping *map=g->EPGMappings()->GetMap(XMLTVID);
+    if (!map) return false;
+    for (int i=0; i<map->NumChannelIDs(); i++)
+    {
+        if (!strcmp(map->ChannelIDs()[i].ToString(),ChannelID)) return true;
+    }
+    return false;
+}
+
+void cParse::RemoveStaleLinks(sqlite3 *db)
+{
+    // links of this source to channels which are no longer mapped
+    int cnt=0;
+    for (std::set<int>::iterator it=days.begin(); it!=days.end(); ++it)
+    {
+        sqlite3_stmt *stmt;
+        if (sqlite3_prepare_v2(db,*cString::sprintf("SELECT DISTINCT xmltvid,channelid FROM epglinks_%i " \
+                               "WHERE src=?1;",*it),-1,&stmt,NULL)!=SQLITE_OK)
+        {
+            esyslogs(source,"sqlite3: %s",sqlite3_errmsg(db));
+            continue;
+        }
+        sqlite3_bind_text(stmt,1,source->Name(),-1,SQLITE_STATIC);
+        std::vector<std::pair<std::string,std::string> > stale;
+        while (sqlite3_step(stmt)==SQLITE_ROW)
+        {
+            const char *xmltvid=(const char *) sqlite3_column_text(stmt,0);
+            const char *channelid=(const char *) sqlite3_column_text(stmt,1);
+            if (!xmltvid || !channelid) continue;
+            if (!Mapped(xmltvid,channelid)) stale.push_back(std::make_pair(xmltvid,channelid));
+        }
+        sqlite3_finalize(stmt);
+        if (stale.empty()) continue;
+
+        if (sqlite3_prepare_v2(db,*cString::sprintf("DELETE FROM epglinks_%i WHERE src=?1 AND xmltvid=?2 " \
+                               "AND channelid=?3;",*it),-1,&stmt,NULL)!=SQLITE_OK)
+        {
+            esyslogs(source,"sqlite3: %s",sqlite3_errmsg(db));
+            continue;
+        }
+        for (size_t i=0; i<stale.size(); i++)
+        {
+            sqlite3_bind_text(stmt,1,source->Name(),-1,SQLITE_STATIC);
+            sqlite3_bind_text(stmt,2,stale[i].first.c_str(),-1,SQLITE_STATIC);
+            sqlite3_bind_text(stmt,3,stale[i].second.c_str(),-1,SQLITE_STATIC);
+            if (sqlite3_step(stmt)==SQLITE_DONE) cnt+=sqlite3_changes(db);
+            sqlite3_reset(stmt);
+        }
+        sqlite3_finalize(stmt);
+    }
+    if (cnt) dsyslogs(source,"removed %i links to unmapped channels",cnt);
+}
+
+void cParse::CommitBatch(sqlite3 *db)
+{
+    // commit in bounded batches, other writers never wait for the whole parse
+    if (((sqlite3_total_changes(db)-batchchanges)<EPGDB_GROUPROWS) && (batchtime.Elapsed()<EPGDB_GROUPMS)) return;
+    char *errmsg;
+    if (sqlite3_exec(db,"COMMIT; BEGIN",NULL,NULL,&errmsg)!=SQLITE_OK)
+    {
+        esyslogs(source,"sqlite3: COMMIT %s",errmsg);
+        sqlite3_free(errmsg);
+    }
+    batchchanges=sqlite3_total_changes(db);
+    batchtime.Set();
+}
+
+sqlite3_stmt *cParse::DayStatement(sqlite3 *db, std::map<int,sqlite3_stmt *> &stmts, const char *sql, int day)
+{
+    std::map<int,sqlite3_stmt *>::iterator it=stmts.find(day);
+    if (it!=stmts.end())
+    {
+        sqlite3_reset(it->second);
+        sqlite3_clear_bindings(it->second);
+        return it->second;
+    }
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db,*cString::sprintf(sql,day),-1,&stmt,NULL)!=SQLITE_OK)
+    {
+        esyslogs(source,"sqlite3: %s",sqlite3_errmsg(db));
+        return NULL;
+    }
+    stmts[day]=stmt;
+    return stmt;
+}
+
+void cParse::FinalizeStatements(std::map<int,sqlite3_stmt *> &stmts, int Before)
+{
+    std::map<int,sqlite3_stmt *>::iterator it=stmts.begin();
+    while ((it!=stmts.end()) && (it->first<Before))
+    {
+        sqlite3_finalize(it->second);
+        stmts.erase(it++);
+    }
+}
+
+void cParse::FinalizeStatements(int Before)
+{
+    // all statements, or those of the days dropped by the housekeeping
+    FinalizeStatements(linkstmts,Before);
+    FinalizeStatements(movestmts,Before);
+    FinalizeStatements(sigstmts,Before);
+    FinalizeStatements(seqstmts,Before);
+    FinalizeStatements(ftsstmts,Before);
+    days.erase(days.begin(),days.lower_bound(Before));
+    ftsdays.erase(ftsdays.begin(),ftsdays.lower_bound(Before));
+    if (Before==INT_MAX)
+    {
+        if (findstmt) sqlite3_finalize(findstmt);
+        findstmt=NULL;
+    }
+}
+
+unsigned int cParse::Signature(const char *SQL)
+{
+    // FNV-1a over the update statement, it holds all values of the row
+    unsigned int hash=2166136261U;
+    for (const char *p=SQL; p && *p; p++)
+    {
+        hash^=(unsigned char) *p;
+        hash*=16777619U;
+    }
+    return hash;
+}
+
+bool cParse::Store(sqlite3 *db, cEPGMapping *map, int &lerr, int &lweak, int line, bool &do_unlink)
+{
+    cEPGSourceStats *stats=source->Stats();
+    if (!xevent.EventID())
+    {
+        if (lweak!=PARSE_NOEVENTID)
+            isyslogs(source,"event without id, using starttime as id (weak)!");
+        lweak=PARSE_NOEVENTID;
+        xevent.CreateEventID(xevent.StartTime());
+    }
+
+    char *errmsg;
+    char *isql,*usql;
+    xevent.GetSQL(source->Name(),source->Index(),map->ChannelName(),&isql,&usql);
+    if (!isql || !usql) return true;
+
+    uint64_t sqlstart=cEPGSourceStats::Now();
+    if (g->EPGDatabase()->Dropped()!=dropped)
+    {
+        dropped=g->EPGDatabase()->Dropped();
+        FinalizeStatements(dropped);
+    }
+    int day=cEPGDatabase::Day(xevent.StartTime());
+    if (days.find(day)==days.end())
+    {
+        if (!cEPGDatabase::Partition(db,day))
+        {
+            lerr=PARSE_SQLERR;
+            stats->parsesql+=cEPGSourceStats::Now()-sqlstart;
+            return false;
+        }
+        days.insert(day);
+        if (cEPGDatabase::FullText(db,day)) ftsdays.insert(day);
+    }
+
+    // rows with the same content are left alone, no epcheck reset and no new change sequence
+    unsigned int signature=Signature(usql);
+    int found=-1; // -1 = no row, 0 = other content, 1 = same content
+    sqlite3_stmt *sigstmt=DayStatement(db,sigstmts,"SELECT signature FROM epgevents_%i WHERE eventid=?1 " \
+                                       "AND src=?2 AND xmltvid=?3;",day);
+    if (sigstmt)
+    {
+        sqlite3_bind_int64(sigstmt,1,xevent.EventID());
+        sqlite3_bind_text(sigstmt,2,source->Name(),-1,SQLITE_STATIC);
+        sqlite3_bind_text(sigstmt,3,map->ChannelName(),-1,SQLITE_STATIC);
+        if (sqlite3_step(sigstmt)==SQLITE_ROW)
+            found=((sqlite3_column_type(sigstmt,0)!=SQLITE_NULL) &&
+                   ((unsigned int) sqlite3_column_int(sigstmt,0)==signature)) ? 1 : 0;
+        sqlite3_reset(sigstmt);
+    }
+
+    if (found==1)
+    {
+        stats->unchanged++;
+    }
+    else
+    {
+        int ret;
+        bool update_issued=(found==0);
+        if (update_issued)
+        {
+            ret=sqlite3_exec(db,usql,NULL,NULL,&errmsg);
+        }
+        else
+        {
+            ret=sqlite3_exec(db,isql,NULL,NULL,&errmsg);
+            if (ret==SQLITE_CONSTRAINT)
+            {
+                sqlite3_free(errmsg);
+                ret=sqlite3_exec(db,usql,NULL,NULL,&errmsg);
+                update_issued=true;
+            }
+        }
+        if (ret!=SQLITE_OK)
+        {
+            if (lerr!=PARSE_SQLERR)
+            {
+                if (strstr(errmsg,"has no column named"))
+                {
+                    esyslogs(source,"sqlite3: database schema changed, unlinking epg.db!");
+                    do_unlink=true;
+                }
+                else
+                {
+                    if (!xevent.WeakID())
+                    {
+                        esyslogs(source,"sqlite3: %s (%u@%i)",errmsg,xevent.EventID(),line);
+                    }
+                    else
+                    {
+                        esyslogs(source,"sqlite3: %s ('%s'@%i)",errmsg,xevent.Title(),line);
+                    }
+                    tsyslogs(source,"sqlite3: %s",update_issued ? usql : isql);
+                }
+            }
+            lerr=PARSE_SQLERR;
+            sqlite3_free(errmsg);
+            stats->parsesql+=cEPGSourceStats::Now()-sqlstart;
+            return false;
+        }
+
+        if (update_issued)
+        {
+            stats->updated++;
+        }
+        else
+        {
+            stats->inserted++;
+            // the starttime may have moved the event to another day
+            if (!findstmt && (sqlite3_prepare_v2(db,"SELECT DISTINCT starttime FROM epg WHERE eventid=?1 " \
+                              "AND src=?2 AND xmltvid=?3;",-1,&findstmt,NULL)!=SQLITE_OK))
+            {
+                esyslogs(source,"sqlite3: %s",sqlite3_errmsg(db));
+                findstmt=NULL;
+            }
+            std::set<int> moved;
+            if (findstmt)
+            {
+                sqlite3_bind_int64(findstmt,1,xevent.EventID());
+                sqlite3_bind_text(findstmt,2,source->Name(),-1,SQLITE_STATIC);
+                sqlite3_bind_text(findstmt,3,map->ChannelName(),-1,SQLITE_STATIC);
+                while (sqlite3_step(findstmt)==SQLITE_ROW)
+                {
+                    int d=cEPGDatabase::Day((time_t) sqlite3_column_int64(findstmt,0));
+                    if ((d!=day) && (days.find(d)!=days.end())) moved.insert(d);
+                }
+                sqlite3_reset(findstmt);
+            }
+            for (std::set<int>::iterator it=moved.begin(); it!=moved.end(); ++it)
+            {
+                sqlite3_stmt *stmt=DayStatement(db,movestmts,"DELETE FROM epgevents_%i WHERE eventid=?1 AND src=?2 " \
+                                                "AND xmltvid=?3;",*it);
+                if (!stmt) continue;
+                sqlite3_bind_int64(stmt,1,xevent.EventID());
+                sqlite3_bind_text(stmt,2,source->Name(),-1,SQLITE_STATIC);
+                sqlite3_bind_text(stmt,3,map->ChannelName(),-1,SQLITE_STATIC);
+                sqlite3_step(stmt);
+                sqlite3_reset(stmt);
+            }
+        }
+
+        // the change sequence is read within our transaction, see cImport::Process
+        sqlite3_stmt *seqstmt=DayStatement(db,seqstmts,"UPDATE epgevents_%i SET changeseq=(SELECT seq FROM epgseq), " \
+                                           "signature=?1 WHERE eventid=?2 AND src=?3 AND xmltvid=?4;",day);
+        if (seqstmt)
+        {
+            sqlite3_bind_int(seqstmt,1,(int) signature);
+            sqlite3_bind_int64(seqstmt,2,xevent.EventID());
+            sqlite3_bind_text(seqstmt,3,source->Name(),-1,SQLITE_STATIC);
+            sqlite3_bind_text(seqstmt,4,map->ChannelName(),-1,SQLITE_STATIC);
+            sqlite3_step(seqstmt);
+            sqlite3_reset(seqstmt);
+        }
+
+        // the full text index gets the uncompressed texts
+        sqlite3_stmt *ftsstmt=(ftsdays.find(day)!=ftsdays.end()) ?
+                              DayStatement(db,ftsstmts,EPGDB_FTSINDEX "SELECT rowid,?4,?5,?6,?7,?8 FROM " \
+                                           "epgevents_%1$i WHERE eventid=?1 AND src=?2 AND xmltvid=?3;",day) : NULL;
+        if (ftsstmt)
+        {
+            sqlite3_bind_int64(ftsstmt,1,xevent.EventID());
+            sqlite3_bind_text(ftsstmt,2,source->Name(),-1,SQLITE_STATIC);
+            sqlite3_bind_text(ftsstmt,3,map->ChannelName(),-1,SQLITE_STATIC);
+            cImport::BindText(ftsstmt,4,xevent.Title());
+            cImport::BindText(ftsstmt,5,xevent.ShortText());
+            cImport::BindText(ftsstmt,6,xevent.Description());
+            cImport::BindText(ftsstmt,7,xevent.Credits()->toString());
+            cImport::BindText(ftsstmt,8,xevent.Category()->toString());
+            if (sqlite3_step(ftsstmt)!=SQLITE_DONE)
+                tsyslogs(source,"sqlite3: %s (fulltext)",sqlite3_errmsg(db));
+            sqlite3_reset(ftsstmt);
+        }
+    }
+
+    // the event itself is stored once, every mapped channel just gets a link
+    sqlite3_stmt *linkstmt=DayStatement(db,linkstmts,"INSERT OR IGNORE INTO epglinks_%i " \
+                                        "(src,xmltvid,eventid,channelid) VALUES (?1,?2,?3,?4);",day);
+    for (int i=0; linkstmt && (i<map->NumChannelIDs()); i++)
+    {
+        sqlite3_reset(linkstmt);
+        sqlite3_bind_text(linkstmt,1,source->Name(),-1,SQLITE_STATIC);
+        sqlite3_bind_text(linkstmt,2,map->ChannelName(),-1,SQLITE_STATIC);
+        sqlite3_bind_int64(linkstmt,3,xevent.EventID());
+        sqlite3_bind_text(linkstmt,4,map->ChannelIDs()[i].ToString(),-1,SQLITE_TRANSIENT);
+        if (sqlite3_step(linkstmt)!=SQLITE_DONE)
+        {
+            if (lerr!=PARSE_SQLERR)
+                esyslogs(source,"sqlite3: %s (%u@%i)",sqlite3_errmsg(db),xevent.EventID(),line);
+            lerr=PARSE_SQLERR;
+            sqlite3_reset(linkstmt);
+            stats->parsesql+=cEPGSourceStats::Now()-sqlstart;
+            return false;
+        }
+    }
+    if (linkstmt) sqlite3_reset(linkstmt);
+    CommitBatch(db);
+    stats->parsesql+=cEPGSourceStats::Now()-sqlstart;
+    return true;
+}
+
+void cParse::Finish(sqlite3 *db, int skipped, int lerr, bool do_unlink, uint64_t parsestart)
+{
+    cEPGSourceStats *stats=source->Stats();
+    char *errmsg;
+    FinalizeStatements();
+    if (sqlite3_exec(db,"COMMIT",NULL,NULL,&errmsg)!=SQLITE_OK)
+    {
+        esyslogs(source,"sqlite3: COMMIT %s",errmsg);
+        sqlite3_free(errmsg);
+    }
+
+    // event rows only, total_changes also counts links, sequence and full text index
+    int cnt=stats->inserted+stats->updated+stats->unchanged;
+    stats->skipped=skipped;
+
+    if ((skipped) && (!do_unlink))
+        isyslogs(source,"skipped %i xmltv events",skipped);
+
+    if (!lerr)
+    {
+        isyslogs(source,"processed %i xmltv events",cnt);
+    }
+    else
+    {
+        isyslogs(source,"processed %i xmltv events - see ERRORs above!",cnt);
+    }
+    isyslogs(source,"%i xmltv events inserted, %i updated, %i unchanged",stats->inserted,stats->updated,
+             stats->unchanged);
+
+    if (!do_unlink) g->EPGCompression()->Train(db);
+
+    if (sqlite3_exec(db,"ANALYZE;",NULL,NULL,&errmsg)!=SQLITE_OK)
+    {
+        esyslogs(source,"sqlite3: ANALYZE %s",errmsg);
+        sqlite3_free(errmsg);
+    }
+
+    sqlite3_close(db);
+
+    if (do_unlink)
+    {
+        g->EPGDatabase()->Unlink();
+    }
+    else
+    {
+        g->DBChanged();
+    }
+    g->XMLTVCache()->Refresh();
+    stats->parse=cEPGSourceStats::Now()-parsestart;
+    // season/episode lookup from the eplists runs in the background
+    if (g->EPGSeasonEpisode()) g->EPGSeasonEpisode()->Trigger();
+}
+
+static inline uint32_t xtvbuint32(const unsigned char *p)
+{
+    return ((uint32_t) p[0]) | ((uint32_t) p[1]<<8) | ((uint32_t) p[2]<<16) | ((uint32_t) p[3]<<24);
+}
+
+static inline int64_t xtvbint64(const unsigned char *p)
+{
+    return (int64_t) (((uint64_t) xtvbuint32(p)) | (((uint64_t) xtvbuint32(p+4))<<32));
+}
+
+void cParse::FetchBinaryField(int tag, const char *a, const char *b, uint32_t va)
+{
+    switch (tag)
+    {
+    case XTVB_F_TITLE:
+        if (a) xevent.SetTitle(a);
+        break;
+    case XTVB_F_ORIGTITLE:
+        if (a) xevent.SetOrigTitle(a);
+        break;
+    case XTVB_F_SHORTTEXT:
+        if (a) xevent.SetShortText(a);
+        break;
+    case XTVB_F_DESCRIPTION:
+        if (a) xevent.AddDescription(a);
+        break;
+    case XTVB_F_CREDIT:
+        if (a && b) xevent.AddCredits(a,b);
+        break;
+    case XTVB_F_CATEGORY:
+        if (a) xevent.AddCategory(a);
+        break;
+    case XTVB_F_COUNTRY:
+        if (a) xevent.SetCountry(a);
+        break;
+    case XTVB_F_YEAR:
+        if (va!=XTVB_NONE) xevent.SetYear((int) va);
+        break;
+    case XTVB_F_SEASON:
+        if ((va!=XTVB_NONE) && (va>0)) xevent.SetSeason((int) va);
+        break;
+    case XTVB_F_EPISODE:
+        if ((va!=XTVB_NONE) && (va>0)) xevent.SetEpisode((int) va);
+        break;
+    case XTVB_F_VIDEO:
+        if (a && b) xevent.AddVideo(a,b);
+        break;
+    case XTVB_F_AUDIO:
+        if (a)
+        {
+            // same as the xmltv path
+            char *audio=strdup(a);
+            if (audio)
+            {
+                audio=strreplace(audio," ","");
+                xevent.SetAudio(audio);
+                free(audio);
+            }
+        }
+        break;
+    case XTVB_F_RATING:
+        if (a && b) xevent.AddRating(a,b);
+        break;
+    case XTVB_F_STARRATING:
+        if (b) xevent.AddStarRating(a,b);
+        break;
+    case XTVB_F_REVIEW:
+        if (a) xevent.AddReview(a);
+        break;
+    case XTVB_F_PIC:
+        if (a)
+        {
+            struct stat statbuf;
+            if (stat(a,&statbuf)!=-1)
+            {
+                const char *file=strrchr(a,'/');
+                if (file) xevent.AddPics(file+1);
+            }
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+int cParse::ProcessBinary(cEPGExecutor &myExecutor, char *buffer, int bufsize, uint64_t parsestart)
+{
+    const unsigned char *buf=(const unsigned char *) buffer;
+    int version=buf[4] | (buf[5]<<8);
+    if (version!=XTVB_VERSION)
+    {
+        esyslogs(source,"unsupported binary format version %i",version);
+        return 141;
+    }
+
+    sqlite3 *db=NULL;
+    if (!OpenDB(&db)) return 141;
+
+    std::vector<char *> strings;
+    time_t begin=time(NULL)-7200;
+    int lerr=0,lweak=0;
+    int skipped=0;
+    int record=0;
+    bool do_unlink=false;
+    bool ended=false;
+    const char *lastchannelid=NULL;
+    int pos=XTVB_HEADERSIZE;
+
+    while (pos+XTVB_RECORDSIZE<=bufsize)
+    {
+        int type=buf[pos];
+        uint32_t len=xtvbuint32(buf+pos+1);
+        int payload=pos+XTVB_RECORDSIZE;
+        if (len>(uint32_t) (bufsize-payload))
+        {
+            esyslogs(source,"truncated binary record %i",record);
+            lerr=PARSE_XMLTVERR;
+            break;
+        }
+        pos=payload+len;
+        record++;
+
+        if (type==XTVB_END)
+        {
+            ended=true;
+            break;
+        }
+        if (type==XTVB_STRING)
+        {
+            char *str=strndup(buffer+payload,len);
+            if (!str)
+            {
+                esyslogs(source,"out of memory");
+                break;
+            }
+            strings.push_back(str);
+            continue;
+        }
+        if ((type!=XTVB_PROGRAMME) || (len<XTVB_PROGRAMMESIZE)) continue;
+
+        const unsigned char *p=buf+payload;
+        time_t starttime=(time_t) xtvbint64(p);
+        time_t stoptime=(time_t) xtvbint64(p+8);
+        uint32_t eventid=xtvbuint32(p+16);
+        uint32_t channel=xtvbuint32(p+20);
+
+        if (channel>=strings.size())
+        {
+            if (lerr!=PARSE_NOCHANNELID)
+                esyslogs(source,"missing channelid in binary record %i",record);
+            lerr=PARSE_NOCHANNELID;
+            skipped++;
+            continue;
+        }
+        const char *channelid=strings[channel];
+        cEPGMapping *map=g->EPGMappings()->GetMap(channelid);
+        if (!map)
+        {
+            if ((lerr!=PARSE_NOMAPPING) || (lastchannelid && strcmp(channelid,lastchannelid)))
+                esyslogs(source,"no mapping for channelid %s",channelid);
+            lerr=PARSE_NOMAPPING;
+            lastchannelid=channelid;
+            skipped++;
+            continue;
+        }
+        lastchannelid=channelid;
+
+        if (!starttime)
+        {
+            if (lerr!=PARSE_XMLTVERR)
+                esyslogs(source,"no starttime, check source output");
+            lerr=PARSE_XMLTVERR;
+            skipped++;
+            continue;
+        }
+        if (starttime<begin) continue;
+
+        xevent.Clear();
+        xevent.SetStartTime(starttime);
+        if (stoptime)
+        {
+            if (stoptime<starttime)
+            {
+                if (lerr!=PARSE_XMLTVERR)
+                    esyslogs(source,"stoptime < starttime in binary record %i",record);
+                lerr=PARSE_XMLTVERR;
+                skipped++;
+                continue;
+            }
+            xevent.SetDuration(stoptime-starttime);
+        }
+        if (eventid) xevent.SetEventID((tEventID) eventid);
+
+        for (uint32_t f=XTVB_PROGRAMMESIZE; f+XTVB_FIELDSIZE<=len; f+=XTVB_FIELDSIZE)
+        {
+            int tag=p[f];
+            uint32_t va=xtvbuint32(p+f+1);
+            uint32_t vb=xtvbuint32(p+f+5);
+            const char *a=(va<strings.size()) ? strings[va] : NULL;
+            const char *b=(vb<strings.size()) ? strings[vb] : NULL;
+            FetchBinaryField(tag,a,b,va);
+        }
+
+        if (!xevent.HasTitle())
+        {
+            if (lerr!=PARSE_FETCHERR)
+                esyslogs(source,"failed to fetch event");
+            lerr=PARSE_FETCHERR;
+            skipped++;
+            continue;
+        }
+
+        if (!Store(db,map,lerr,lweak,record,do_unlink)) skipped++;
+
+        if (!myExecutor.StillRunning())
+        {
+            isyslogs(source,"request to stop from vdr");
+            break;
+        }
+        if (do_unlink) break;
+    }
+    if (!ended && !do_unlink && myExecutor.StillRunning())
+    {
+        esyslogs(source,"binary stream ended without end record");
+        lerr=PARSE_XMLTVERR;
+    }
+
+    for (size_t i=0; i<strings.size(); i++) free(strings[i]);
+    Finish(db,skipped,lerr,do_unlink,parsestart);
+    return 0;
 }
 
 int cParse::Process(cEPGExecutor &myExecutor,char *buffer, int bufsize)
@@ -907,10 +1588,19 @@ int cParse::Process(cEPGExecutor &myExecutor,char *buffer, int bufsize)
     if (!buffer) return 134;
     if (!bufsize) return 134;
 
+    cEPGSourceStats *stats=source->Stats();
+    uint64_t parsestart=cEPGSourceStats::Now();
+    if ((bufsize>=XTVB_HEADERSIZE) && (!memcmp(buffer,XTVB_MAGIC,4)))
+    {
+        dsyslogs(source,"parsing binary output");
+        return ProcessBinary(myExecutor,buffer,bufsize,parsestart);
+    }
+
     dsyslogs(source,"parsing output");
 
     xmlDocPtr xmltv;
     xmltv=xmlReadMemory(buffer,bufsize,NULL,NULL,0);
+    stats->xml=cEPGSourceStats::Now()-parsestart;
     if (!xmltv)
     {
         esyslogs(source,"failed to parse xmltv");
@@ -926,34 +1616,8 @@ int cParse::Process(cEPGExecutor &myExecutor,char *buffer, int bufsize)
     }
 
     sqlite3 *db=NULL;
-    if (sqlite3_open(g->EPGFile(),&db)!=SQLITE_OK)
+    if (!OpenDB(&db))
     {
-        esyslogs(source,"failed to open or create %s",g->EPGFile());
-        xmlFreeDoc(xmltv);
-        return 141;
-    }
-
-    char sql[]="CREATE TABLE IF NOT EXISTS epg (" \
-               "src nvarchar(100), channelid nvarchar(255), eventid int, eiteventid int, "\
-               "starttime datetime, duration int, title nvarchar(255), alttitle nvarchar(255), "\
-               "origtitle nvarchar(255), shorttext nvarchar(255), description text, "\
-               "eitdescription text, country nvarchar(255), year int, " \
-               "credits text, category text, review text, rating text, " \
-               "starrating text, video text, audio text, season int, episode int, " \
-               "episodeoverall int, pics text, srcidx int," \
-               "PRIMARY KEY(eventid, src, channelid)" \
-               ");" \
-               "CREATE INDEX IF NOT EXISTS idx1 on epg (starttime, eiteventid, channelid); " \
-               "CREATE INDEX IF NOT EXISTS idx2 on epg (starttime, title, channelid); " \
-               "CREATE INDEX IF NOT EXISTS idx3 on epg (starttime, duration, src); " \
-               "BEGIN";
-
-    char *errmsg;
-    if (sqlite3_exec(db,sql,NULL,NULL,&errmsg)!=SQLITE_OK)
-    {
-        esyslogs(source,"createdb: %s",errmsg);
-        sqlite3_free(errmsg);
-        sqlite3_close(db);
         xmlFreeDoc(xmltv);
         return 141;
     }
@@ -1008,6 +1672,7 @@ int cParse::Process(cEPGExecutor &myExecutor,char *buffer, int bufsize)
         time_t starttime=(time_t) 0;
         time_t stoptime=(time_t) 0;
         start=xmlGetProp(node,(const xmlChar *) "start");
+        uint64_t convstart=cEPGSourceStats::Now();
         if (start)
         {
             starttime=ConvertXMLTVTime2UnixTime((char *) start);
@@ -1020,6 +1685,7 @@ int cParse::Process(cEPGExecutor &myExecutor,char *buffer, int bufsize)
                 }
             }
         }
+        stats->timeconv+=cEPGSourceStats::Now()-convstart;
 
         if (!starttime)
         {
@@ -1061,7 +1727,7 @@ int cParse::Process(cEPGExecutor &myExecutor,char *buffer, int bufsize)
         if (start) xmlFree(start);
         if (stop) xmlFree(stop);
 
-        if (!FetchEvent(node,(map->Flags() & OPT_SEASON_STEXTITLE)==OPT_SEASON_STEXTITLE)) // sets xevent
+        if (!FetchEvent(node)) // sets xevent
         {
             if (lerr!=PARSE_FETCHERR)
                 esyslogs(source,"failed to fetch event");
@@ -1076,63 +1742,7 @@ int cParse::Process(cEPGExecutor &myExecutor,char *buffer, int bufsize)
             esyslogs(source,"%s",xmlerr->message);
         }
 
-        if (!xevent.EventID())
-        {
-            if (lweak!=PARSE_NOEVENTID)
-                isyslogs(source,"event without id, using starttime as id (weak)!");
-            lweak=PARSE_NOEVENTID;
-            xevent.CreateEventID(xevent.StartTime());
-        }
-
-        for (int i=0; i<map->NumChannelIDs(); i++)
-        {
-            char *isql,*usql;
-            xevent.GetSQL(source->Name(),source->Index(),map->ChannelIDs()[i].ToString(),&isql,&usql);
-            if (isql && usql)
-            {
-                int ret=sqlite3_exec(db,isql,NULL,NULL,&errmsg);
-                if (ret!=SQLITE_OK)
-                {
-                    bool update_issued=false;
-                    if (ret==SQLITE_CONSTRAINT)
-                    {
-                        sqlite3_free(errmsg);
-                        ret=sqlite3_exec(db,usql,NULL,NULL,&errmsg);
-                        update_issued=true;
-                    }
-                    if (ret!=SQLITE_OK)
-                    {
-                        if (lerr!=PARSE_SQLERR)
-                        {
-                            if (strstr(errmsg,"has no column named"))
-                            {
-                                esyslogs(source,"sqlite3: database schema changed, unlinking epg.db!");
-                                do_unlink=true;
-                            }
-                            else
-                            {
-                                if (!xevent.WeakID())
-                                {
-                                    esyslogs(source,"sqlite3: %s (%u@%i)",errmsg,xevent.EventID(),node->line);
-                                    tsyslogs(source,"sqlite3: %s",isql);
-                                    if (update_issued) tsyslogs(source,"sqlite3: %s",usql);
-                                }
-                                else
-                                {
-                                    esyslogs(source,"sqlite3: %s ('%s'@%i)",errmsg,xevent.Title(),node->line);
-                                    tsyslogs(source,"sqlite3: %s",isql);
-                                    if (update_issued) tsyslogs(source,"sqlite3: %s",usql);
-                                }
-                            }
-                        }
-                        lerr=PARSE_SQLERR;
-                        sqlite3_free(errmsg);
-                        skipped++;
-                        break;
-                    }
-                }
-            }
-        }
+        if (!Store(db,map,lerr,lweak,node->line,do_unlink)) skipped++;
         node=node->next;
         if (!myExecutor.StillRunning())
         {
@@ -1142,38 +1752,8 @@ int cParse::Process(cEPGExecutor &myExecutor,char *buffer, int bufsize)
         if (do_unlink) break;
     }
 
-    if (sqlite3_exec(db,"COMMIT",NULL,NULL,&errmsg)!=SQLITE_OK)
-    {
-        esyslogs(source,"sqlite3: COMMIT %s",errmsg);
-        sqlite3_free(errmsg);
-    }
-
-    int cnt=sqlite3_total_changes(db);
-
-    if ((skipped) && (!do_unlink))
-        isyslogs(source,"skipped %i xmltv events",skipped);
-
-    if (!lerr)
-    {
-        isyslogs(source,"processed %i xmltv events",cnt);
-    }
-    else
-    {
-        isyslogs(source,"processed %i xmltv events - see ERRORs above!",cnt);
-    }
-
-    if (sqlite3_exec(db,"ANALYZE epg;",NULL,NULL,&errmsg)!=SQLITE_OK)
-    {
-        esyslogs(source,"sqlite3: ANALYZE %s",errmsg);
-        sqlite3_free(errmsg);
-    }
-
-    sqlite3_close(db);
-
     xmlFreeDoc(xmltv);
-
-    if (do_unlink) unlink(g->EPGFile());
-
+    Finish(db,skipped,lerr,do_unlink,parsestart);
     return 0;
 }
 
@@ -1191,20 +1771,11 @@ cParse::cParse(cEPGSource *Source, cGlobals *Global)
 {
     source=Source;
     g=Global;
-    if (g->EPDir())
-    {
-        cep2ascii=iconv_open("ASCII//TRANSLIT",g->EPCodeset());
-        cutf2ascii=iconv_open("ASCII//TRANSLIT","UTF-8");
-    }
-    else
-    {
-        cep2ascii=(iconv_t) -1;
-        cutf2ascii=(iconv_t) -1;
-    }
+    batchchanges=0;
+    findstmt=NULL;
+    dropped=0;
 }
 
 cParse::~cParse()
 {
-    if (cep2ascii!=(iconv_t) -1) iconv_close(cep2ascii);
-    if (cutf2ascii!=(iconv_t) -1) iconv_close(cutf2ascii);
 }
@@ -10,7 +10,12 @@
 
 #include <vdr/epg.h>
 #include <libxml/parser.h>
+#include <sqlite3.h>
+#include <stdint.h>
+#include <limits.h>
 #include <time.h>
+#include <map>
+#include <set>
 
 #include "maps.h"
 #include "event.h"
@@ -35,16 +40,33 @@ class cParse
 
 private:
     cGlobals *g;  
-    iconv_t cep2ascii;
-    iconv_t cutf2ascii;
     cEPGSource *source;
     cXMLTVEvent xevent;
-    time_t ConvertXMLTVTime2UnixTime(char *xmltvtime);
-    bool FetchEvent(xmlNodePtr node, bool useeptext);
+    std::set<int> days; // existing partitions
+    std::set<int> ftsdays; // partitions with a full text index
+    std::map<int,sqlite3_stmt *> linkstmts,movestmts,sigstmts,seqstmts,ftsstmts;
+    sqlite3_stmt *findstmt; // other days holding the event, see Store
+    int dropped; // see cEPGDatabase::Dropped
+    int batchchanges;
+    cTimeMs batchtime;
+    void CommitBatch(sqlite3 *db);
+    bool Mapped(const char *XMLTVID, const char *ChannelID);
+    void RemoveStaleLinks(sqlite3 *db);
+    static unsigned int Signature(const char *SQL);
+    sqlite3_stmt *DayStatement(sqlite3 *db, std::map<int,sqlite3_stmt *> &stmts, const char *sql, int day);
+    static void FinalizeStatements(std::map<int,sqlite3_stmt *> &stmts, int Before);
+    void FinalizeStatements(int Before=INT_MAX);
+    bool FetchEvent(xmlNodePtr node);
+    void FetchBinaryField(int tag, const char *a, const char *b, uint32_t va);
+    bool OpenDB(sqlite3 **db);
+    bool Store(sqlite3 *db, cEPGMapping *map, int &lerr, int &lweak, int line, bool &do_unlink);
+    void Finish(sqlite3 *db, int skipped, int lerr, bool do_unlink, uint64_t parsestart);
+    int ProcessBinary(cEPGExecutor &myExecutor, char *buffer, int bufsize, uint64_t parsestart);
 public:
     cParse(cEPGSource *Source, cGlobals *Global);
     ~cParse();
     int Process(cEPGExecutor &myExecutor, char *buffer, int bufsize);
+    static time_t ConvertXMLTVTime2UnixTime(char *xmltvtime);
     static void RemoveNonAlphaNumeric(char *String, bool InDescription=false);
     static bool FetchSeasonEpisode(iconv_t cEP2ASCII, iconv_t cUTF2ASCII, const char *EPDir,
                                    const char *Title, const char *ShortText, const char *Description,
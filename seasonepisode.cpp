@@ -0,0 +1,310 @@
+/*
+ * seasonepisode.cpp: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#include <stdio.h>
+#include <dirent.h>
+#include <iconv.h>
+#include <sys/stat.h>
+
+#include "xmltv2vdr.h"
+#include "debug.h"
+
+cEPGSeasonEpisode::cEPGSeasonEpisode(cGlobals *Global): cThread("xmltv2vdr seasonepisode")
+{
+    g=Global;
+    pending=false;
+    busy=false;
+    lastrun=(time_t) 0;
+    checked=hits=misses=0;
+    duration=0;
+}
+
+cString cEPGSeasonEpisode::Stats()
+{
+    return cString::sprintf("seasonepisode lastrun=%li rows=%i hits=%i misses=%i ms=%llu",(long) lastrun,
+                            checked,hits,misses,(unsigned long long) duration/1000);
+}
+
+void cEPGSeasonEpisode::Trigger()
+{
+    if (!g->EPDir()) return;
+    mutex.Lock();
+    pending=true;
+    changed.Broadcast();
+    mutex.Unlock();
+    Start();
+}
+
+bool cEPGSeasonEpisode::WaitIdle(int TimeoutMs)
+{
+    cMutexLock lock(&mutex);
+    if ((pending || busy) && Running()) changed.TimedWait(mutex,TimeoutMs);
+    return !(pending || busy) || !Running();
+}
+
+void cEPGSeasonEpisode::Stop()
+{
+    Cancel(-1);
+    mutex.Lock();
+    changed.Broadcast();
+    mutex.Unlock();
+    Cancel(3);
+}
+
+time_t cEPGSeasonEpisode::EPListTime()
+{
+    // newest change in the eplists directory (added, removed or changed files)
+    struct stat statbuf;
+    if (stat(g->EPDir(),&statbuf)==-1) return (time_t) 0;
+    time_t newest=statbuf.st_mtime;
+    if (statbuf.st_ctime>newest) newest=statbuf.st_ctime;
+
+    DIR *dir=opendir(g->EPDir());
+    if (!dir) return newest;
+    struct dirent *dirent;
+    while ((dirent=readdir(dir)))
+    {
+        if (dirent->d_name[0]=='.') continue;
+        char *path=NULL;
+        if (asprintf(&path,"%s/%s",g->EPDir(),dirent->d_name)==-1) continue;
+        if (stat(path,&statbuf)!=-1)
+        {
+            if (statbuf.st_mtime>newest) newest=statbuf.st_mtime;
+            if (statbuf.st_ctime>newest) newest=statbuf.st_ctime;
+        }
+        free(path);
+    }
+    closedir(dir);
+    return newest;
+}
+
+int cEPGSeasonEpisode::Process(sqlite3 *Db, time_t Changed, iconv_t cEP2ASCII, iconv_t cUTF2ASCII)
+{
+    // finished days are skipped, rowids are per day partition
+    std::vector<int> days;
+    if (!cEPGDatabase::Days(Db,days)) return -1;
+    int yesterday=cEPGDatabase::Day(time(NULL))-1;
+    int cnt=0;
+    for (size_t i=0; (i<days.size()) && Running(); i++)
+    {
+        if (days[i]<yesterday) continue;
+        int ret=ProcessDay(Db,days[i],Changed,cEP2ASCII,cUTF2ASCII);
+        if (ret<0) return ret;
+        cnt+=ret;
+    }
+    return cnt;
+}
+
+int cEPGSeasonEpisode::ProcessDay(sqlite3 *Db, int Day, time_t Changed, iconv_t cEP2ASCII, iconv_t cUTF2ASCII)
+{
+    // rows which are new/updated from xmltv (epcheck=0) or checked before the last eplist change
+    cString sql_select=cString::sprintf("select rowid,xmltvid,title,shorttext," EPGUNZ("description") \
+                                        ",season,episode from epgevents_%i where rowid>?1 and epcheck<?2 " \
+                                        "and starttime+duration>=?3 order by rowid limit ?4;",Day);
+    cString sql_update=cString::sprintf("update epgevents_%i set season=?1, episode=?2, episodeoverall=?3, " \
+                                        "shorttext=ifnull(?4,shorttext), alttitle=ifnull(?5,alttitle), epcheck=?6, " \
+                                        "changeseq=(select seq from epgseq) where rowid=?7;",Day);
+    cString sql_check=cString::sprintf("update epgevents_%i set epcheck=?1 where rowid=?2;",Day);
+    // a new shorttext goes into the full text index, the description is already uncompressed
+    cString sql_fts=cString::sprintf(EPGDB_FTSINDEX "select rowid,title,shorttext,?2," EPGUNZ("credits") \
+                                     ",category from epgevents_%1$i where rowid=?1;",Day);
+
+    sqlite3_stmt *sel=NULL,*upd=NULL,*chk=NULL,*fts=NULL;
+    if ((sqlite3_prepare_v2(Db,sql_select,-1,&sel,NULL)!=SQLITE_OK) ||
+            (sqlite3_prepare_v2(Db,sql_update,-1,&upd,NULL)!=SQLITE_OK) ||
+            (sqlite3_prepare_v2(Db,sql_check,-1,&chk,NULL)!=SQLITE_OK))
+    {
+        esyslog("sqlite3: %s (seasonepisode)",sqlite3_errmsg(Db));
+        sqlite3_finalize(sel);
+        sqlite3_finalize(upd);
+        sqlite3_finalize(chk);
+        return -1;
+    }
+    // days without full text index have no statement
+    if (!cEPGDatabase::FullTextAvailable() || (sqlite3_prepare_v2(Db,sql_fts,-1,&fts,NULL)!=SQLITE_OK)) fts=NULL;
+
+    time_t now=time(NULL);
+    time_t stamp=(Changed>now) ? Changed : now;
+    sqlite3_int64 lastrowid=0;
+    int cnt=0;
+    while (Running())
+    {
+        std::vector<cSeasonEpisodeRow> rows;
+        sqlite3_bind_int64(sel,1,lastrowid);
+        sqlite3_bind_int64(sel,2,Changed);
+        sqlite3_bind_int64(sel,3,now);
+        sqlite3_bind_int(sel,4,SEASONEPISODE_BATCH);
+        int ret;
+        while ((ret=sqlite3_step(sel))==SQLITE_ROW)
+        {
+            cSeasonEpisodeRow row;
+            row.rowid=sqlite3_column_int64(sel,0);
+            for (int i=1; i<=4; i++)
+            {
+                const char *val=(const char *) sqlite3_column_text(sel,i);
+                row.text[i-1]=val ? val : "";
+                row.isnull[i-1]=(val==NULL);
+            }
+            row.season=sqlite3_column_int(sel,5);
+            row.episode=sqlite3_column_int(sel,6);
+            rows.push_back(row);
+        }
+        if (ret!=SQLITE_DONE) esyslog("sqlite3: %s (seasonepisode)",sqlite3_errmsg(Db));
+        sqlite3_reset(sel);
+        if (rows.empty()) break;
+
+        if (sqlite3_exec(Db,"BEGIN",NULL,NULL,NULL)!=SQLITE_OK)
+        {
+            esyslog("sqlite3: %s (seasonepisode)",sqlite3_errmsg(Db));
+            break;
+        }
+        for (size_t r=0; r<rows.size(); r++)
+        {
+            cSeasonEpisodeRow &row=rows[r];
+            lastrowid=row.rowid;
+            if (row.isnull[1]) continue;
+
+            bool useeptext=false;
+            // events from eit use the vdr channel as xmltvid
+            cEPGMapping *map=g->EPGMappings()->GetMap(row.text[0].c_str());
+            if (!map) map=g->EPGMappings()->GetMap(tChannelID::FromString(row.text[0].c_str()));
+            if (map) useeptext=((map->Flags() & OPT_SEASON_STEXTITLE)==OPT_SEASON_STEXTITLE);
+
+            int season=row.season,episode=row.episode,episodeoverall=0;
+            char *epshorttext=NULL,*eptitle=NULL;
+            bool found=cParse::FetchSeasonEpisode(cEP2ASCII,cUTF2ASCII,g->EPDir(),row.text[1].c_str(),
+                                                  row.isnull[2] ? NULL : row.text[2].c_str(),
+                                                  row.isnull[3] ? NULL : row.text[3].c_str(),
+                                                  season,episode,episodeoverall,&epshorttext,&eptitle);
+            checked++;
+            if (found)
+            {
+                hits++;
+            }
+            else
+            {
+                misses++;
+            }
+            if (!useeptext)
+            {
+                if (epshorttext) free(epshorttext);
+                if (eptitle) free(eptitle);
+                epshorttext=eptitle=NULL;
+            }
+            sqlite3_stmt *stmt=chk;
+            if (found || eptitle)
+            {
+                if (!found)
+                {
+                    season=row.season;
+                    episode=row.episode;
+                    episodeoverall=0;
+                    if (epshorttext) free(epshorttext);
+                    epshorttext=NULL;
+                }
+                stmt=upd;
+                sqlite3_bind_int(stmt,1,season);
+                sqlite3_bind_int(stmt,2,episode);
+                sqlite3_bind_int(stmt,3,episodeoverall);
+                if (epshorttext) sqlite3_bind_text(stmt,4,epshorttext,-1,SQLITE_TRANSIENT);
+                if (eptitle) sqlite3_bind_text(stmt,5,eptitle,-1,SQLITE_TRANSIENT);
+                sqlite3_bind_int64(stmt,6,stamp);
+                sqlite3_bind_int64(stmt,7,row.rowid);
+                cnt++;
+            }
+            else
+            {
+                sqlite3_bind_int64(stmt,1,stamp);
+                sqlite3_bind_int64(stmt,2,row.rowid);
+            }
+            bool reindex=(fts && (stmt==upd) && epshorttext &&
+                          (row.isnull[2] || strcmp(epshorttext,row.text[2].c_str())));
+            if (epshorttext) free(epshorttext);
+            if (eptitle) free(eptitle);
+            if (sqlite3_step(stmt)!=SQLITE_DONE)
+            {
+                esyslog("sqlite3: %s (seasonepisode)",sqlite3_errmsg(Db));
+                reindex=false;
+            }
+            sqlite3_reset(stmt);
+            sqlite3_clear_bindings(stmt);
+            if (reindex)
+            {
+                sqlite3_bind_int64(fts,1,row.rowid);
+                if (!row.isnull[3]) sqlite3_bind_text(fts,2,row.text[3].c_str(),-1,SQLITE_STATIC);
+                if (sqlite3_step(fts)!=SQLITE_DONE) tsyslog("sqlite3: %s (seasonepisode fulltext)",sqlite3_errmsg(Db));
+                sqlite3_reset(fts);
+                sqlite3_clear_bindings(fts);
+            }
+        }
+        if (sqlite3_exec(Db,"COMMIT",NULL,NULL,NULL)!=SQLITE_OK)
+        {
+            esyslog("sqlite3: %s (seasonepisode)",sqlite3_errmsg(Db));
+            sqlite3_exec(Db,"ROLLBACK",NULL,NULL,NULL);
+            break;
+        }
+        // give the epg handler and the import a chance to get the write lock
+        cCondWait::SleepMs(SEASONEPISODE_PAUSE);
+    }
+    sqlite3_finalize(sel);
+    sqlite3_finalize(upd);
+    sqlite3_finalize(chk);
+    sqlite3_finalize(fts);
+    return cnt;
+}
+
+void cEPGSeasonEpisode::Action()
+{
+    SetPriority(19);
+    iconv_t cep2ascii=iconv_open("ASCII//TRANSLIT",g->EPCodeset());
+    iconv_t cutf2ascii=iconv_open("ASCII//TRANSLIT","UTF-8");
+    if ((cep2ascii==(iconv_t) -1) || (cutf2ascii==(iconv_t) -1))
+    {
+        esyslog("failed to open iconv for eplists");
+        if (cep2ascii!=(iconv_t) -1) iconv_close(cep2ascii);
+        if (cutf2ascii!=(iconv_t) -1) iconv_close(cutf2ascii);
+        return;
+    }
+    while (Running())
+    {
+        // the thread stays, WaitIdle() is woken when the rows are done
+        mutex.Lock();
+        busy=false;
+        changed.Broadcast();
+        while (!pending && Running()) changed.Wait(mutex);
+        bool run=pending;
+        pending=false;
+        busy=run;
+        mutex.Unlock();
+        if (!run) continue;
+        if (!g->DBExists()) continue;
+
+        sqlite3 *db=NULL;
+        if (!g->EPGDatabase()->Open(&db))
+        {
+            esyslog("failed to open %s",g->EPGFile());
+            continue;
+        }
+        lastrun=time(NULL);
+        checked=hits=misses=0;
+        uint64_t start=cEPGSourceStats::Now();
+        int cnt=Process(db,EPListTime(),cep2ascii,cutf2ascii);
+        duration=cEPGSourceStats::Now()-start;
+        sqlite3_close(db);
+        if (cnt>0)
+        {
+            isyslog("updated season/episode of %i events",cnt);
+            g->XMLTVCache()->Refresh();
+        }
+    }
+    mutex.Lock();
+    busy=false;
+    changed.Broadcast();
+    mutex.Unlock();
+    iconv_close(cep2ascii);
+    iconv_close(cutf2ascii);
+}
@@ -0,0 +1,94 @@
+/*
+ * services.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef _XMLTV2VDR_SERVICES_H
+#define _XMLTV2VDR_SERVICES_H
+
+/*
+ * Service interface for other plugins, include this file to get the xmltv
+ * data of VDR events as structured fields:
+ *
+ *   cPlugin *p=cPluginManager::GetPlugin("xmltv2vdr");
+ *   XMLTV2VDR_GetEventInfo_v1_0 req;
+ *   req.channelID=Event->ChannelID();
+ *   req.eventID=Event->EventID();
+ *   if (p && p->Service(XMLTV2VDR_GETEVENTINFO,&req) && req.found) ...
+ *
+ * Events of the next hours are answered from memory, all others with one
+ * query. Events not (yet) imported into VDR are not found.
+ */
+
+#include <time.h>
+#include <vdr/channels.h>
+#include <vdr/epg.h>
+#include <vdr/tools.h>
+
+#define XMLTV2VDR_GETEVENTINFO    "xmltv2vdr-GetEventInfo-v1.0"
+#define XMLTV2VDR_GETSCHEDULEINFO "xmltv2vdr-GetScheduleInfo-v1.0"
+
+class cXMLTV2VDREventInfo : public cListObject
+{
+public:
+    tEventID eventID;       // VDR event id
+    time_t startTime;
+    int duration;           // seconds
+    cString source;         // name of the epg source
+    cString title;
+    cString altTitle;
+    cString origTitle;
+    cString shortText;
+    cString description;    // xmltv description, without the added credits etc.
+    cString country;
+    cString audio;
+    int year;               // 0 = unknown
+    int season;             // 0 = unknown
+    int episode;            // 0 = unknown
+    int episodeOverall;     // 0 = unknown
+    cStringList credits;    // "type|name", type as in xmltv (director, actor, ...)
+    cStringList category;
+    cStringList review;
+    cStringList rating;     // "system|value"
+    cStringList starRating; // "system|value", system is "*" if not given
+    cStringList video;      // "type|value", type is colour, aspect or quality
+    cStringList pics;       // image files as given by the source
+    cXMLTV2VDREventInfo()
+    {
+        eventID=0;
+        startTime=0;
+        duration=year=season=episode=episodeOverall=0;
+    }
+    virtual int Compare(const cListObject &ListObject) const
+    {
+        const cXMLTV2VDREventInfo *o=(const cXMLTV2VDREventInfo *) &ListObject;
+        if (startTime!=o->startTime) return (startTime<o->startTime) ? -1 : 1;
+        return 0;
+    }
+};
+
+// one event of a channel
+struct XMLTV2VDR_GetEventInfo_v1_0
+{
+    // in
+    tChannelID channelID;
+    tEventID eventID;
+    // out
+    bool found;
+    cXMLTV2VDREventInfo info;
+};
+
+// all events of a channel starting within from..till, ordered by start time
+struct XMLTV2VDR_GetScheduleInfo_v1_0
+{
+    // in
+    tChannelID channelID;
+    time_t from;
+    time_t till;
+    // out
+    cList<cXMLTV2VDREventInfo> events;
+};
+
+#endif
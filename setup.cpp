@@ -19,25 +19,7 @@
 
 #define NewTitle(x) new cOsdItem(cString::sprintf("%s%s%s", "---- ",x," ----"),osUnknown,false)
 
-char *strcatrealloc(char *dest, const char *src)
-{
-    if (!src || !*src)
-        return dest;
-
-    size_t l = (dest ? strlen(dest) : 0) + strlen(src) + 1;
-    if (dest)
-    {
-        dest = (char *)realloc(dest, l);
-        strcat(dest, src);
-    }
-    else
-    {
-        dest = (char*)malloc(l);
-        strcpy(dest, src);
-    }
-    return dest;
-}
-
+extern char *strcatrealloc(char *, const char*);
 
 // --------------------------------------------------------------------------------------------------------
 
@@ -64,6 +46,7 @@ cMenuSetupXmltv2vdr::cMenuSetupXmltv2vdr(cGlobals *Global)
     sourcesBegin=sourcesEnd=mappingBegin=mappingEnd=mappingEntry=0;
     epall=g->EPAll();
     wakeup=g->WakeUp();
+    compress=g->Compress();
     imgdelafter=g->ImgDelAfter();
     if (imgdelafter<=6) imgdelafter=6;
     cs=NULL;
@@ -102,6 +85,9 @@ void cMenuSetupXmltv2vdr::Output(void)
         }
     }
     Add(new cMenuEditBoolItem(tr("automatic wakeup"),&wakeup),true);
+#ifdef USE_ZSTD
+    Add(new cMenuEditBoolItem(tr("compress epg texts"),&compress),true);
+#endif
     if (g->ImgDir())
     {
         Add(new cMenuEditIntItem(tr("delete pics after (days)"),&imgdelafter,6,365,tr("never")),true);
@@ -256,10 +242,13 @@ void cMenuSetupXmltv2vdr::Store(void)
     if (imgdelafter<=6) imgdelafter=0;
     SetupStore("options.epall",epall);
     SetupStore("options.wakeup",wakeup);
+    SetupStore("options.compress",compress);
     SetupStore("options.imgdelafter",imgdelafter);
     g->SetEPAll(epall);
     g->SetWakeUp((bool) wakeup);
+    g->SetCompress((bool) compress);
     g->SetImgDelAfter(imgdelafter);
+    g->SetupChanged();
 }
 
 eOSState cMenuSetupXmltv2vdr::edit()
@@ -532,6 +521,7 @@ void cMenuSetupXmltv2vdrTextMap::Store()
     savetval(season);
     savetval(episode);
     savetval(episodeoverall);
+    g->SetupChanged();
 
     SetupStore("textmap.country",country);
     SetupStore("textmap.year",year);
@@ -703,6 +693,7 @@ void cMenuSetupXmltv2vdrOrder::Store(void)
 {
     SetupStore("options.order",order);
     g->SetOrder(order);
+    g->SetupChanged();
 }
 
 // --------------------------------------------------------------------------------------------------------
@@ -1320,6 +1311,7 @@ void cMenuSetupXmltv2vdrChannelMap::epgmappingreplace(cEPGMapping *newmapping)
         map->ChangeFlags(newmapping->Flags());
         map->ReplaceChannels(newmapping->NumChannelIDs(),newmapping->ChannelIDs());
     }
+    g->SetupChanged();
 }
 
 void cMenuSetupXmltv2vdrChannelMap::Store()
@@ -43,6 +43,7 @@ private:
     void generatesumchannellist();
     unsigned int epall;
     int wakeup;
+    int compress;
     int imgdelafter;
 public:
     void Output(void);
@@ -13,6 +13,7 @@
 #include "xmltv2vdr.h"
 #include "source.h"
 #include "extpipe.h"
+#include "xtvb.h"
 #include "debug.h"
 
 cEPGChannel::cEPGChannel(const char *Name, bool InUse)
@@ -34,6 +35,49 @@ int cEPGChannel::Compare(const cListObject &ListObject) const
 
 // -------------------------------------------------------------
 
+cEPGSourceStats::cEPGSourceStats()
+{
+    lastrun=(time_t) 0;
+    Reset();
+}
+
+uint64_t cEPGSourceStats::Now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t) ts.tv_sec*1000000+ts.tv_nsec/1000;
+}
+
+void cEPGSourceStats::Reset()
+{
+    grabber=bytes=xml=parse=timeconv=parsesql=0;
+    inserted=updated=unchanged=skipped=0;
+    ResetImport();
+}
+
+void cEPGSourceStats::ResetImport()
+{
+    lockwait=lockhold=importsql=0;
+    rows=changed=eventsunchanged=piccreated=pickept=picremoved=0;
+}
+
+cString cEPGSourceStats::ToString(const char *Name)
+{
+    // one line of key=value pairs per source, times in milliseconds
+    return cString::sprintf("%s lastrun=%li grabber_ms=%llu bytes=%llu xml_ms=%llu parse_ms=%llu "
+                            "timeconv_ms=%llu parse_sql_ms=%llu inserted=%i updated=%i unchanged=%i skipped=%i "
+                            "lockwait_ms=%llu lockhold_ms=%llu import_sql_ms=%llu rows=%i changed=%i "
+                            "events_unchanged=%i pics_created=%i pics_kept=%i pics_removed=%i",
+                            Name,(long) lastrun,(unsigned long long) grabber/1000,(unsigned long long) bytes,
+                            (unsigned long long) xml/1000,(unsigned long long) parse/1000,
+                            (unsigned long long) timeconv/1000,(unsigned long long) parsesql/1000,
+                            inserted,updated,unchanged,skipped,(unsigned long long) lockwait/1000,
+                            (unsigned long long) lockhold/1000,(unsigned long long) importsql/1000,
+                            rows,changed,eventsunchanged,piccreated,pickept,picremoved);
+}
+
+// -------------------------------------------------------------
+
 cEPGExecutor::cEPGExecutor(cEPGSources *Sources) : cThread("xmltv2vdr importer")
 {
     sources=Sources;
@@ -137,6 +181,7 @@ cEPGSource::cEPGSource(const char *Name, cGlobals *Global)
     Log=NULL;
     loglen=0;
     usepipe=false;
+    usebinary=false;
     needpin=false;
     running=false;
     haspics=usepics=false;
@@ -286,6 +331,18 @@ bool cEPGSource::ReadConfig()
                     {
                         *pics=0;
                         pics++;
+                        char *format=strchr(pics,';');
+                        if (format)
+                        {
+                            *format=0;
+                            format++;
+                            format=compactspace(format);
+                            if (!strcmp(format,XTVB_FORMAT))
+                            {
+                                dsyslogs(this,"is providing binary data");
+                                usebinary=true;
+                            }
+                        }
                         pics=compactspace(pics);
                         if (pics[0]=='1')
                         {
@@ -459,7 +516,11 @@ int cEPGSource::ReadOutput(char *&result, size_t &l)
 
 int cEPGSource::Import(cEPGExecutor &myExecutor)
 {
-    return import->Process(this,myExecutor);
+    stats.ResetImport();
+    int ret=import->Process(this,myExecutor);
+    if (!stats.lastrun) stats.lastrun=time(NULL);
+    isyslogs(this,"%s",*stats.ToString("stats:"));
+    return ret;
 }
 
 int cEPGSource::Execute(cEPGExecutor &myExecutor)
@@ -478,9 +539,13 @@ int cEPGSource::Execute(cEPGExecutor &myExecutor)
         Log=NULL;
         loglen=0;
     }
+    stats.Reset();
+    stats.lastrun=time(NULL);
 
     char *cmd=NULL;
-    if (asprintf(&cmd,"%s %i '%s' %i ",name,daysinadvance,pin ? pin : "",usepics)==-1)
+    // ask for the binary format, if the source announced it
+    const char *format=(usepipe && usebinary) ? XTVB_ENV "=" XTVB_FORMAT " " : "";
+    if (asprintf(&cmd,"%s%s %i '%s' %i ",format,name,daysinadvance,pin ? pin : "",usepics)==-1)
     {
         esyslogs(this,"out of memory");
         return 134;
@@ -560,6 +625,7 @@ int cEPGSource::Execute(cEPGExecutor &myExecutor)
     free(cmd);
     dsyslogs(this,"executing epgsource");
     running=true;
+    uint64_t grabberstart=cEPGSourceStats::Now();
 
     int fdsopen=2;
     while (fdsopen>0)
@@ -648,6 +714,8 @@ int cEPGSource::Execute(cEPGExecutor &myExecutor)
     }
     if (r_out) r_out[l_out]=0;
     if (r_err) r_err[l_err]=0;
+    stats.grabber=cEPGSourceStats::Now()-grabberstart;
+    stats.bytes=l_out;
 
     if (r_err)
     {
@@ -701,6 +769,7 @@ int cEPGSource::Execute(cEPGExecutor &myExecutor)
                 ret=ReadOutput(result,l);
                 if ((!ret) && (result))
                 {
+                    stats.bytes=l;
                     ret=parse->Process(myExecutor,result,l);
                 }
                 if (result) free(result);
@@ -882,25 +951,24 @@ bool cEPGSources::MoveEPGSource(cGlobals *Global, int From, int To)
     if (From==To) return false;
 
     sqlite3 *db=NULL;
-    if (sqlite3_open_v2(Global->EPGFile(),&db,SQLITE_OPEN_READWRITE,NULL)==SQLITE_OK)
-    {
-        char *sql=NULL;
-        if (asprintf(&sql,"BEGIN TRANSACTION;" \
-                     "UPDATE epg SET srcidx=98 WHERE srcidx=%i;" \
-                     "UPDATE epg SET srcidx=%i WHERE srcidx=%i;" \
-                     "UPDATE epg SET srcidx=%i WHERE srcidx=98;" \
-                     "COMMIT;", To, From, To, From)==-1)
+    if (Global->EPGDatabase()->Open(&db))
+    {
+        std::vector<int> days;
+        cEPGDatabase::Days(db,days);
+        std::string sql="BEGIN TRANSACTION;";
+        for (size_t i=0; i<days.size(); i++)
         {
-            sqlite3_close(db);
-            return false;
+            sql+=*cString::sprintf("UPDATE epgevents_%1$i SET srcidx=98 WHERE srcidx=%2$i;" \
+                                   "UPDATE epgevents_%1$i SET srcidx=%2$i WHERE srcidx=%3$i;" \
+                                   "UPDATE epgevents_%1$i SET srcidx=%3$i WHERE srcidx=98;",days[i],To,From);
         }
-        if (sqlite3_exec(db,sql,NULL,NULL,NULL)!=SQLITE_OK)
+        sql+="COMMIT;";
+        if (sqlite3_exec(db,sql.c_str(),NULL,NULL,NULL)!=SQLITE_OK)
         {
-            free(sql);
+            sqlite3_exec(db,"ROLLBACK",NULL,NULL,NULL);
             sqlite3_close(db);
             return false;
         }
-        free(sql);
     }
     else
     {
@@ -908,6 +976,7 @@ bool cEPGSources::MoveEPGSource(cGlobals *Global, int From, int To)
     }
     sqlite3_close(db);
     Global->EPGSources()->Move(From,To);
+    Global->XMLTVCache()->Refresh();
     return true;
 }
 
@@ -8,6 +8,7 @@
 #ifndef __source_h
 #define __source_h
 
+#include <stdint.h>
 #include <vdr/tools.h>
 
 #include "maps.h"
@@ -47,6 +48,38 @@ class cEPGChannels : public cList<cEPGChannel> {};
 class cImport;
 class cGlobals;
 
+class cEPGSourceStats
+{
+public:
+    cEPGSourceStats();
+    static uint64_t Now(); // monotonic, microseconds
+    void Reset();
+    void ResetImport();
+    cString ToString(const char *Name);
+    time_t lastrun;
+    // download and parse, times in microseconds
+    uint64_t grabber;
+    uint64_t bytes;
+    uint64_t xml;
+    uint64_t parse;
+    uint64_t timeconv;
+    uint64_t parsesql;
+    int inserted;
+    int updated;
+    int unchanged; // stored again with the same content
+    int skipped;
+    // import
+    uint64_t lockwait;
+    uint64_t lockhold;
+    uint64_t importsql;
+    int rows;
+    int changed;
+    int eventsunchanged; // vdr event was up to date
+    int piccreated;
+    int pickept;
+    int picremoved;
+};
+
 class cEPGSource : public cListObject
 {
 private:
@@ -59,6 +92,7 @@ private:
     cImport *import;
     bool ready2parse;
     bool usepipe;
+    bool usebinary;
     bool needpin;
     bool running;
     bool disabled;
@@ -72,6 +106,7 @@ private:
     bool ReadConfig();
     int ReadOutput(char *&result, size_t &l);
     cEPGChannels channels;
+    cEPGSourceStats stats;
 public:
     cEPGSource(const char *Name, cGlobals *Global);
     ~cEPGSource();
@@ -102,6 +137,10 @@ public:
     {
         return &channels;
     }
+    cEPGSourceStats *Stats()
+    {
+        return &stats;
+    }
     int LastRetCode()
     {
         return lastretcode;
@@ -195,6 +234,10 @@ public:
     {
         return Running();
     }
+    bool ForcedImport()
+    {
+        return (forceimportsrc>=0);
+    }
     void Stop()
     {
         Cancel(3);
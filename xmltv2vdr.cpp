@@ -6,594 +6,235 @@
  */
 
 #include <vdr/plugin.h>
-#include <vdr/videodir.h>
 #include <unistd.h>
 #include <getopt.h>
 #include <stdarg.h>
-#include <locale.h>
-#include <langinfo.h>
 #include <sqlite3.h>
 #include <time.h>
 #include <sys/types.h>
-#include <pwd.h>
-#include <netdb.h>
-#include <libgen.h>
-#include <sys/vfs.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <dirent.h>
 
 #include "setup.h"
 #include "xmltv2vdr.h"
 #include "debug.h"
 
-int ioprio_set(int which, int who, int ioprio)
-{
-#if defined(__i386__)
-#define __NR_ioprio_set  289
-#elif defined(__ppc__)
-#define __NR_ioprio_set  273
-#elif defined(__x86_64__)
-#define __NR_ioprio_set  251
-#elif defined(__ia64__)
-#define __NR_ioprio_set  1274
-#else
-#define __NR_ioprio_set  0
-#endif
-    if (__NR_ioprio_set)
-    {
-        return syscall(__NR_ioprio_set, which, who, ioprio);
-    }
-    else
-    {
-        return 0; // just do nothing
-    }
-}
-
-char *logfile=NULL;
-
-void logger(cEPGSource *source, char logtype, const char* format, ...)
-{
-    va_list ap;
-    char fmt[255];
-    if (source && logtype!='T')
-    {
-        if (logtype=='E')
-        {
-            if (snprintf(fmt,sizeof(fmt),"xmltv2vdr: '%s' ERROR %s",source->Name(),format)==-1) return;
-        }
-        else
-        {
-            if (snprintf(fmt,sizeof(fmt),"xmltv2vdr: '%s' %s",source->Name(),format)==-1) return;
-        }
-    }
-    else
-    {
-        if (logtype=='E')
-        {
-            snprintf(fmt,sizeof(fmt),"xmltv2vdr: ERROR %s",format);
-        }
-        else
-        {
-            snprintf(fmt,sizeof(fmt),"xmltv2vdr: %s",format);
-        }
-    }
-
-    va_start(ap, format);
-    char *ptr;
-    if (vasprintf(&ptr,fmt,ap)==-1) return;
-    va_end(ap);
-
-    struct tm tm;
-    if (logfile || source)
-    {
-        time_t now=time(NULL);
-        localtime_r(&now,&tm);
-    }
-
-    char *crlf=strchr(ptr,'\n');
-    if (crlf) *crlf=0;
-    crlf=strchr(ptr,'\r');
-    if (crlf) *crlf=0;
-
-    if (source && logtype!='T')
-    {
-        source->Add2Log(&tm,logtype,ptr);
-    }
-
-    if (logfile)
-    {
-        char dt[30];
-        strftime(dt,sizeof(dt)-1,"%b %d %H:%M:%S",&tm);
-
-        FILE *l=fopen(logfile,"a+");
-        if (l)
-        {
-            fprintf(l,"%s [%i] %s\n",dt,cThread::ThreadId(),ptr);
-            fclose(l);
-        }
-    }
-    switch (logtype)
-    {
-    case 'E':
-        if (SysLogLevel>0) syslog_with_tid(LOG_ERR,"%s",ptr);
-        break;
-    case 'I':
-        if (SysLogLevel>1) syslog_with_tid(LOG_ERR,"%s",ptr);
-        break;
-    case 'D':
-        if (SysLogLevel>2) syslog_with_tid(LOG_ERR,"%s",ptr);
-        break;
-    default:
-        break;
-    }
-
-    free(ptr);
-}
-
 // -------------------------------------------------------------
 
-bool cSVDRPMsg::readreply(int fd)
+static const char *latencynames[LATENCY_COUNT]=
 {
-    usleep(400000);
-    char c=' ';
-    do
-    {
-        struct pollfd fds;
-        fds.fd=fd;
-        fds.events=POLLIN;
-        fds.revents=0;
-        int ret=poll(&fds,1,600);
-
-        if (ret<=0) return false;
-        if (fds.revents!=POLLIN) return false;
-        if (read(fd,&c,1)<0) return false;
-    }
-    while (c!='\n');
-    return true;
-}
+    "IgnoreChannel","SetDescription","HandleEvent","SortSchedule"
+};
 
-bool cSVDRPMsg::Send(const char *format, ...)
+cEPGLatency::cEPGLatency()
 {
-    char *msg;
-    va_list ap;
-    va_start(ap, format);
-    if (vasprintf(&msg,format,ap)==-1) return false;
-    va_end(ap);
-
-    int port;
-    struct servent *serv=getservbyname("svdrp","tcp");
-    if (serv)
-    {
-        port=htons(serv->s_port);
-    }
-    else
-    {
-#if VDRVERSNUM < 10715
-        port=2001;
-#else
-        port=6419;
-#endif
-    }
-
-    struct sockaddr_in name;
-    name.sin_family = AF_INET;
-    name.sin_port = htons(port);
-    name.sin_addr.s_addr=inet_addr("127.0.0.1");
-    uint size = sizeof(name);
-
-    int sock;
-    sock=socket(PF_INET, SOCK_STREAM, 0);
-    if (sock<0) return false;
-
-    if (connect(sock, (struct sockaddr *)&name,size)!=0)
-    {
-        close(sock);
-        free(msg);
-        return false;
-    }
-
-    if (!readreply(sock))
-    {
-        close(sock);
-        free(msg);
-        return false;
-    }
-
-    ssize_t ret;
-    ret=write(sock,"PLUG epgsearch ",15);
-    if (ret!=(ssize_t)-1) ret=write(sock,msg,strlen(msg));
-    if (ret!=(ssize_t)-1) ret=write(sock,"\r\n",2);
-
-    if (!readreply(sock) || (ret==(ssize_t)-1))
-    {
-        close(sock);
-        free(msg);
-        return false;
-    }
-
-    ret=write(sock,"QUIT\r\n",6);
-
-    if (ret!=(ssize_t)-1) readreply(sock);
-    close(sock);
-    free(msg);
-    return true;
+    Reset();
 }
 
-// -------------------------------------------------------------
-
-cEPGSearch_Client::cEPGSearch_Client()
+uint64_t cEPGLatency::Now()
 {
-    plugin=cPluginManager::GetPlugin("epgsearch");
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC,&ts);
+    return (uint64_t) ts.tv_sec*1000000000ULL+ts.tv_nsec;
 }
 
-bool cEPGSearch_Client::EnableSearchTimer()
+void cEPGLatency::Reset()
 {
-    if (!plugin) return false;
-    Epgsearch_enablesearchtimers_v1_0 serviceData;
-    serviceData.enable = true;
-    if (!plugin->Service("Epgsearch-enablesearchtimers-v1.0", (void*) &serviceData))
-    {
-        // SVDRP fallback
-        cSVDRPMsg msg;
-        if (!msg.Send("SETS ON")) return false;
-    }
-    return true;
+    cMutexLock lock(&mutex);
+    memset(buckets,0,sizeof(buckets));
+    count=total=max=0;
 }
 
-bool cEPGSearch_Client::DisableSearchTimer()
+void cEPGLatency::Add(uint64_t Ns)
 {
-    if (!plugin) return false;
-    Epgsearch_enablesearchtimers_v1_0 serviceData;
-    serviceData.enable = false;
-    if (!plugin->Service("Epgsearch-enablesearchtimers-v1.0", (void*) &serviceData))
-    {
-        // SVDRP fallback
-        cSVDRPMsg msg;
-        if (!msg.Send("SETS OFF")) return false;
-    }
-    return true;
+    int bucket=0;
+    while ((bucket<LATENCY_BUCKETS-1) && (Ns>=(2ULL<<bucket))) bucket++;
+    cMutexLock lock(&mutex);
+    buckets[bucket]++;
+    count++;
+    total+=Ns;
+    if (Ns>max) max=Ns;
 }
 
-// -------------------------------------------------------------
-
-cGlobals::cGlobals()
+uint64_t cEPGLatency::Percentile(int Percent)
 {
-    confdir=NULL;
-    epgfile_store=NULL;
-    epgfiledir=NULL;
-    epgfile=NULL;
-    epdir=NULL;
-    epcodeset=NULL;
-    imgdir=NULL;
-    codeset=NULL;
-    srcorder=NULL;
-    wakeup=false;
-    epghandler=NULL;
-    epgtimer=NULL;
-    epgseasonepisode=NULL;
-    epall=0;
-    order=strdup(GetDefaultOrder());
-    imgdelafter=30;
-    soundex=false;
-
-#if APIVERSNUM > 20101
-    if (asprintf(&epgfile_store,"%s/epg.db",cVideoDirectory::Name())==-1) {};
-#else
-    if (asprintf(&epgfile_store,"%s/epg.db",VideoDirectory)==-1) {};
-#endif
-
-    if (!CheckEPGDir("/var/run/vdr"))
-    {
-        if (!CheckEPGDir("/tmp"))
-        {
-            if (!CheckEPGDir("/dev/shm"))
-            {
-                epgfiledir=NULL;
-                epgfile=strdup(epgfile_store);
-            }
-            else
-            {
-                epgfiledir=strdup("/dev/shm");
-            }
-        }
-        else
-        {
-            epgfiledir=strdup("/tmp");
-        }
-    }
-    else
-    {
-        epgfiledir=strdup("/var/run/vdr");
-    }
-
-    if (epgfiledir)
-    {
-        if (asprintf(&epgfile,"%s/epg.db",epgfiledir)==-1) {};
-    }
-
-    if (asprintf(&imgdir,"%s","/var/cache/vdr/epgimages")==-1) {};
-    if (access(imgdir,R_OK|W_OK)==-1)
-    {
-        free(imgdir);
-        imgdir=NULL;
-    }
-
-    if (setlocale(LC_CTYPE,""))
-        codeset=strdup(nl_langinfo(CODESET));
-    else
-    {
-        char *LangEnv=getenv("LANG");
-        if (LangEnv)
-        {
-            char *codeset_p=strchr(LangEnv,'.');
-            if (codeset_p)
-            {
-                codeset_p++; // skip dot
-                codeset=strdup(codeset_p);
-            }
-        }
-    }
-    if (!codeset)
+    // upper bound of the bucket containing the percentile, capped by max
+    if (!count) return 0;
+    uint64_t want=(count*Percent+99)/100,sum=0;
+    for (int i=0; i<LATENCY_BUCKETS; i++)
     {
-        codeset=strdup("ASCII//TRANSLIT");
-    }
-
-    struct passwd pwd,*pwdbuf;
-    char buf[1024];
-    getpwuid_r(getuid(),&pwd,buf,sizeof(buf),&pwdbuf);
-    if (pwdbuf)
-    {
-        if (asprintf(&epdir,"%s/.eplists/lists",pwdbuf->pw_dir)!=-1)
-        {
-            if (access(epdir,R_OK))
-            {
-                free(epdir);
-                epdir=NULL;
-            }
-            else
-            {
-                epcodeset=codeset;
-            }
-        }
+        sum+=buckets[i];
+        if (sum>=want) return ((2ULL<<i)<max) ? (2ULL<<i) : max;
     }
+    return max;
 }
 
-cGlobals::~cGlobals()
+cString cEPGLatency::ToString(const char *Name)
 {
-    free(confdir);
-    free(epgfile);
-    free(epgfile_store);
-    free(epgfiledir);
-    free(epdir);
-    free(imgdir);
-    free(codeset);
-    free(order);
-    free(srcorder);
-    if (epgtimer)
-    {
-        epgtimer->Stop();
-        delete epgtimer;
-    }
-    if (epgseasonepisode)
-    {
-        epgseasonepisode->Stop();
-        delete epgseasonepisode;
-    }
-    epgsources.Remove();
-    epgmappings.Remove();
-    textmappings.Remove();
+    cMutexLock lock(&mutex);
+    return cString::sprintf("%s count=%llu avg_ns=%llu p50_ns=%llu p95_ns=%llu p99_ns=%llu max_ns=%llu",Name,
+                            (unsigned long long) count,(unsigned long long) (count ? total/count : 0),
+                            (unsigned long long) Percentile(50),(unsigned long long) Percentile(95),
+                            (unsigned long long) Percentile(99),(unsigned long long) max);
 }
 
-bool cGlobals::CheckEPGDir(const char* EPGFileDir)
+cEPGLatencyTimer::cEPGLatencyTimer(cEPGHandler *Handler, int Which, const cEvent *Event, tChannelID ChannelID)
 {
-    struct statfs statfsbuf;
-    if (statfs(EPGFileDir,&statfsbuf)==-1) return false;
-    if ((statfsbuf.f_type!=0x01021994) && (statfsbuf.f_type!=0x28cd3d45)) return false;
-    if (access(EPGFileDir,R_OK|W_OK)==-1) return false;
-    return true;
+    handler=Handler;
+    which=Which;
+    event=Event;
+    channelid=ChannelID;
+    start=cEPGLatency::Now();
 }
 
-void cGlobals::SetEPGFile(const char *EPGFile)
+cEPGLatencyTimer::~cEPGLatencyTimer()
 {
-    free(epgfile_store);
-    free(epgfile);
-    epgfile_store=strdup(EPGFile);
-    if (!epgfile_store)
-    {
-        epgfile=NULL;
-        return;
-    }
+    handler->AddLatency(which,cEPGLatency::Now()-start,event,channelid);
+}
 
-    char *tm2=strdup(epgfile_store);
-    if (!tm2)
-    {
-        free(epgfile_store);
-        epgfile_store=NULL;
-        epgfile=NULL;
-        return;
-    }
-    char *dn=dirname(tm2);
-    bool usestore=CheckEPGDir(dn);
-    free(tm2);
+// -------------------------------------------------------------
 
-    if ((usestore) || (!epgfiledir))
-    {
-        epgfile=strdup(epgfile_store);
-    }
-    else
+cEPGHandler::cEPGHandler(cGlobals* Global): import(Global)
+{
+    epall=0;
+    maps=Global->EPGMappings();
+    sources=Global->EPGSources();
+    cache=Global->XMLTVCache();
+    import.SetWriter(Global->EPGWriter());
+    db=NULL;
+    dbgeneration=cache->Generation();
+    now=0;
+    timerexpire=0;
+    if (ioprio_set(1,getpid(),7 | 3 << 13)==-1)
     {
-        char *tmp=strdup(epgfile_store);
-        if (!tmp)
-        {
-            free(epgfile_store);
-            epgfile_store=NULL;
-            epgfile=NULL;
-            return;
-        }
-        char *bn=basename(tmp);
-        if (asprintf(&epgfile,"%s/%s",epgfiledir,bn)==-1)
-        {
-            free(epgfile_store);
-            free(tmp);
-            epgfile_store=NULL;
-            epgfile=NULL;
-            return;
-        }
-        free(tmp);
+        tsyslog("failed to set ioprio to 3,7");
     }
 }
 
-
-void cGlobals::CopyEPGFile(bool Init)
+void cEPGHandler::AddLatency(int Which, uint64_t Ns, const cEvent *Event, tChannelID ChannelID)
 {
-    if ((!epgfile) || (!epgfile_store)) return;
-    if (!strcmp(epgfile,epgfile_store)) return; // same dir
-
-    struct stat statbuf;
-    char *tmpdstfile=NULL;
-    int fd=-1;
-
-    if (Init)
-    {
-        if (stat(epgfile_store,&statbuf)==-1) return; // no file?
-        fd=open(epgfile_store,O_RDONLY);
-    }
-    else
-    {
-        if (stat(epgfile,&statbuf)==-1) return;
-        fd=open(epgfile,O_RDONLY);
-    }
+    if ((Which<0) || (Which>=LATENCY_COUNT)) return;
+    latency[Which].Add(Ns);
+    if (Ns<LATENCY_SLOW) return;
 
-    if (fd==-1) return; // no file??
-    char *buf=(char *) malloc(statbuf.st_size+1);
-    if (!buf)
-    {
-        close(fd);
-        return;
-    }
-    if (read(fd,buf,statbuf.st_size)!=statbuf.st_size)
-    {
-        free(buf);
-        close(fd);
-        return;
-    }
-    close(fd);
-    if (Init)
+    cString call;
+    if (Event)
     {
-        fd=creat(epgfile,0644);
+        call=cString::sprintf("%s %llu us {%5i} '%s' %s",latencynames[Which],(unsigned long long) Ns/1000,
+                              Event->EventID(),Event->Title() ? Event->Title() : "",*ChannelID.ToString());
     }
     else
     {
-        if (asprintf(&tmpdstfile,"%s_",epgfile_store)==-1)
-        {
-            free(buf);
-            return;
-        }
-        fd=creat(tmpdstfile,0644);
+        call=cString::sprintf("%s %llu us %s",latencynames[Which],(unsigned long long) Ns/1000,
+                              *ChannelID.ToString());
     }
-    if (fd==-1)
+    dsyslog("slow epg handler call: %s",*call);
+    cMutexLock lock(&slowmutex);
+    if (slowcalls.Size()>=LATENCY_SLOWMAX)
     {
-        if (!Init) free(tmpdstfile);
-        free(buf);
-        return;
+        free(slowcalls[0]);
+        slowcalls.Remove(0);
     }
-    if (write(fd,buf,statbuf.st_size)!=statbuf.st_size)
+    slowcalls.Append(strdup(*call));
+}
+
+cString cEPGHandler::Latency(bool Reset)
+{
+    cString result="";
+    for (int i=0; i<LATENCY_COUNT; i++)
     {
-        close(fd);
-        if (Init)
-        {
-            unlink(epgfile);
-        }
-        else
-        {
-            unlink(tmpdstfile);
-            free(tmpdstfile);
-        }
-        free(buf);
-        return;
+        result=cString::sprintf("%s%s\n",*result,*latency[i].ToString(latencynames[i]));
+        if (Reset) latency[i].Reset();
     }
-    close(fd);
-    free(buf);
-    if (!Init)
+    cMutexLock lock(&slowmutex);
+    for (int i=0; i<slowcalls.Size(); i++)
     {
-        if (rename(tmpdstfile,epgfile_store)!=-1)
-        {
-            unlink(epgfile);
-        }
-        free(tmpdstfile);
+        result=cString::sprintf("%sslow %s\n",*result,slowcalls[i]);
     }
+    if (Reset) slowcalls.Clear();
+    return result;
 }
 
-
-char *cGlobals::GetDefaultOrder()
+bool cEPGHandler::IgnoreChannel(const cChannel* Channel)
 {
-    return (char *) "LOT,CRS,CAD,ORT,CAT,VID,AUD,SEE,RAT,STR,REV";
+    cEPGLatencyTimer timer(this,LATENCY_IGNORECHANNEL,NULL,Channel ? Channel->GetChannelID() : tChannelID::InvalidID);
+    now=time(NULL);
+    if (!maps) return false;
+    if (!Channel) return false;
+    return maps->IgnoreChannel(Channel);
 }
 
-void cGlobals::SetImgDir(const char* ImgDir)
+void cEPGHandler::UpdateTimerEvents()
 {
-    if (!ImgDir) return;
-    if (access(ImgDir,R_OK|W_OK)==-1)
+    // events of the active timers, vdr assigns them to the timers. A repeating
+    // timer only has the event of its next run, once a timer has stopped the
+    // event of its next run is taken. Without the state key of vdr>=2.3.1 the
+    // list is rebuilt on every call
+#if VDRVERSNUM>=20301
+    if (timerexpire && (now>=timerexpire)) timerstatekey.Reset();
+    const cTimers *Timers=cTimers::GetTimersRead(timerstatekey);
+    if (!Timers) return;
+#endif
+    timerevents.clear();
+    timermatch.clear();
+    timerexpire=0;
+#if VDRVERSNUM>=20301
+    for (const cTimer *Timer=Timers->First(); Timer; Timer=Timers->Next(Timer))
+#else
+    for (cTimer *Timer=Timers.First(); Timer; Timer=Timers.Next(Timer))
+#endif
     {
-        esyslog("cannot access %s",ImgDir);
-        return;
+        if (!Timer->HasFlags(tfActive)) continue;
+        if (!Timer->Channel()) continue;
+        std::string channelid=*Timer->Channel()->GetChannelID().ToString();
+        if (Timer->StopTime()>now && (!timerexpire || Timer->StopTime()<timerexpire))
+            timerexpire=Timer->StopTime();
+        if (!Timer->IsSingleEvent() || !Timer->Event()) timermatch.insert(channelid);
+        if (!Timer->Event()) continue;
+        timerevents[std::make_pair(channelid,Timer->Event()->EventID())]=*Timer->ToDescr();
     }
-    free(imgdir);
-    imgdir=strdup(ImgDir);
+#if VDRVERSNUM>=20301
+    timerstatekey.Remove();
+#endif
 }
 
-
-void cGlobals::SetEPDir(const char* EPDir)
+bool cEPGHandler::MatchTimer(const cEvent *Event, std::string &Descr)
 {
-    if (!EPDir) return;
-    if (access(EPDir,R_OK)==-1)
-    {
-        esyslog("cannot access %s",EPDir);
-        return;
-    }
-    free(epdir);
-    epcodeset=codeset;
-    epdir=strdup(EPDir);
-    if (!epdir) return;
-    epcodeset=strchr((char *) epdir,',');
-    if (epcodeset)
-    {
-        *epcodeset=0;
-    }
-    else
+    UpdateTimerEvents();
+    std::string channelid=*Event->ChannelID().ToString();
+    std::map<std::pair<std::string,tEventID>,std::string>::iterator it;
+    it=timerevents.find(std::make_pair(channelid,Event->EventID()));
+    if (it!=timerevents.end())
     {
-        epcodeset=(char *) codeset;
+        Descr=it->second;
+        return true;
     }
-}
-
-bool cGlobals::DBExists()
-{
-    if (!epgfile) return true; // is this safe?
-    struct stat statbuf;
-    if (stat(epgfile,&statbuf)==-1) return false; // no database
-    if (!statbuf.st_size) return false; // no database
-    return true;
-}
-
-// -------------------------------------------------------------
-
-cEPGHandler::cEPGHandler(cGlobals* Global): import(Global)
-{
-    epall=0;
-    maps=Global->EPGMappings();
-    sources=Global->EPGSources();
-    db=NULL;
-    now=0;
-    if (ioprio_set(1,getpid(),7 | 3 << 13)==-1)
+    // later runs of a repeating timer or a timer which has no event yet,
+    // remember the matches
+    if (timermatch.find(channelid)==timermatch.end()) return false;
+#if VDRVERSNUM <= 10732
+    int TimerMatch=tmNone;
+#else
+    eTimerMatch TimerMatch=tmNone;
+#endif
+#if VDRVERSNUM>=20301
+    cStateKey StateKey;
+    const cTimers *Timers=cTimers::GetTimersRead(StateKey);
+    if (!Timers) return false;
+    const cTimer *Timer=Timers->GetMatch(Event,&TimerMatch);
+#else
+    cTimer *Timer=Timers.GetMatch(Event,&TimerMatch);
+#endif
+    if (Timer && (TimerMatch==tmFull))
     {
-        tsyslog("failed to set ioprio to 3,7");
+        Descr=*Timer->ToDescr();
+        timerevents[std::make_pair(channelid,Event->EventID())]=Descr;
     }
-}
-
-bool cEPGHandler::IgnoreChannel(const cChannel* Channel)
-{
-    now=time(NULL);
-    if (!maps) return false;
-    if (!Channel) return false;
-    return maps->IgnoreChannel(Channel);
+#if VDRVERSNUM>=20301
+    StateKey.Remove();
+#endif
+    return (Timer && (TimerMatch==tmFull));
 }
 
 bool cEPGHandler::check4proc(cEvent *event, char **timerdescr, cEPGMapping **map)
@@ -611,28 +252,10 @@ bool cEPGHandler::check4proc(cEvent *event, char **timerdescr, cEPGMapping **map
         if (!epall) return false;
         if (!event->ShortText()) return false;
         if (!timerdescr) return false;
-#if VDRVERSNUM <= 10732
-        int TimerMatch = tmNone;
-#else
-        eTimerMatch TimerMatch = tmNone;
-#endif
 
-#if VDRVERSNUM>=20301
-        cStateKey StateKey;
-        if (const cTimers *Timers=cTimers::GetTimersRead(StateKey))
-        {
-            const cTimer *Timer=Timers->GetMatch(event,&TimerMatch);
-            if ((Timer) && (TimerMatch==tmFull))
-            {
-                *timerdescr=strdup(Timer->ToDescr());
-            }
-            StateKey.Remove();
-        }
-#else
-        cTimer *timer=Timers.GetMatch(event,&TimerMatch);
-        if ((!timer) || (TimerMatch!=tmFull)) return false;
-        *timerdescr=strdup(timer->ToDescr());
-#endif
+        std::string descr;
+        if (!MatchTimer(event,descr)) return false;
+        *timerdescr=strdup(descr.c_str());
     }
     if (map) *map=t_map;
     return true;
@@ -659,6 +282,7 @@ bool cEPGHandler::SetShortText(cEvent* Event, const char* ShortText)
 
 bool cEPGHandler::SetDescription(cEvent* Event, const char* Description)
 {
+    cEPGLatencyTimer timer(this,LATENCY_SETDESCRIPTION,Event,Event->ChannelID());
     //cTimer *timer;
     char *timerdescr;
     if (!check4proc(Event,&timerdescr,NULL))
@@ -705,6 +329,8 @@ bool cEPGHandler::SetDescription(cEvent* Event, const char* Description)
 
 bool cEPGHandler::HandleEvent(cEvent* Event)
 {
+    cEPGLatencyTimer timer(this,LATENCY_HANDLEEVENT,Event,Event->ChannelID());
+    cMutexLock lock(&mutex);
     //cTimer *timer;
     char *timerdescr;
     cEPGMapping *map;
@@ -732,6 +358,15 @@ bool cEPGHandler::HandleEvent(cEvent* Event)
         Flags=map->Flags();
     }
 
+    if (db && (dbgeneration!=cache->Generation()))
+    {
+        // database was rewritten or removed
+        import.FinalizeStatements();
+        sqlite3_close(db);
+        db=NULL;
+    }
+    dbgeneration=cache->Generation();
+
     cEPGSource *source=NULL;
     cXMLTVEvent *xevent=import.SearchXMLTVEvent(&db,ChannelID,Event);
     if (!xevent)
@@ -759,6 +394,12 @@ bool cEPGHandler::HandleEvent(cEvent* Event)
         if (!source) tsyslog("no source for %s",EITSOURCE);
         bool useeptext=((epall & EPLIST_USE_STEXTITLE)==EPLIST_USE_STEXTITLE);
         if (useeptext) Flags|=(USE_SHORTTEXT|OPT_SEASON_STEXTITLE);
+        if (!import.OpenDB(&db))
+        {
+            free((void*)ChannelID);
+            if (timerdescr) free(timerdescr);
+            return false;
+        }
 
         xevent=import.AddXMLTVEvent(source,db,ChannelID,Event,Event->Description(),useeptext);
         if (!xevent)
@@ -784,6 +425,11 @@ bool cEPGHandler::HandleEvent(cEvent* Event)
         delete xevent;
         return false;
     }
+    if (!import.OpenDB(&db))
+    {
+        delete xevent;
+        return false;
+    }
 
     if (xevent->Title() && Event->Title())
     {
@@ -823,14 +469,10 @@ bool cEPGHandler::HandleEvent(cEvent* Event)
     return false; // let other handlers change this event
 }
 
-bool cEPGHandler::SortSchedule(cSchedule* UNUSED(Schedule))
+bool cEPGHandler::SortSchedule(cSchedule* Schedule)
 {
-    if (db)
-    {
-        import.Commit(NULL,db);
-        sqlite3_close(db);
-        db=NULL;
-    }
+    // keep the database open, HandleEvent closes it when the cache generation changes
+    cEPGLatencyTimer timer(this,LATENCY_SORTSCHEDULE,NULL,Schedule->ChannelID());
     return false; // we dont sort!
 }
 
@@ -839,6 +481,7 @@ bool cEPGHandler::SortSchedule(cSchedule* UNUSED(Schedule))
 cEPGTimer::cEPGTimer(cGlobals *Global) :
         cThread("xmltv2vdr timer"),import(Global)
 {
+    g=Global;
     sources=Global->EPGSources();
     maps=Global->EPGMappings();
     epall=0;
@@ -862,23 +505,28 @@ void cEPGTimer::Action()
     Timers.IncBeingEdited();
 #endif
 
-    sqlite3 *db=NULL;
     cEPGSource *source=sources->GetSource(EITSOURCE);
     bool useeptext=((epall & EPLIST_USE_STEXTITLE)==EPLIST_USE_STEXTITLE);
     int Flags=USE_SEASON;
     if (useeptext) Flags|=(USE_SHORTTEXT|OPT_SEASON_STEXTITLE);
+    // events without a match are tried again after an import or a change of the eplists
+    time_t eplisttime=g->EPGSeasonEpisode() ? g->EPGSeasonEpisode()->EPListTime() : 0;
+    unsigned int generation=(((unsigned int) g->DBGeneration()*2654435761U)^(unsigned int) eplisttime)|1;
 
+    // collect new or changed timer events, the database is not touched while timers are locked
+    cList<cEPGTimerJob> jobs;
+    std::set<std::pair<std::string,tEventID> > seen;
 #if VDRVERSNUM<20301
     for (cTimer *Timer = Timers.First(); Timer; Timer = Timers.Next(Timer))
 #else
     cStateKey StateKey;
-    if (const cTimers *Timers=cTimers::GetTimersRead(StateKey))
-    {
-        for (const cTimer *Timer=Timers->First(); Timer; Timer=Timers->Next(Timer))
+    const cTimers *Timers=cTimers::GetTimersRead(StateKey);
+    if (!Timers) return;
+    for (const cTimer *Timer=Timers->First(); Timer; Timer=Timers->Next(Timer))
 #endif
     {
         if (Timer->Recording()) continue; // to late ;)
-        cEvent *event=(cEvent *) Timer->Event();
+        const cEvent *event=Timer->Event();
         if (!event) continue;
         if (!useeptext)
         {
@@ -893,93 +541,246 @@ void cEPGTimer::Action()
             if (event->ShortText()) continue; // already processed by xmltv2vdr
         }
 
-        const char *ChannelID=strdup(*event->ChannelID().ToString());
-        cXMLTVEvent *xevent=import.SearchXMLTVEvent(&db,ChannelID,event);
+        std::pair<std::string,tEventID> key(std::string(*event->ChannelID().ToString()),event->EventID());
+        seen.insert(key);
+        std::map<std::pair<std::string,tEventID>,std::pair<unsigned int,unsigned int> >::iterator it;
+        it=processed.find(key);
+        if ((it!=processed.end()) && (it->second.first==Signature(event)) &&
+                (!it->second.second || (it->second.second==generation))) continue; // unchanged
+        jobs.Add(new cEPGTimerJob(event,Timer->ToDescr()));
+    }
+#if VDRVERSNUM>=20301
+    StateKey.Remove();
+#endif
+
+    // forget events no timer points to anymore
+    for (std::map<std::pair<std::string,tEventID>,std::pair<unsigned int,unsigned int> >::iterator it=processed.begin();
+            it!=processed.end();)
+    {
+        if (!seen.count(it->first))
+        {
+            processed.erase(it++);
+        }
+        else
+        {
+            it++;
+        }
+    }
+
+    sqlite3 *db=NULL;
+    for (cEPGTimerJob *job=jobs.First(); job; job=jobs.Next(job))
+    {
+        if (!Running()) break;
+        // search and add work on a copy of the event
+        cEvent *tevent=job->Event();
+        cXMLTVEvent *xevent=import.SearchXMLTVEvent(&db,job->ChannelIDStr(),tevent);
+        if (!import.OpenDB(&db))
+        {
+            delete xevent;
+            break;
+        }
         if (!xevent)
         {
-            xevent=import.AddXMLTVEvent(source,db,ChannelID,event,event->Description(),useeptext);
+            xevent=import.AddXMLTVEvent(source,db,job->ChannelIDStr(),tevent,tevent->Description(),useeptext);
             if (!xevent)
             {
-                free((void*)ChannelID);
+                // nothing found, try again when the event or the data changes
+                processed[std::make_pair(std::string(job->ChannelIDStr()),tevent->EventID())]=
+                    std::make_pair(Signature(tevent),generation);
                 continue;
             }
-            else
-            {
-                tsyslog("{%5i} +adding '%s'/'%s' (%s)",event->EventID(),xevent->Title(),xevent->ShortText(),*Timer->ToDescr());
-            }
+            tsyslog("{%5i} +adding '%s'/'%s' (%s)",tevent->EventID(),xevent->Title(),xevent->ShortText(),
+                    job->TimerDescr());
         }
         else
         {
-            if (!event->ShortText() && event->Description())
+            if (!tevent->ShortText() && tevent->Description())
             {
-                if (import.AddShortTextFromEITDescription(xevent,event->Description()))
+                if (import.AddShortTextFromEITDescription(xevent,tevent->Description()))
                 {
                     import.UpdateXMLTVEvent(source,db,xevent);
                 }
             }
         }
-        free((void*)ChannelID);
 
-        import.PutEvent(source,db,NULL,event,xevent,Flags);
+        // the real event is changed under the schedules lock
+#if VDRVERSNUM>=20301
+        cStateKey SchedulesStateKey;
+        cSchedules *schedules=cSchedules::GetSchedulesWrite(SchedulesStateKey,1000);
+        if (!schedules)
+        {
+            delete xevent;
+            continue;
+        }
+#endif
+        cSchedule *schedule=(cSchedule *) schedules->GetSchedule(job->ChannelID());
+        cEvent *event=schedule ? (cEvent *) schedule->GetEvent(tevent->EventID(),tevent->StartTime()) : NULL;
+        if (event)
+        {
+            import.PutEvent(source,db,NULL,event,xevent,Flags);
+            processed[std::make_pair(std::string(job->ChannelIDStr()),event->EventID())]=
+                std::make_pair(Signature(event),0U);
+        }
+#if VDRVERSNUM>=20301
+        SchedulesStateKey.Remove(event!=NULL);
+#endif
         delete xevent;
     }
-#if VDRVERSNUM>=20301
-    StateKey.Remove();
-}
+    if (db)
+    {
+        import.Commit(source,db);
+        import.FinalizeStatements();
+        sqlite3_close(db);
+    }
+    if (jobs.Count()) dsyslog("timer pass: %i of %i timer events new or changed",jobs.Count(),(int) seen.size());
+
+#if VDRVERSNUM<20301
+    Timers.DecBeingEdited();
 #endif
-if (db)
+}
+
+cEPGTimerJob::cEPGTimerJob(const cEvent *Event, const char *TimerDescr)
 {
-    import.Commit(source,db);
-    sqlite3_close(db);
+    channelid=Event->ChannelID();
+    channelidstr=strdup(*channelid.ToString());
+    timerdescr=TimerDescr ? strdup(TimerDescr) : NULL;
+    event=new cEvent(Event->EventID());
+    event->SetTitle(Event->Title());
+    event->SetShortText(Event->ShortText());
+    event->SetDescription(Event->Description());
+    event->SetStartTime(Event->StartTime());
+    event->SetDuration(Event->Duration());
+    event->SetVersion(Event->Version());
 }
 
-#if VDRVERSNUM<20301
-Timers.DecBeingEdited();
-#endif
+cEPGTimerJob::~cEPGTimerJob()
+{
+    delete event;
+    free(channelidstr);
+    free(timerdescr);
 }
 
 // -------------------------------------------------------------
 
-cHouseKeeping::cHouseKeeping(cGlobals *Global): cThread("xmltv2vdr housekeeping")
+cHouseKeepingDir::cHouseKeepingDir(const char *Path)
 {
-    global=Global;
+    path=strdup(Path);
+    dirmtime=(time_t) 0;
+}
+
+cHouseKeepingDir::~cHouseKeepingDir()
+{
+    free(path);
+}
+
+void cHouseKeepingDir::Forget(const std::string &Name)
+{
+    known.erase(Name);
 }
 
-void cHouseKeeping::checkdir(const char* imgdir, int age, int &cnt, int &lcnt)
+void cHouseKeepingDir::Check(int Age, int &Cnt, int &LCnt, int &Stats, sqlite3_stmt *Del)
 {
-    if (age<=0) return;
-    DIR *dir=opendir(imgdir);
-    if (!dir) return;
+    if (Age<=0) return;
+    int fd=open(path,O_RDONLY|O_DIRECTORY);
+    if (fd==-1)
+    {
+        known.clear();
+        buckets.clear();
+        dirmtime=(time_t) 0;
+        return;
+    }
     time_t tmin=time(NULL);
-    tmin-=(age*86400);
-    struct dirent *dirent;
+    tmin-=(Age*86400);
 
-    while (dirent=readdir(dir))
+    struct stat statbuf;
+    if ((fstat(fd,&statbuf)!=-1) && (statbuf.st_mtime!=dirmtime))
     {
-        if (dirent->d_name[0]=='.') continue;
-        if ((dirent->d_type==DT_LNK) || (dirent->d_type==DT_REG))
+        // directory changed -> pick up new files, only these get a stat
+        DIR *dir=fdopendir(dup(fd));
+        if (dir)
         {
-            struct stat statbuf;
-            char *fpath;
-            if (asprintf(&fpath,"%s/%s",imgdir,dirent->d_name)!=-1)
+            std::map<std::string,unsigned char> seen;
+            struct dirent *dirent;
+            while (dirent=readdir(dir))
             {
-                if (stat(fpath,&statbuf)!=-1)
+                if (dirent->d_name[0]=='.') continue;
+                unsigned char type=dirent->d_type;
+                if (type==DT_UNKNOWN)
+                {
+                    struct stat lstatbuf;
+                    Stats++;
+                    if (fstatat(fd,dirent->d_name,&lstatbuf,AT_SYMLINK_NOFOLLOW)==-1) continue;
+                    if (S_ISLNK(lstatbuf.st_mode)) type=DT_LNK;
+                    if (S_ISREG(lstatbuf.st_mode)) type=DT_REG;
+                }
+                if ((type!=DT_LNK) && (type!=DT_REG)) continue;
+                std::string name=dirent->d_name;
+                if (known.find(name)==known.end())
                 {
-                    if (statbuf.st_mtime<tmin)
-                    {
-                        if (unlink(fpath)!=-1)
-                        {
-                            if (dirent->d_type==DT_LNK) lcnt++;
-                            if (dirent->d_type==DT_REG) cnt++;
-                        }
-                    }
+                    struct stat fstatbuf;
+                    Stats++;
+                    if (fstatat(fd,dirent->d_name,&fstatbuf,0)==-1) continue;
+                    buckets[fstatbuf.st_mtime/3600].insert(name);
                 }
-                free(fpath);
+                seen[name]=type;
             }
+            closedir(dir);
+            known.swap(seen);
+            dirmtime=statbuf.st_mtime;
         }
     }
-    closedir(dir);
-    return;
+
+    // only buckets which are completely expired are checked
+    bool removed=false;
+    while (!buckets.empty())
+    {
+        std::map<time_t,std::set<std::string> >::iterator b=buckets.begin();
+        if (((b->first+1)*3600)>tmin) break;
+        std::set<std::string> names;
+        names.swap(b->second);
+        buckets.erase(b);
+        for (std::set<std::string>::iterator n=names.begin(); n!=names.end(); n++)
+        {
+            std::map<std::string,unsigned char>::iterator k=known.find(*n);
+            if (k==known.end()) continue; // already gone
+            struct stat fstatbuf;
+            Stats++;
+            if (fstatat(fd,n->c_str(),&fstatbuf,0)==-1)
+            {
+                Forget(*n);
+                continue;
+            }
+            if (fstatbuf.st_mtime>=tmin)
+            {
+                // file was updated in between
+                buckets[fstatbuf.st_mtime/3600].insert(*n);
+                continue;
+            }
+            if (unlinkat(fd,n->c_str(),0)!=-1)
+            {
+                if (k->second==DT_LNK) LCnt++;
+                if (k->second==DT_REG) Cnt++;
+                if ((k->second==DT_LNK) && (Del))
+                {
+                    sqlite3_bind_text(Del,1,n->c_str(),-1,SQLITE_STATIC);
+                    sqlite3_step(Del);
+                    sqlite3_reset(Del);
+                }
+                Forget(*n);
+                removed=true;
+            }
+        }
+    }
+    // our own unlinks shouldn't trigger a rescan
+    if ((removed) && (fstat(fd,&statbuf)!=-1)) dirmtime=statbuf.st_mtime;
+    close(fd);
+}
+
+// -------------------------------------------------------------
+
+cHouseKeeping::cHouseKeeping(cGlobals *Global): cThread("xmltv2vdr housekeeping")
+{
+    global=Global;
 }
 
 int sd_select(const dirent* dirent)
@@ -992,82 +793,175 @@ int sd_select(const dirent* dirent)
     return 0;
 }
 
-void cHouseKeeping::Action()
+cHouseKeepingDir *cHouseKeeping::GetDir(const char *Path)
 {
-    if (global->ImgDelAfter() && global->ImgDir())
+    for (cHouseKeepingDir *dir=dirs.First(); dir; dir=dirs.Next(dir))
     {
-        int cnt=0,lcnt=0;
-        checkdir(global->ImgDir(),global->ImgDelAfter(),cnt,lcnt);
-        struct dirent **names;
-        int ret=scandir("/var/lib/epgsources",&names,sd_select,alphasort);
-        if (ret>0)
+        if (!strcmp(dir->Path(),Path)) return dir;
+    }
+    cHouseKeepingDir *dir=new cHouseKeepingDir(Path);
+    if (dir) dirs.Add(dir);
+    return dir;
+}
+
+void cHouseKeeping::CheckDirs(sqlite3 *db)
+{
+    cTimeMs timer;
+    int cnt=0,lcnt=0,stats=0;
+
+    sqlite3_stmt *stmt=NULL;
+    if (db) sqlite3_prepare_v2(db,"delete from piclinks where link=?;",-1,&stmt,NULL);
+    cHouseKeepingDir *dir=GetDir(global->ImgDir());
+    if (dir) dir->Check(global->ImgDelAfter(),cnt,lcnt,stats,stmt);
+    if (stmt) sqlite3_finalize(stmt);
+
+    struct dirent **names;
+    int ret=scandir("/var/lib/epgsources",&names,sd_select,alphasort);
+    if (ret>0)
+    {
+        for (int i=0; i<ret; i++)
         {
-            for (int i=0; i<ret; i++)
+            char *newdir;
+            if (asprintf(&newdir,"/var/lib/epgsources/%s",names[i]->d_name)!=-1)
             {
-                char *newdir;
-                if (asprintf(&newdir,"/var/lib/epgsources/%s",names[i]->d_name)!=-1)
-                {
-                    checkdir(newdir,global->ImgDelAfter(),cnt,lcnt);
-                    free(newdir);
-                }
+                dir=GetDir(newdir);
+                if (dir) dir->Check(global->ImgDelAfter(),cnt,lcnt,stats,NULL);
+                free(newdir);
             }
-            free(names);
-        }
-        if (lcnt)
-        {
-            isyslog("removed %i links",lcnt);
-        }
-        if (cnt)
-        {
-            isyslog("removed %i pics",cnt);
+            free(names[i]);
         }
+        free(names);
     }
+    if (lcnt)
+    {
+        isyslog("removed %i links",lcnt);
+    }
+    if (cnt)
+    {
+        isyslog("removed %i pics",cnt);
+    }
+    dsyslog("housekeeping: checked pictures in %llims (%i stats)",(long long int) timer.Elapsed(),stats);
+}
 
-    if (!global->DBExists()) return;
-
-#if APIVERSNUM<20301
-    cSchedulesLock schedulesLock(true,10); // wait 10ms for lock!
-    const cSchedules *schedules = cSchedules::Schedules(schedulesLock);
-    if (!schedules) return;
-#endif
+void cHouseKeeping::CheckDB(sqlite3 *db)
+{
+    cTimeMs timer;
 
-    sqlite3 *db=NULL;
-    if (sqlite3_open_v2(global->EPGFile(),&db,SQLITE_OPEN_READWRITE,NULL)==SQLITE_OK)
+    // databases created before auto_vacuum was set, need one full vacuum
+    sqlite3_stmt *stmt;
+    if (sqlite3_prepare_v2(db,"PRAGMA auto_vacuum;",-1,&stmt,NULL)==SQLITE_OK)
     {
-        char *sql;
-        if (asprintf(&sql,"delete from epg where ((starttime+duration) < %li)",time(NULL))!=-1)
+        int mode=-1;
+        if (sqlite3_step(stmt)==SQLITE_ROW) mode=sqlite3_column_int(stmt,0);
+        sqlite3_finalize(stmt);
+        if (mode==0)
         {
             char *errmsg;
-            if (sqlite3_exec(db,sql,NULL,NULL,&errmsg)!=SQLITE_OK)
+            // VACUUM cannot change auto_vacuum in wal mode
+            if (sqlite3_exec(db,"PRAGMA journal_mode=DELETE; PRAGMA auto_vacuum=INCREMENTAL; VACUUM; " \
+                             "PRAGMA journal_mode=WAL;",NULL,NULL,&errmsg)!=SQLITE_OK)
             {
                 esyslog("%s",errmsg);
                 sqlite3_free(errmsg);
             }
             else
             {
-                int changes=sqlite3_changes(db);
-                if (changes)
-                {
-                    isyslog("removed %i old entries from db",changes);
-                    sqlite3_exec(db,"VACCUM;",NULL,NULL,NULL);
-                }
+                isyslog("switched db to incremental vacuum");
             }
-            free(sql);
         }
     }
-    sqlite3_close(db);
-}
 
-// -------------------------------------------------------------
+    // days before yesterday are dropped as a whole, in the remaining
+    // days only the events which already ended are removed
+    char *sql;
+    time_t now=time(NULL);
+    int today=cEPGDatabase::Day(now);
+    int dropped=global->EPGDatabase()->DropPartitions(db,today-1);
+    if (dropped>0) isyslog("removed %i old days from db",dropped);
+    std::vector<int> days;
+    if (cEPGDatabase::Days(db,days))
+    {
+        // the eit thread never creates partitions, it only adds events to existing days
+        for (int day=today; day<today+EPGDB_DAYSAHEAD; day++)
+        {
+            if (!cEPGDatabase::Partition(db,day)) break;
+        }
+    }
+    int changes=0;
+    for (size_t i=0; (i<days.size()) && (days[i]<=today); i++)
+    {
+        if (asprintf(&sql,"delete from epgevents_%i where starttime < %li and ((starttime+duration) < %li)",
+                     days[i],now,now)==-1) break;
+        char *errmsg;
+        if (sqlite3_exec(db,sql,NULL,NULL,&errmsg)!=SQLITE_OK)
+        {
+            esyslog("%s",errmsg);
+            sqlite3_free(errmsg);
+        }
+        else
+        {
+            changes+=sqlite3_changes(db);
+        }
+        free(sql);
+    }
+    if (changes)
+    {
+        isyslog("removed %i old entries from db",changes);
+    }
 
-cEPGSeasonEpisode::cEPGSeasonEpisode(cGlobals *Global): cThread("xmltv2vdr seasonepisode")
-{
-    epgfile=Global->EPGFile();
+    // give free pages back in small steps, so other threads aren't blocked for long
+    int pages=0;
+    while (Running())
+    {
+        int freepages=0;
+        if (sqlite3_prepare_v2(db,"PRAGMA freelist_count;",-1,&stmt,NULL)!=SQLITE_OK) break;
+        if (sqlite3_step(stmt)==SQLITE_ROW) freepages=sqlite3_column_int(stmt,0);
+        sqlite3_finalize(stmt);
+        if (!freepages) break;
+        int step=freepages>256 ? 256 : freepages;
+        if (asprintf(&sql,"PRAGMA incremental_vacuum(%i);",step)==-1) break;
+        int ret=sqlite3_exec(db,sql,NULL,NULL,NULL);
+        free(sql);
+        if (ret!=SQLITE_OK) break;
+        pages+=step;
+        cCondWait::SleepMs(10);
+    }
+    if (pages) isyslog("released %i pages from db",pages);
+    dsyslog("housekeeping: checked db in %llims",(long long int) timer.Elapsed());
 }
 
-void cEPGSeasonEpisode::Action()
+void cHouseKeeping::Action()
 {
-    // TODO: update season, episode, episodeoverall fields in db
+    sqlite3 *db=NULL;
+    if (global->DBExists())
+    {
+        if (!global->EPGDatabase()->Open(&db)) db=NULL;
+    }
+
+    if (global->ImgDelAfter() && global->ImgDir()) CheckDirs(db);
+
+    if (!db)
+    {
+        global->XMLTVCache()->Refresh();
+        return;
+    }
+
+#if APIVERSNUM<20301
+    cSchedulesLock schedulesLock(true,10); // wait 10ms for lock!
+    const cSchedules *schedules = cSchedules::Schedules(schedulesLock);
+    if (!schedules)
+    {
+        sqlite3_close(db);
+        return;
+    }
+#endif
+
+    CheckDB(db);
+    sqlite3_close(db);
+    dsyslog("%s",*global->XMLTVCache()->Stats());
+    // move the cache window forward
+    global->XMLTVCache()->Refresh();
+    global->EPGBackup()->Trigger();
 }
 
 // -------------------------------------------------------------
@@ -1139,7 +1033,6 @@ void cPluginXmltv2vdr::GetSqliteCompileOptions()
         {
             const char *option=(const char *) sqlite3_column_text(stmt,0);
             tsyslog("option %s",option);
-            if (!strncasecmp(option,"SOUNDEX",7)) g.SetSoundEx();
         }
         else
         {
@@ -1153,8 +1046,8 @@ void cPluginXmltv2vdr::GetSqliteCompileOptions()
 
 int cPluginXmltv2vdr::GetLastImportSource()
 {
-    sqlite3 *db=NULL;
-    if (sqlite3_open_v2(g.EPGFile(),&db,SQLITE_OPEN_READWRITE,NULL)!=SQLITE_OK) return -1;
+    sqlite3 *db=g.EPGDatabase()->GetReader();
+    if (!db) return -1;
 
     char sql[]="select srcidx from epg where srcidx<>99 order by starttime desc limit 1";
     sqlite3_stmt *stmt;
@@ -1163,7 +1056,7 @@ int cPluginXmltv2vdr::GetLastImportSource()
     if (ret!=SQLITE_OK)
     {
         esyslog("%i %s (glis)",ret,sqlite3_errmsg(db));
-        sqlite3_close(db);
+        g.EPGDatabase()->PutReader(db);
         return -1;
     }
 
@@ -1173,7 +1066,7 @@ int cPluginXmltv2vdr::GetLastImportSource()
         idx=sqlite3_column_int(stmt,0);
     }
     sqlite3_finalize(stmt);
-    sqlite3_close(db);
+    g.EPGDatabase()->PutReader(db);
     tsyslog("lastimportsource=%i",idx);
     return idx;
 }
@@ -1244,7 +1137,8 @@ bool cPluginXmltv2vdr::Start(void)
     isyslog("using codeset '%s'",g.Codeset());
     isyslog("using file '%s' for epg database (storage)",g.EPGFileStore());
     isyslog("using file '%s' for epg database (runtime)",g.EPGFile());
-    g.CopyEPGFile(true);
+    g.EPGBackup()->Restore();
+    g.DBChanged(true);
     if (g.EPDir())
     {
         isyslog("using dir '%s' (%s) for episodes",g.EPDir(),g.EPCodeset());
@@ -1257,7 +1151,9 @@ bool cPluginXmltv2vdr::Start(void)
     if (g.ImgDir()) isyslog("using dir '%s' for epgimages (%i)",g.ImgDir(),g.ImgDelAfter());
 
     g.EPGSources()->ReadIn(&g);
+    g.XMLTVCache()->Refresh();
     g.epghandler = new cEPGHandler(&g);
+    g.EPGWriter()->Start();
     g.SetEPAll(g.EPAll());
     isyslog("using sqlite v%s",sqlite3_libversion());
     GetSqliteCompileOptions();
@@ -1272,13 +1168,18 @@ void cPluginXmltv2vdr::Stop(void)
     // Stop any background activities the plugin is performing.
     epgexecutor.Stop();
     housekeeping.Stop();
+    // both may still queue writes, stop them before the backup is saved
+    if (g.EPGTimer()) g.EPGTimer()->Stop();
+    if (g.EPGSeasonEpisode()) g.EPGSeasonEpisode()->Stop();
     cParse::CleanupLibXML();
     if (logfile)
     {
         free(logfile);
         logfile=NULL;
     }
-    g.CopyEPGFile(false);
+    g.EPGWriter()->Stop();
+    g.EPGBackup()->Stop();
+    if (g.EPGBackup()->Save()) g.EPGDatabase()->Unlink();
 }
 
 void cPluginXmltv2vdr::Housekeeping(void)
@@ -1310,13 +1211,11 @@ void cPluginXmltv2vdr::MainThreadHook(void)
     }
     if (g.EPDir())
     {
-        /*
-          if (now>=(last_epcheck_t+900))
-          {
-              if (g.EPGSeasonEpisode()) g.EPGSeasonEpisode()->Start();
-              last_epcheck_t=(now/900)*900;
-          }
-        */
+        if (now>=(last_epcheck_t+900))
+        {
+            if (g.EPGSeasonEpisode()) g.EPGSeasonEpisode()->Trigger();
+            last_epcheck_t=(now/900)*900;
+        }
         if (g.EPAll())
         {
             if (now>=(last_timer_t+600))
@@ -1397,6 +1296,10 @@ bool cPluginXmltv2vdr::SetupParse(const char *Name, const char *Value)
     {
         g.SetWakeUp((bool) atoi(Value));
     }
+    else if (!strcasecmp(Name,"options.compress"))
+    {
+        g.SetCompress((bool) atoi(Value));
+    }
     else if (!strcasecmp(Name,"options.imgdelafter"))
     {
         g.SetImgDelAfter(atoi(Value));
@@ -1410,12 +1313,29 @@ bool cPluginXmltv2vdr::SetupParse(const char *Name, const char *Value)
         g.SetSrcOrder(Value);
     }
     else return false;
+    g.SetupChanged();
     return true;
 }
 
-bool cPluginXmltv2vdr::Service(const char *UNUSED(Id), void *UNUSED(Data))
+bool cPluginXmltv2vdr::Service(const char *Id, void *Data)
 {
     // Handle custom service requests from other plugins
+    if (!Id) return false;
+    if (!strcmp(Id,XMLTV2VDR_GETEVENTINFO))
+    {
+        if (!Data) return true;
+        XMLTV2VDR_GetEventInfo_v1_0 *req=(XMLTV2VDR_GetEventInfo_v1_0 *) Data;
+        req->found=g.XMLTVCache()->GetInfo(req->channelID,req->eventID,&req->info);
+        return true;
+    }
+    if (!strcmp(Id,XMLTV2VDR_GETSCHEDULEINFO))
+    {
+        if (!Data) return true;
+        XMLTV2VDR_GetScheduleInfo_v1_0 *req=(XMLTV2VDR_GetScheduleInfo_v1_0 *) Data;
+        req->events.Clear();
+        g.XMLTVCache()->GetInfo(req->channelID,req->from,req->till,&req->events);
+        return true;
+    }
     return false;
 }
 
@@ -1432,6 +1352,17 @@ const char **cPluginXmltv2vdr::SVDRPHelpPages(void)
         "    Start housekeeping manually\n",
         "TIMR\n"
         "    Start timerthread manually\n",
+        "STAT\n"
+        "    Show timings and counters of the last run of each source\n",
+        "HLAT [reset]\n"
+        "    Show latency of the epg handler callbacks (and reset them)\n",
+        "SRCH [-c channel] [-t from-to] <query>\n"
+        "    Search title, shorttext, description, credits and category of the\n"
+        "    xmltv data (fts5 query syntax), optionally limited to a channel\n"
+        "    (number or id) and a range of start times (time_t). The rest of\n"
+        "    the line after the options is the query. Returns\n"
+        "    channelid, vdr eventid (0 if not yet imported), starttime,\n"
+        "    duration and title~shorttext of each event\n",
         NULL
     };
     return HelpPages;
@@ -1483,13 +1414,14 @@ cString cPluginXmltv2vdr::SVDRPCommand(const char *Command, const char *Option,
     {
         if (g.EPGFile())
         {
-            if (unlink(g.EPGFile())==-1)
+            if (!g.EPGDatabase()->Unlink())
             {
                 ReplyCode=550;
                 output="failed to delete database\n";
             }
             else
             {
+                g.XMLTVCache()->Clear();
                 ReplyCode=250;
                 output="database deleted\n";
             }
@@ -1538,6 +1470,97 @@ cString cPluginXmltv2vdr::SVDRPCommand(const char *Command, const char *Option,
             output="system busy\n";
         }
     }
+    if (!strcasecmp(Command,"STAT"))
+    {
+        // one line per source/component, key=value pairs, times in milliseconds
+        cString stats="";
+        for (cEPGSource *epgs=g.EPGSources()->First(); epgs; epgs=g.EPGSources()->Next(epgs))
+        {
+            if (!strcmp(epgs->Name(),EITSOURCE)) continue;
+            stats=cString::sprintf("%s%s\n",*stats,*epgs->Stats()->ToString(epgs->Name()));
+        }
+        if (g.EPGSeasonEpisode()) stats=cString::sprintf("%s%s\n",*stats,*g.EPGSeasonEpisode()->Stats());
+        stats=cString::sprintf("%s%s\n",*stats,*g.XMLTVCache()->Stats());
+        stats=cString::sprintf("%s%s\n",*stats,*g.EPGCompression()->Stats());
+        ReplyCode=250;
+        output=stats;
+    }
+    if (!strcasecmp(Command,"HLAT"))
+    {
+        if (g.epghandler)
+        {
+            ReplyCode=250;
+            output=g.epghandler->Latency(Option && strstr(Option,"reset"));
+        }
+        else
+        {
+            ReplyCode=550;
+            output="no epg handler\n";
+        }
+    }
+    if (!strcasecmp(Command,"SRCH"))
+    {
+        if (!Option || !*Option)
+        {
+            ReplyCode=501;
+            return "missing query\n";
+        }
+        // options come first, the rest of the line is the query
+        char *query=strdup(Option);
+        if (!query)
+        {
+            ReplyCode=550;
+            return "out of memory\n";
+        }
+        time_t from=0,to=0;
+        cString channelid=NULL;
+        char *p=skipspace(query);
+        while ((p[0]=='-') && ((p[1]=='c') || (p[1]=='t')) && (p[2]==' '))
+        {
+            char opt=p[1];
+            char *arg=skipspace(p+3);
+            char *end=arg;
+            while (*end && (*end!=' ')) end++;
+            if (*end) *end++=0;
+            p=skipspace(end);
+            if (opt=='t')
+            {
+                long long f,t;
+                char dummy;
+                if (sscanf(arg,"%lld-%lld%c",&f,&t,&dummy)!=2)
+                {
+                    free(query);
+                    ReplyCode=501;
+                    return cString::sprintf("invalid time range '%s'\n",arg);
+                }
+                from=(time_t) f;
+                to=(time_t) t;
+            }
+            else
+            {
+                tChannelID chid=tChannelID::FromString(arg);
+                if (!chid.Valid() && isnumber(arg))
+                {
+#if VDRVERSNUM>=20301
+                    LOCK_CHANNELS_READ;
+                    const cChannel *channel=Channels->GetByNumber(atoi(arg));
+#else
+                    cChannel *channel=Channels.GetByNumber(atoi(arg));
+#endif
+                    if (channel) chid=channel->GetChannelID();
+                }
+                if (!chid.Valid())
+                {
+                    free(query);
+                    ReplyCode=501;
+                    return cString::sprintf("unknown channel '%s'\n",arg);
+                }
+                channelid=chid.ToString();
+            }
+        }
+        output=g.EPGDatabase()->Search(stripspace(p),channelid,from,to,ReplyCode);
+        free(query);
+    }
     return output;
 }
 
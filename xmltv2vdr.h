@@ -9,11 +9,18 @@
 #define _XMLTV2VDR_H
 
 #include <sqlite3.h>
+#include <map>
+#include <set>
+#include <vector>
+#include <string>
 #include <vdr/plugin.h>
 #include "maps.h"
 #include "parse.h"
 #include "import.h"
 #include "source.h"
+#include "cache.h"
+#include "db.h"
+#include "compress.h"
 
 #if __GNUC__ > 3
 #define UNUSED(v) UNUSED_ ## v __attribute__((unused))
@@ -55,15 +62,47 @@ public:
     bool DisableSearchTimer();
 };
 
+class cEPGTimerJob : public cListObject
+{
+private:
+    cEvent *event;
+    tChannelID channelid;
+    char *channelidstr;
+    char *timerdescr;
+public:
+    cEPGTimerJob(const cEvent *Event, const char *TimerDescr);
+    ~cEPGTimerJob();
+    cEvent *Event()
+    {
+        return event;
+    }
+    tChannelID ChannelID()
+    {
+        return channelid;
+    }
+    const char *ChannelIDStr()
+    {
+        return channelidstr;
+    }
+    const char *TimerDescr()
+    {
+        return timerdescr;
+    }
+};
+
 class cEPGTimer : public cThread
 {
 private:
+    cGlobals *g;
     cEPGSources *sources;
     cEPGMappings *maps;
     cImport import;
     int epall;
+    // channelid/eventid -> signature, data generation if nothing was found (0 otherwise)
+    std::map<std::pair<std::string,tEventID>,std::pair<unsigned int,unsigned int> > processed;
 public:
     cEPGTimer(cGlobals *Global);
+    static unsigned int Signature(const cEvent *Event);
     void Stop()
     {
         Cancel(3);
@@ -108,18 +147,79 @@ class cEPGSources;
 class cImport;
 class cPluginXmltv2vdr;
 
+#define LATENCY_BUCKETS 40        // powers of two in ns, up to ~18 minutes
+#define LATENCY_SLOW    5000000   // ns, calls above are logged
+#define LATENCY_SLOWMAX 20        // remembered slow calls
+
+enum
+{
+    LATENCY_IGNORECHANNEL=0,
+    LATENCY_SETDESCRIPTION,
+    LATENCY_HANDLEEVENT,
+    LATENCY_SORTSCHEDULE,
+    LATENCY_COUNT
+};
+
+class cEPGLatency
+{
+private:
+    cMutex mutex;
+    uint64_t buckets[LATENCY_BUCKETS];
+    uint64_t count;
+    uint64_t total;
+    uint64_t max;
+    uint64_t Percentile(int Percent);
+public:
+    cEPGLatency();
+    static uint64_t Now(); // monotonic, ns
+    void Add(uint64_t Ns);
+    void Reset();
+    cString ToString(const char *Name);
+};
+
+class cEPGHandler;
+
+class cEPGLatencyTimer
+{
+private:
+    cEPGHandler *handler;
+    int which;
+    uint64_t start;
+    const cEvent *event;
+    tChannelID channelid;
+public:
+    cEPGLatencyTimer(cEPGHandler *Handler, int Which, const cEvent *Event, tChannelID ChannelID);
+    ~cEPGLatencyTimer();
+};
+
 class cEPGHandler : public cEpgHandler
 {
 private:
     cEPGMappings *maps;
     cEPGSources *sources;
     cImport import;
+    cXMLTVCache *cache;
+    cMutex mutex;
     int epall;
     sqlite3 *db;
+    int dbgeneration;
     time_t now;
+    std::map<std::pair<std::string,tEventID>,std::string> timerevents; // (channelid,eventid) -> timer
+    std::set<std::string> timermatch; // channelids of repeating timers or timers without event
+    time_t timerexpire; // first stop time of the timers in timerevents
+#if VDRVERSNUM>=20301
+    cStateKey timerstatekey;
+#endif
+    cEPGLatency latency[LATENCY_COUNT];
+    cMutex slowmutex;
+    cStringList slowcalls;
+    void UpdateTimerEvents();
+    bool MatchTimer(const cEvent *Event, std::string &Descr);
     bool check4proc(cEvent *event, char **timerdescr, cEPGMapping **map);
 public:
     cEPGHandler(cGlobals *Global);
+    void AddLatency(int Which, uint64_t Ns, const cEvent *Event, tChannelID ChannelID);
+    cString Latency(bool Reset=false);
     void SetEPAll(int Value)
     {
         epall=Value;
@@ -135,11 +235,32 @@ public:
     virtual bool SortSchedule(cSchedule *Schedule);
 };
 
+class cHouseKeepingDir : public cListObject
+{
+private:
+    char *path;
+    time_t dirmtime;
+    std::map<std::string,unsigned char> known; // filename -> d_type
+    std::map<time_t,std::set<std::string> > buckets; // mtime/3600 -> filenames
+    void Forget(const std::string &Name);
+public:
+    cHouseKeepingDir(const char *Path);
+    ~cHouseKeepingDir();
+    const char *Path()
+    {
+        return path;
+    }
+    void Check(int Age, int &Cnt, int &LCnt, int &Stats, sqlite3_stmt *Del);
+};
+
 class cHouseKeeping : public cThread
 {
 private:
     cGlobals *global;
-    void checkdir(const char *imgdir, int age, int &cnt, int &lcnt);
+    cList<cHouseKeepingDir> dirs;
+    cHouseKeepingDir *GetDir(const char *Path);
+    void CheckDirs(sqlite3 *db);
+    void CheckDB(sqlite3 *db);
 public:
     cHouseKeeping(cGlobals *Global);
     void Stop()
@@ -149,16 +270,38 @@ public:
     virtual void Action();
 };
 
+#define SEASONEPISODE_BATCH 100 // rows per transaction
+#define SEASONEPISODE_PAUSE 50  // ms between transactions
+
+struct cSeasonEpisodeRow
+{
+    sqlite3_int64 rowid;
+    std::string text[4]; // channelid, title, shorttext, description
+    bool isnull[4];
+    int season;
+    int episode;
+};
+
 class cEPGSeasonEpisode : public cThread
 {
 private:
-    const char *epgfile;
+    cMutex mutex;
+    cCondVar changed;
+    cGlobals *g;
+    bool pending;
+    bool busy;
+    time_t lastrun;
+    int checked,hits,misses;
+    uint64_t duration;
+    int Process(sqlite3 *Db, time_t Changed, iconv_t cEP2ASCII, iconv_t cUTF2ASCII);
+    int ProcessDay(sqlite3 *Db, int Day, time_t Changed, iconv_t cEP2ASCII, iconv_t cUTF2ASCII);
 public:
     cEPGSeasonEpisode(cGlobals *Global);
-    void Stop()
-    {
-        Cancel(3);
-    }
+    time_t EPListTime();
+    void Trigger();
+    bool WaitIdle(int TimeoutMs);
+    cString Stats();
+    void Stop();
     virtual void Action();
 };
 
@@ -178,17 +321,48 @@ private:
     int epall;
     int imgdelafter;
     bool wakeup;
+    bool compress;
     bool soundex;
+    bool dbexists;
+    int dbgeneration;
+    int dbreplaced;
+    int setupgeneration;
     cEPGMappings epgmappings;
     cTEXTMappings textmappings;
     cEPGSources epgsources;
+    cXMLTVCache xmltvcache;
+    cEPGDatabase epgdatabase;
+    cEPGCompression epgcompression;
+    cEPGBackup epgbackup;
+    cEPGWriter epgwriter;
     cEPGTimer *epgtimer;
     cEPGSeasonEpisode *epgseasonepisode;
 public:
     cGlobals();
     ~cGlobals();
     cEPGHandler *epghandler;
-    bool DBExists();
+    void DBChanged(bool Replaced=false);
+    bool DBExists()
+    {
+        return dbexists;
+    }
+    int DBGeneration()
+    {
+        return dbgeneration;
+    }
+    int DBReplaced()
+    {
+        return dbreplaced;
+    }
+    void SetupChanged()
+    {
+        // mappings or options changed, the next import must be a full one
+        setupgeneration++;
+    }
+    int SetupGeneration()
+    {
+        return setupgeneration;
+    }
     char *GetDefaultOrder();
     void AllocateEPGTimerThread()
     {
@@ -218,6 +392,26 @@ public:
     {
         return &epgsources;
     }
+    cXMLTVCache *XMLTVCache()
+    {
+        return &xmltvcache;
+    }
+    cEPGDatabase *EPGDatabase()
+    {
+        return &epgdatabase;
+    }
+    cEPGCompression *EPGCompression()
+    {
+        return &epgcompression;
+    }
+    cEPGBackup *EPGBackup()
+    {
+        return &epgbackup;
+    }
+    cEPGWriter *EPGWriter()
+    {
+        return &epgwriter;
+    }
     void SetConfDir(const char *ConfDir)
     {
         free(confdir);
@@ -227,7 +421,6 @@ public:
     {
         return confdir;
     }
-    void CopyEPGFile(bool Init);
     bool CheckEPGDir(const char *EPGFileDir);
     void SetEPGFile(const char *EPGFile);
     const char *EPGFile()
@@ -307,9 +500,13 @@ public:
     {
         return wakeup;
     }
-    void SetSoundEx()
+    void SetCompress(bool Value)
+    {
+        compress=Value;
+    }
+    bool Compress()
     {
-        soundex=true;
+        return compress;
     }
     bool SoundEx()
     {
@@ -0,0 +1,71 @@
+/*
+ * xtvb.h: A plugin for the Video Disk Recorder
+ *
+ * See the README file for copyright information and how to reach the author.
+ *
+ */
+
+#ifndef _XTVB_H
+#define _XTVB_H
+
+/*
+ * Compact binary alternative to xmltv for pipe sources. A source announces
+ * it with XTVB_FORMAT as fifth field in the first line of its control file,
+ * the plugin then sets XTVB_ENV=XTVB_FORMAT when calling the source. Sources
+ * may still answer with xmltv, the plugin checks the magic.
+ *
+ * stream    = header record*
+ * header    = "XTVB" uint16 version, uint16 reserved (0)
+ * record    = uint8 type, uint32 length, payload (length bytes)
+ *
+ * XTVB_STRING     utf-8 string without trailing zero. Strings are numbered
+ *                 in the order of the stream, starting with 0.
+ * XTVB_PROGRAMME  int64 start, int64 stop (0 = unknown), uint32 eventid
+ *                 (0 = none), uint32 channel (string), followed by fields
+ *                 up to the end of the record: uint8 tag, uint32 a, uint32 b
+ * XTVB_END        end of stream, length 0
+ *
+ * All numbers are little endian, times are seconds since the epoch (UTC).
+ * Field values are string numbers, except for year/season/episode. Unused
+ * values are XTVB_NONE. Unknown record types and field tags are skipped.
+ */
+
+#define XTVB_MAGIC "XTVB"
+#define XTVB_VERSION 1
+#define XTVB_FORMAT "xtvb1"
+#define XTVB_ENV "XMLTV2VDR_FORMAT"
+
+#define XTVB_HEADERSIZE 8
+#define XTVB_RECORDSIZE 5
+#define XTVB_PROGRAMMESIZE 24
+#define XTVB_FIELDSIZE 9
+#define XTVB_NONE 0xFFFFFFFF
+
+enum
+{
+    XTVB_END=0,
+    XTVB_STRING=1,
+    XTVB_PROGRAMME=2
+};
+
+enum
+{
+    XTVB_F_TITLE=1,       // a=title
+    XTVB_F_ORIGTITLE,     // a=original title
+    XTVB_F_SHORTTEXT,     // a=shorttext
+    XTVB_F_DESCRIPTION,   // a=description, may be repeated
+    XTVB_F_CREDIT,        // a=type (director, actor, ...) b=name
+    XTVB_F_CATEGORY,      // a=category, dvb content as "G xx[,yy]"
+    XTVB_F_COUNTRY,       // a=country
+    XTVB_F_YEAR,          // a=year
+    XTVB_F_SEASON,        // a=season (starting with 1)
+    XTVB_F_EPISODE,       // a=episode (starting with 1)
+    XTVB_F_VIDEO,         // a=type (colour, aspect, quality) b=value
+    XTVB_F_AUDIO,         // a=audio
+    XTVB_F_RATING,        // a=system b=value
+    XTVB_F_STARRATING,    // a=system (or XTVB_NONE) b=value
+    XTVB_F_REVIEW,        // a=review
+    XTVB_F_PIC            // a=path of the image
+};
+
+#endif